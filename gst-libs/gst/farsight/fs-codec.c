@@ -488,34 +488,87 @@ fs_codec_to_string (const FsCodec *codec)
 
 
 /*
- * Check if all of the elements of list1 are in list2
- * It compares GLists of FarsightCodecParameter
+ * Orders FsCodecParameter pointers by case-insensitive name, then by value,
+ * two parameters compare as 0 if fs_codec_are_equal() considers them equal.
+ */
+static gint
+param_compare (gconstpointer a, gconstpointer b)
+{
+  const FsCodecParameter *param1 = *(FsCodecParameter * const *) a;
+  const FsCodecParameter *param2 = *(FsCodecParameter * const *) b;
+  gint ret;
+
+  ret = g_ascii_strcasecmp (param1->name, param2->name);
+  if (ret)
+    return ret;
+
+  return strcmp (param1->value, param2->value);
+}
+
+static GPtrArray *
+sorted_params (GList *list)
+{
+  GPtrArray *array = g_ptr_array_sized_new (g_list_length (list));
+
+  for (; list; list = g_list_next (list))
+    g_ptr_array_add (array, list->data);
+  g_ptr_array_sort (array, param_compare);
+
+  return array;
+}
+
+/*
+ * Check if both GLists of FsCodecParameter contain the same parameters,
+ * in any order.
  */
 static gboolean
 compare_lists (GList *list1, GList *list2)
 {
-  GList *item1;
-
-  for (item1 = g_list_first (list1);
-       item1;
-       item1 = g_list_next (item1)) {
-    FsCodecParameter *param1 = item1->data;
-    GList *item2 = NULL;
-
-    for (item2 = g_list_first (list2);
-         item2;
-         item2 = g_list_next (item2)) {
-      FsCodecParameter *param2 = item2->data;
-
-      if (!g_ascii_strcasecmp (param1->name, param2->name) &&
-          !strcmp (param1->value, param2->value))
-        break;
+  GList *item1, *item2;
+  GPtrArray *array1, *array2;
+  guint i = 0, j = 0;
+  gboolean ret = TRUE;
+
+  /* The parameters are nearly always in the same order, for example if one
+   * codec is a copy of the other, so try that first */
+  for (item1 = list1, item2 = list2;
+       item1 && item2;
+       item1 = g_list_next (item1), item2 = g_list_next (item2))
+    if (param_compare (&item1->data, &item2->data))
+      break;
+
+  if (!item1 && !item2)
+    return TRUE;
+
+  /* Otherwise, sort both and merge them, skipping the duplicates */
+  array1 = sorted_params (list1);
+  array2 = sorted_params (list2);
+
+  while (i < array1->len || j < array2->len)
+  {
+    gpointer param;
+
+    if (i >= array1->len || j >= array2->len ||
+        param_compare (&g_ptr_array_index (array1, i),
+            &g_ptr_array_index (array2, j)))
+    {
+      ret = FALSE;
+      break;
     }
-    if (!item2)
-      return FALSE;
+
+    param = g_ptr_array_index (array1, i);
+    while (i < array1->len &&
+        !param_compare (&g_ptr_array_index (array1, i), &param))
+      i++;
+    while (j < array2->len &&
+        !param_compare (&g_ptr_array_index (array2, j), &param))
+      j++;
   }
 
-  return TRUE;
+  g_ptr_array_free (array1, TRUE);
+  g_ptr_array_free (array2, TRUE);
+
+  return ret;
 }
 
 
@@ -552,11 +605,7 @@ fs_codec_are_equal (const FsCodec *codec1, const FsCodec *codec2)
     return FALSE;
 
 
-  /* Is there a smarter way to compare to un-ordered linked lists
-   * to make sure they contain exactly the same elements??
-   */
-  if (!compare_lists (codec1->optional_params, codec2->optional_params) ||
-      !compare_lists (codec2->optional_params, codec1->optional_params))
+  if (!compare_lists (codec1->optional_params, codec2->optional_params))
     return FALSE;
 
   return TRUE;
@@ -34,9 +34,12 @@
 # include <unistd.h>
 #endif
 
+#include <glib/gstdio.h>
+
 #include <gst/farsight/fs-conference-iface.h>
 
 #include "fs-rtp-conference.h"
+#include "fs-rtp-codec-specific.h"
 
 
 /* Because of annoying CRTs */
@@ -54,6 +57,8 @@
 
 #define GST_CAT_DEFAULT fsrtpconference_disco
 
+/* Tells if the cache is newer than the registry, in which case it can be
+ * used without checking the elements it depends on */
 static gboolean codecs_cache_valid (gchar *cache_path) {
   time_t cache_ts = 0;
   time_t registry_ts = 0;
@@ -116,126 +121,339 @@ get_codecs_cache_path (FsMediaType media_type) {
   return cache_path;
 }
 
+/* Returns the stamp of a plugin, they are kept in @plugins */
+static const gchar *
+get_plugin_stamp (GHashTable *plugins, const gchar *plugin_name)
+{
+  GstPlugin *plugin;
+  gchar *stamp;
+
+  stamp = g_hash_table_lookup (plugins, plugin_name);
+  if (stamp)
+    return stamp;
+
+  plugin = gst_default_registry_find_plugin (plugin_name);
+  if (plugin) {
+    const gchar *filename = gst_plugin_get_filename (plugin);
+    STAT_TYPE plugin_stat;
+
+    if (filename && stat (filename, &plugin_stat) == 0)
+      stamp = g_strdup_printf ("%s %s %ld %ld", plugin_name,
+          gst_plugin_get_version (plugin), (glong) plugin_stat.st_mtime,
+          (glong) plugin_stat.st_size);
+    else
+      stamp = g_strdup_printf ("%s %s", plugin_name,
+          gst_plugin_get_version (plugin));
+
+    gst_object_unref (plugin);
+  } else {
+    stamp = g_strdup (plugin_name);
+  }
 
-static gboolean
-read_codec_blueprint_uint (gchar **in, gsize *size, guint *val) {
-  if (*size < sizeof (guint))
-    return FALSE;
+  g_hash_table_insert (plugins, g_strdup (plugin_name), stamp);
 
-  memcpy (val, *in, sizeof(guint));
-  *in += sizeof (guint);
-  *size -= sizeof (guint);
-  return TRUE;
+  return stamp;
+}
+
+/*
+ * Returns a hash table of the names of all the elements the discovery looks
+ * at to their stamp
+ */
+static GHashTable *
+get_factory_stamps (void)
+{
+  GHashTable *stamps;
+  GHashTable *plugins;
+  GList *features, *walk;
+
+  stamps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  plugins = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  features = gst_registry_get_feature_list (gst_registry_get_default (),
+      GST_TYPE_ELEMENT_FACTORY);
+
+  for (walk = features; walk; walk = g_list_next (walk)) {
+    GstPluginFeature *feature = walk->data;
+    const gchar *plugin_stamp = "static";
+
+    if (!codec_blueprints_use_factory (GST_ELEMENT_FACTORY (feature)))
+      continue;
+
+    if (feature->plugin_name)
+      plugin_stamp = get_plugin_stamp (plugins, feature->plugin_name);
+
+    g_hash_table_insert (stamps,
+        g_strdup (gst_plugin_feature_get_name (feature)),
+        g_strdup_printf ("%s %u", plugin_stamp,
+            gst_plugin_feature_get_rank (feature)));
+  }
+
+  gst_plugin_feature_list_free (features);
+  g_hash_table_destroy (plugins);
+
+  return stamps;
+}
+
+
+/*
+ * The cache is laid out so that it can be used straight from the mapped
+ * file without parsing it. All the integers are 32 bits wide, in the byte
+ * order of the host (the file name contains the CPU type already).
+ *
+ *  magic       8 bytes: "FS", the media type, "C" and the version "21"
+ *  CacheHeader
+ *  factories   n_factories offsets in the string table
+ *  blueprints  n_blueprints BlueprintRecord
+ *  params      n_params pairs of offsets in the string table (name, value)
+ *  pipelines   n_pipeline_words words, a pipeline is its number of stages
+ *              followed, for each stage, by its number of factories and
+ *              their indexes in the factory table
+ *  deps        n_deps pairs of offsets in the string table (factory, stamp)
+ *  strings     strings_size bytes of NUL terminated strings
+ *
+ * Each factory is only looked up once however many blueprints use it and
+ * the caps are only parsed when someone asks for them.
+ *
+ * The deps are all the elements the discovery looked at, with a stamp made
+ * of their plugin, its version, file time and size and the rank of the
+ * element. When the registry is newer than the cache, they are compared to
+ * the installed elements and only the blueprints using an element that
+ * changed are dropped, the discovery then redoes just those.
+ */
+
+#define NO_PIPELINE G_MAXUINT32
+
+typedef struct {
+  guint32 n_blueprints;
+  guint32 n_factories;
+  guint32 n_params;
+  guint32 n_pipeline_words;
+  guint32 n_deps;
+  guint32 strings_size;
+} CacheHeader;
+
+typedef struct {
+  gint32 id;
+  guint32 encoding_name;
+  guint32 clock_rate;
+  guint32 channels;
+  guint32 first_param;
+  guint32 n_params;
+  guint32 media_caps;
+  guint32 rtp_caps;
+  guint32 send_pipeline;
+  guint32 recv_pipeline;
+} BlueprintRecord;
+
+typedef struct {
+  CacheHeader header;
+  const guint32 *factories;
+  const BlueprintRecord *blueprints;
+  const guint32 *params;
+  const guint32 *pipelines;
+  const guint32 *deps;
+  const gchar *strings;
+
+  GstElementFactory **resolved_factories;
+  gboolean *stale_factories;
+} CacheView;
+
+static const gchar *
+cache_view_get_string (CacheView *view, guint32 offset)
+{
+  /* The last byte of the table is a NUL, so this is always terminated */
+  if (offset >= view->header.strings_size)
+    return NULL;
+
+  return view->strings + offset;
+}
+
+static void
+free_pipeline (GList *pipeline)
+{
+  GList *walk;
+
+  for (walk = pipeline; walk; walk = g_list_next (walk))
+  {
+    g_list_foreach (walk->data, (GFunc) gst_object_unref, NULL);
+    g_list_free (walk->data);
+  }
+  g_list_free (pipeline);
 }
 
 static gboolean
-read_codec_blueprint_int (gchar **in, gsize *size, gint *val) {
-  if (*size < sizeof (gint))
+load_pipeline (CacheView *view, guint32 offset, GList **pipeline)
+{
+  guint32 words = view->header.n_pipeline_words;
+  guint32 n_stages;
+  guint32 i, j;
+
+  *pipeline = NULL;
+
+  if (offset == NO_PIPELINE)
+    return TRUE;
+
+  if (offset >= words)
     return FALSE;
 
-  memcpy (val, *in, sizeof(gint));
-  *in += sizeof (gint);
-  *size -= sizeof (gint);
+  n_stages = view->pipelines[offset++];
+
+  for (i = 0; i < n_stages; i++)
+  {
+    GList *stage = NULL;
+    guint32 n_factories;
+
+    if (offset >= words)
+      goto error;
+
+    n_factories = view->pipelines[offset++];
+    if (n_factories > words - offset)
+      goto error;
+
+    for (j = 0; j < n_factories; j++)
+    {
+      guint32 index = view->pipelines[offset++];
+
+      if (index >= view->header.n_factories ||
+          !view->resolved_factories[index])
+      {
+        g_list_foreach (stage, (GFunc) gst_object_unref, NULL);
+        g_list_free (stage);
+        goto error;
+      }
+
+      stage = g_list_append (stage,
+          gst_object_ref (view->resolved_factories[index]));
+    }
+
+    *pipeline = g_list_append (*pipeline, stage);
+  }
+
   return TRUE;
+
+ error:
+  free_pipeline (*pipeline);
+  *pipeline = NULL;
+  return FALSE;
 }
 
+/* Tells if the pipeline at @offset uses an element that changed */
 static gboolean
-read_codec_blueprint_string (gchar **in, gsize *size, gchar **str) {
-  gint str_length;
+pipeline_is_stale (CacheView *view, guint32 offset)
+{
+  guint32 words = view->header.n_pipeline_words;
+  guint32 n_stages;
+  guint32 i, j;
 
-  if (!read_codec_blueprint_int (in, size, &str_length))
+  /* Invalid pipelines are caught by load_pipeline() */
+  if (offset == NO_PIPELINE || offset >= words)
     return FALSE;
 
-  if (*size < str_length)
-    return FALSE;
+  n_stages = view->pipelines[offset++];
+
+  for (i = 0; i < n_stages && offset < words; i++)
+  {
+    guint32 n_factories = view->pipelines[offset++];
 
-  *str = g_new0 (gchar, str_length +1);
-  memcpy (*str, *in, str_length);
-  *in += str_length;
-  *size -= str_length;
+    for (j = 0; j < n_factories && offset < words; j++)
+    {
+      guint32 index = view->pipelines[offset++];
 
-  return TRUE;
+      if (index < view->header.n_factories && view->stale_factories[index])
+        return TRUE;
+    }
+  }
+
+  return FALSE;
 }
 
+/*
+ * Compares the elements recorded in the cache with the installed ones,
+ * returns the names of the ones that were added, removed or changed
+ */
+static GList *
+get_changed_factories (CacheView *view, GHashTable *stamps)
+{
+  GHashTable *known = g_hash_table_new (g_str_hash, g_str_equal);
+  GHashTableIter iter;
+  gpointer name;
+  GList *changed = NULL;
+  guint32 i;
+
+  for (i = 0; i < view->header.n_deps; i++)
+  {
+    const gchar *dep_name = cache_view_get_string (view, view->deps[i * 2]);
+    const gchar *stamp = cache_view_get_string (view, view->deps[i * 2 + 1]);
+    const gchar *cur_stamp;
+
+    if (!dep_name || !stamp)
+      continue;
+
+    g_hash_table_insert (known, (gpointer) dep_name, (gpointer) dep_name);
+
+    cur_stamp = g_hash_table_lookup (stamps, dep_name);
+    if (!cur_stamp || strcmp (cur_stamp, stamp))
+      changed = g_list_prepend (changed, g_strdup (dep_name));
+  }
+
+  g_hash_table_iter_init (&iter, stamps);
+  while (g_hash_table_iter_next (&iter, &name, NULL))
+    if (!g_hash_table_lookup (known, name))
+      changed = g_list_prepend (changed, g_strdup (name));
 
-#define READ_CHECK(x) if (!x) goto error;
+  g_hash_table_destroy (known);
+
+  return changed;
+}
 
 static CodecBlueprint *
-load_codec_blueprint (FsMediaType media_type, gchar **in, gsize *size) {
+load_codec_blueprint (FsMediaType media_type, CacheView *view,
+    const BlueprintRecord *record)
+{
   CodecBlueprint *codec_blueprint = g_slice_new0 (CodecBlueprint);
-  gchar *tmp;
-  gint tmp_size;
-  int i;
-
-  codec_blueprint->codec = g_slice_new0 (FsCodec);
-  codec_blueprint->codec->media_type = media_type;
-
-  READ_CHECK (read_codec_blueprint_int
-      (in, size, &(codec_blueprint->codec->id)));
-  READ_CHECK (read_codec_blueprint_string
-      (in, size, &(codec_blueprint->codec->encoding_name)));
-  READ_CHECK (read_codec_blueprint_uint
-      (in, size, &(codec_blueprint->codec->clock_rate)));
-  READ_CHECK (read_codec_blueprint_uint
-      (in, size, &(codec_blueprint->codec->channels)));
-
-
-  READ_CHECK (read_codec_blueprint_int (in, size, &tmp_size));
-  for (i = 0; i < tmp_size; i++) {
-    gchar *name, *value;
-    READ_CHECK (read_codec_blueprint_string (in, size, &(name)));
-    READ_CHECK (read_codec_blueprint_string (in, size, &(value)));
+  const gchar *encoding_name;
+  const gchar *media_caps;
+  const gchar *rtp_caps;
+  guint32 i;
+
+  encoding_name = cache_view_get_string (view, record->encoding_name);
+  media_caps = cache_view_get_string (view, record->media_caps);
+  rtp_caps = cache_view_get_string (view, record->rtp_caps);
+
+  if (!encoding_name || !media_caps || !rtp_caps)
+    goto error;
+
+  codec_blueprint->codec = fs_codec_new (record->id, encoding_name,
+      media_type, record->clock_rate);
+  codec_blueprint->codec->channels = record->channels;
+
+  if (record->first_param > view->header.n_params ||
+      record->n_params > view->header.n_params - record->first_param)
+    goto error;
+
+  for (i = record->first_param; i < record->first_param + record->n_params;
+       i++)
+  {
+    const gchar *name = cache_view_get_string (view, view->params[i * 2]);
+    const gchar *value = cache_view_get_string (view, view->params[i * 2 + 1]);
+
+    if (!name || !value)
+      goto error;
+
     fs_codec_add_optional_parameter (codec_blueprint->codec, name, value);
-    g_free (name);
-    g_free (value);
-  }
-
-  READ_CHECK (read_codec_blueprint_string (in, size, &tmp));
-  codec_blueprint->media_caps = gst_caps_from_string (tmp);
-  g_free (tmp);
-
-  READ_CHECK (read_codec_blueprint_string (in, size, &tmp));
-  codec_blueprint->rtp_caps = gst_caps_from_string (tmp);
-  g_free (tmp);
-
-  READ_CHECK (read_codec_blueprint_int (in, size, &tmp_size));
-  for (i = 0; i < tmp_size; i++) {
-    int j, tmp_size2;
-    GList *tmplist = NULL;
-
-    READ_CHECK (read_codec_blueprint_int (in, size, &tmp_size2));
-    for (j = 0; j < tmp_size2; j++) {
-      GstElementFactory *fact = NULL;
-      READ_CHECK (read_codec_blueprint_string (in, size, &(tmp)));
-      fact = gst_element_factory_find (tmp);
-      g_free (tmp);
-      if (!fact)
-        goto error;
-      tmplist = g_list_append (tmplist, fact);
-    }
-    codec_blueprint->send_pipeline_factory =
-      g_list_append (codec_blueprint->send_pipeline_factory, tmplist);
-  }
-
-  READ_CHECK (read_codec_blueprint_int (in, size, &tmp_size));
-  for (i = 0; i < tmp_size; i++) {
-    int j, tmp_size2;
-    GList *tmplist = NULL;
-
-    READ_CHECK (read_codec_blueprint_int (in, size, &tmp_size2));
-    for (j = 0; j < tmp_size2; j++) {
-      GstElementFactory *fact = NULL;
-      READ_CHECK (read_codec_blueprint_string (in, size, &(tmp)));
-      fact = gst_element_factory_find (tmp);
-      g_free (tmp);
-      if (!fact)
-        goto error;
-      tmplist = g_list_append (tmplist, fact);
-    }
-    codec_blueprint->receive_pipeline_factory =
-      g_list_append (codec_blueprint->receive_pipeline_factory, tmplist);
   }
 
+  /* Parsed by codec_blueprint_get_*_caps() when needed */
+  codec_blueprint->media_caps_str = g_strdup (media_caps);
+  codec_blueprint->rtp_caps_str = g_strdup (rtp_caps);
+
+  if (!load_pipeline (view, record->send_pipeline,
+          &codec_blueprint->send_pipeline_factory))
+    goto error;
+  if (!load_pipeline (view, record->recv_pipeline,
+          &codec_blueprint->receive_pipeline_factory))
+    goto error;
+
   GST_DEBUG ("adding codec %s with pt %d, send_pipeline %p, receive_pipeline %p",
       codec_blueprint->codec->encoding_name, codec_blueprint->codec->id,
       codec_blueprint->send_pipeline_factory,
@@ -253,28 +471,42 @@ load_codec_blueprint (FsMediaType media_type, gchar **in, gsize *size) {
 /**
  * load_codecs_cache
  * @media_type: a #FsMediaType
+ * @blueprints: location for the #GList of #CodecBlueprint
+ * @changed_factories: location for the names of the elements that changed
+ *  since the cache was written, or %NULL if none did
+ * @stale_caps: location for the media caps of the blueprints that were
+ *  dropped because they use one of those elements, or %NULL
  *
- * Will load the codecs blueprints from the cache.
+ * Will load the codecs blueprints from the cache. If some elements changed,
+ * only the blueprints that do not depend on them are returned and the
+ * caller has to rediscover the others.
  *
- * Returns: TRUE if successful, FALSE if error, or cache outdated
+ * Returns: TRUE if successful, FALSE if error, or no cache
  *
  */
-GList *
-load_codecs_cache (FsMediaType media_type)
+gboolean
+load_codecs_cache (FsMediaType media_type, GList **blueprints,
+    GList **changed_factories, GstCaps **stale_caps)
 {
   GMappedFile *mapped = NULL;
   gchar *contents = NULL;
   gchar *in = NULL;
   gsize size;
   GError *err = NULL;
-  GList *blueprints = NULL;
+  CacheView view;
+  guint64 needed;
+  gboolean ret = FALSE;
 
   gchar magic[8] = {0};
   gchar magic_media = '?';
-  gint num_blueprints;
   gchar *cache_path;
-  int i;
+  guint32 i;
+
+  memset (&view, 0, sizeof (view));
 
+  *blueprints = NULL;
+  *changed_factories = NULL;
+  *stale_caps = NULL;
 
   if (media_type == FS_MEDIA_TYPE_AUDIO) {
     magic_media = 'A';
@@ -282,19 +514,13 @@ load_codecs_cache (FsMediaType media_type)
     magic_media = 'V';
   } else {
     GST_ERROR ("Invalid media type %d", media_type);
-    return NULL;
+    return FALSE;
   }
 
   cache_path = get_codecs_cache_path (media_type);
 
   if (!cache_path)
-    return NULL;
-
-  if (!codecs_cache_valid (cache_path)) {
-    GST_DEBUG ("Codecs cache %s is outdated or does not exist", cache_path);
-    g_free (cache_path);
-    return NULL;
-  }
+    return FALSE;
 
   GST_DEBUG ("Loading codecs cache %s", cache_path);
 
@@ -319,7 +545,7 @@ load_codecs_cache (FsMediaType media_type)
 
   in = contents;
 
-  if (size < sizeof (magic)) {
+  if (size < sizeof (magic) + sizeof (CacheHeader)) {
     GST_WARNING ("Cache file corrupt");
     goto error;
   }
@@ -332,46 +558,138 @@ load_codecs_cache (FsMediaType media_type)
       magic[1] != 'S' ||
       magic[2] != magic_media ||
       magic[3] != 'C' ||
-      magic[4] != '1' ||   /* This is the version number */
+      magic[4] != '2' ||   /* This is the version number */
       magic[5] != '1') {
     GST_WARNING ("Cache file has incorrect magic header. File corrupted");
     goto error;
   }
 
-  if (size < sizeof (gint)) {
-    GST_WARNING ("Cache file corrupt (size: %"G_GSIZE_FORMAT" < sizeof (int))",
-        size);
+  memcpy (&view.header, in, sizeof (CacheHeader));
+  in += sizeof (CacheHeader);
+  size -= sizeof (CacheHeader);
+
+  if (view.header.n_blueprints > 50)
+  {
+    GST_WARNING ("Impossible number of blueprints in cache %u, ignoring",
+        view.header.n_blueprints);
     goto error;
   }
 
-  memcpy (&num_blueprints, in, sizeof(gint));
-  in += sizeof (gint);
-  size -= sizeof (gint);
+  needed = (guint64) view.header.n_factories * sizeof (guint32) +
+    (guint64) view.header.n_blueprints * sizeof (BlueprintRecord) +
+    (guint64) view.header.n_params * 2 * sizeof (guint32) +
+    (guint64) view.header.n_pipeline_words * sizeof (guint32) +
+    (guint64) view.header.n_deps * 2 * sizeof (guint32) +
+    view.header.strings_size;
 
-  if (num_blueprints > 50)
-  {
-    GST_WARNING ("Impossible number of blueprints in cache %d, ignoring",
-        num_blueprints);
+  if (needed != size || view.header.strings_size == 0) {
+    GST_WARNING ("Cache file corrupt (size: %"G_GSIZE_FORMAT
+        " != %"G_GUINT64_FORMAT")", size, needed);
     goto error;
   }
 
-  for (i = 0; i < num_blueprints; i++) {
-    CodecBlueprint *blueprint = load_codec_blueprint (media_type, &in, &size);
-    if (!blueprint) {
-      GST_WARNING ("Can not load all of the blueprints, cache corrupted");
+  /* Everything is 32 bits aligned since the header is */
+  view.factories = (const guint32 *) in;
+  in += view.header.n_factories * sizeof (guint32);
+  view.blueprints = (const BlueprintRecord *) in;
+  in += view.header.n_blueprints * sizeof (BlueprintRecord);
+  view.params = (const guint32 *) in;
+  in += view.header.n_params * 2 * sizeof (guint32);
+  view.pipelines = (const guint32 *) in;
+  in += view.header.n_pipeline_words * sizeof (guint32);
+  view.deps = (const guint32 *) in;
+  in += view.header.n_deps * 2 * sizeof (guint32);
+  view.strings = in;
+
+  if (view.strings[view.header.strings_size - 1] != '\0') {
+    GST_WARNING ("Cache file corrupt, string table not terminated");
+    goto error;
+  }
+
+  /* Only compare the elements if the registry changed after the cache
+   * was written */
+  if (!codecs_cache_valid (cache_path)) {
+    GHashTable *stamps = get_factory_stamps ();
 
-      if (blueprints) {
-        g_list_foreach (blueprints, (GFunc) codec_blueprint_destroy, NULL);
-        g_list_free (blueprints);
-        blueprints = NULL;
+    *changed_factories = get_changed_factories (&view, stamps);
+    g_hash_table_destroy (stamps);
+  }
+
+  view.resolved_factories = g_new0 (GstElementFactory *,
+      view.header.n_factories);
+  view.stale_factories = g_new0 (gboolean, view.header.n_factories);
+  for (i = 0; i < view.header.n_factories; i++) {
+    const gchar *name = cache_view_get_string (&view, view.factories[i]);
+
+    if (!name) {
+      GST_WARNING ("Cache file corrupt, invalid element name");
+      goto error;
+    }
+
+    view.resolved_factories[i] = gst_element_factory_find (name);
+
+    if (g_list_find_custom (*changed_factories, name,
+            (GCompareFunc) strcmp)) {
+      view.stale_factories[i] = TRUE;
+    } else if (!view.resolved_factories[i]) {
+      GST_DEBUG ("Element %s from the cache does not exist anymore", name);
+      view.stale_factories[i] = TRUE;
+      *changed_factories = g_list_prepend (*changed_factories,
+          g_strdup (name));
+    }
+  }
+
+  for (i = 0; i < view.header.n_blueprints; i++) {
+    const BlueprintRecord *record = &view.blueprints[i];
+    CodecBlueprint *blueprint;
+
+    if (pipeline_is_stale (&view, record->send_pipeline) ||
+        pipeline_is_stale (&view, record->recv_pipeline)) {
+      const gchar *media_caps = cache_view_get_string (&view,
+          record->media_caps);
+      GstCaps *caps = media_caps ? gst_caps_from_string (media_caps) : NULL;
+
+      if (!caps) {
+        GST_WARNING ("Cache file corrupt, invalid media caps");
+        goto error;
       }
 
+      if (*stale_caps)
+        gst_caps_append (*stale_caps, caps);
+      else
+        *stale_caps = caps;
+      continue;
+    }
+
+    blueprint = load_codec_blueprint (media_type, &view, record);
+    if (!blueprint) {
+      GST_WARNING ("Can not load all of the blueprints, cache corrupted");
       goto error;
     }
-    blueprints = g_list_append (blueprints, blueprint);
+    *blueprints = g_list_append (*blueprints, blueprint);
   }
 
+  ret = TRUE;
+
  error:
+  if (!ret) {
+    g_list_foreach (*blueprints, (GFunc) codec_blueprint_destroy, NULL);
+    g_list_free (*blueprints);
+    *blueprints = NULL;
+    g_list_foreach (*changed_factories, (GFunc) g_free, NULL);
+    g_list_free (*changed_factories);
+    *changed_factories = NULL;
+    if (*stale_caps)
+      gst_caps_unref (*stale_caps);
+    *stale_caps = NULL;
+  }
+  if (view.resolved_factories) {
+    for (i = 0; i < view.header.n_factories; i++)
+      if (view.resolved_factories[i])
+        gst_object_unref (view.resolved_factories[i]);
+    g_free (view.resolved_factories);
+  }
+  g_free (view.stale_factories);
   if (mapped) {
 #if GLIB_CHECK_VERSION(2,22,0)
     g_mapped_file_unref (mapped);
@@ -382,95 +700,146 @@ load_codecs_cache (FsMediaType media_type)
     g_free (contents);
   }
   g_free (cache_path);
-  return blueprints;
+  return ret;
 }
 
-#define WRITE_CHECK(x) if (!x) return FALSE;
+typedef struct {
+  GByteArray *strings;
+  GHashTable *string_offsets;
+  GArray *factories;
+  GHashTable *factory_indexes;
+  GArray *blueprints;
+  GArray *params;
+  GArray *pipelines;
+  GArray *deps;
+} CacheWriter;
+
+static guint32
+cache_writer_add_string (CacheWriter *writer, const gchar *str)
+{
+  gpointer offset;
+
+  /* Offsets are stored plus one so that 0 means not found */
+  offset = g_hash_table_lookup (writer->string_offsets, str);
+  if (offset)
+    return GPOINTER_TO_UINT (offset) - 1;
 
-static gboolean
-write_codec_blueprint_int (int fd, gint val) {
-  return write (fd, &val, sizeof (gint)) == sizeof (gint);
+  offset = GUINT_TO_POINTER (writer->strings->len + 1);
+  g_byte_array_append (writer->strings, (const guint8 *) str,
+      strlen (str) + 1);
+  g_hash_table_insert (writer->string_offsets, g_strdup (str), offset);
+
+  return GPOINTER_TO_UINT (offset) - 1;
 }
 
-static gboolean
-write_codec_blueprint_string (int fd, const gchar *str) {
-  gint size;
+static guint32
+cache_writer_add_factory (CacheWriter *writer, GstElementFactory *factory)
+{
+  gpointer index;
+  guint32 offset;
+
+  index = g_hash_table_lookup (writer->factory_indexes, factory);
+  if (index)
+    return GPOINTER_TO_UINT (index) - 1;
 
-  size = strlen (str);
-  WRITE_CHECK (write_codec_blueprint_int (fd, size));
-  return write (fd, str, size) == size;
+  offset = cache_writer_add_string (writer,
+      gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory)));
+  g_array_append_val (writer->factories, offset);
+  index = GUINT_TO_POINTER (writer->factories->len);
+  g_hash_table_insert (writer->factory_indexes, factory, index);
+
+  return GPOINTER_TO_UINT (index) - 1;
 }
 
-static gboolean
-save_codec_blueprint (int fd, CodecBlueprint *codec_blueprint) {
-  gchar *caps;
-  const gchar *factory_name;
+static guint32
+cache_writer_add_pipeline (CacheWriter *writer, GList *pipeline)
+{
+  guint32 offset = writer->pipelines->len;
+  guint32 val;
+  GList *walk, *walk2;
+
+  if (!pipeline)
+    return NO_PIPELINE;
+
+  val = g_list_length (pipeline);
+  g_array_append_val (writer->pipelines, val);
+
+  for (walk = pipeline; walk; walk = g_list_next (walk))
+  {
+    val = g_list_length (walk->data);
+    g_array_append_val (writer->pipelines, val);
+
+    for (walk2 = walk->data; walk2; walk2 = g_list_next (walk2))
+    {
+      val = cache_writer_add_factory (writer, walk2->data);
+      g_array_append_val (writer->pipelines, val);
+    }
+  }
+
+  return offset;
+}
+
+static void
+cache_writer_add_blueprint (CacheWriter *writer,
+    CodecBlueprint *codec_blueprint)
+{
+  BlueprintRecord record;
   GList *walk;
-  gint size;
-
-  WRITE_CHECK (write_codec_blueprint_int
-      (fd, codec_blueprint->codec->id));
-  WRITE_CHECK (write_codec_blueprint_string
-      (fd, codec_blueprint->codec->encoding_name));
-  WRITE_CHECK (write_codec_blueprint_int
-      (fd, codec_blueprint->codec->clock_rate));
-  WRITE_CHECK (write_codec_blueprint_int
-      (fd, codec_blueprint->codec->channels));
-
-  size = g_list_length (codec_blueprint->codec->optional_params);
-  WRITE_CHECK (write_codec_blueprint_int (fd, size));
+  gchar *caps;
+
+  record.id = codec_blueprint->codec->id;
+  record.encoding_name = cache_writer_add_string (writer,
+      codec_blueprint->codec->encoding_name);
+  record.clock_rate = codec_blueprint->codec->clock_rate;
+  record.channels = codec_blueprint->codec->channels;
+
+  record.first_param = writer->params->len / 2;
+  record.n_params = 0;
   for (walk = codec_blueprint->codec->optional_params; walk;
        walk = g_list_next (walk)) {
     FsCodecParameter *param = walk->data;
-    WRITE_CHECK (write_codec_blueprint_string (fd, param->name));
-    WRITE_CHECK (write_codec_blueprint_string (fd, param->value));
+    guint32 offset;
+
+    offset = cache_writer_add_string (writer, param->name);
+    g_array_append_val (writer->params, offset);
+    offset = cache_writer_add_string (writer, param->value);
+    g_array_append_val (writer->params, offset);
+    record.n_params++;
   }
 
-  caps = gst_caps_to_string (codec_blueprint->media_caps);
-  WRITE_CHECK (write_codec_blueprint_string (fd, caps));
+  caps = gst_caps_to_string (codec_blueprint_get_media_caps (codec_blueprint));
+  record.media_caps = cache_writer_add_string (writer, caps);
   g_free (caps);
 
-  caps = gst_caps_to_string (codec_blueprint->rtp_caps);
-  WRITE_CHECK (write_codec_blueprint_string (fd, caps));
+  caps = gst_caps_to_string (codec_blueprint_get_rtp_caps (codec_blueprint));
+  record.rtp_caps = cache_writer_add_string (writer, caps);
   g_free (caps);
 
-  walk = codec_blueprint->send_pipeline_factory;
-  size = g_list_length (walk);
-  if (write (fd, &size, sizeof (gint)) != sizeof (gint))
-    return FALSE;
-
-  for (; walk; walk = g_list_next (walk)) {
-    GList *walk2 = walk->data;
-    size = g_list_length (walk2);
-    if (write (fd, &size, sizeof (gint)) != sizeof (gint))
-      return FALSE;
-    for (; walk2; walk2 = g_list_next (walk2)) {
-      GstElementFactory *fact = walk2->data;
-      factory_name = gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (fact));
-      WRITE_CHECK (write_codec_blueprint_string (fd, factory_name));
-    }
-  }
+  record.send_pipeline = cache_writer_add_pipeline (writer,
+      codec_blueprint->send_pipeline_factory);
+  record.recv_pipeline = cache_writer_add_pipeline (writer,
+      codec_blueprint->receive_pipeline_factory);
 
-  walk = codec_blueprint->receive_pipeline_factory;
-  size = g_list_length (walk);
-  if (write (fd, &size, sizeof (gint)) != sizeof (gint))
-    return FALSE;
+  g_array_append_val (writer->blueprints, record);
+}
 
-  for (; walk; walk = g_list_next (walk)) {
-    GList *walk2 = walk->data;
-    size = g_list_length (walk2);
-    if (write (fd, &size, sizeof (gint)) != sizeof (gint))
-      return FALSE;
-    for (; walk2; walk2 = g_list_next (walk2)) {
-      GstElementFactory *fact = walk2->data;
-      factory_name = gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (fact));
-      WRITE_CHECK (write_codec_blueprint_string (fd, factory_name));
-    }
-  }
+static void
+cache_writer_add_dep (gpointer key, gpointer value, gpointer user_data)
+{
+  CacheWriter *writer = user_data;
+  guint32 offset;
 
-  return TRUE;
+  offset = cache_writer_add_string (writer, key);
+  g_array_append_val (writer->deps, offset);
+  offset = cache_writer_add_string (writer, value);
+  g_array_append_val (writer->deps, offset);
 }
 
+static gboolean
+write_all (int fd, gconstpointer data, gsize size)
+{
+  return write (fd, data, size) == (gssize) size;
+}
 
 gboolean
 save_codecs_cache (FsMediaType media_type, GList *blueprints)
@@ -479,8 +848,11 @@ save_codecs_cache (FsMediaType media_type, GList *blueprints)
   GList *item;
   gchar *tmp_path;
   int fd;
-  int size;
+  gboolean ok;
   gchar magic[8] = {0};
+  CacheWriter writer;
+  CacheHeader header;
+  GHashTable *stamps;
 
   cache_path = get_codecs_cache_path (media_type);
   if (!cache_path)
@@ -525,32 +897,66 @@ save_codecs_cache (FsMediaType media_type, GList *blueprints)
   }
 
   /* version of the binary format */
-  magic[4] = '1';
+  magic[4] = '2';
   magic[5] = '1';
 
-  if (write (fd, magic, 8) != 8)
-    return FALSE;
-
-
-  size = g_list_length (blueprints);
-  if (write (fd, &size, sizeof (gint)) != sizeof (gint))
-    return FALSE;
-
+  writer.strings = g_byte_array_new ();
+  writer.string_offsets = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, NULL);
+  writer.factories = g_array_new (FALSE, FALSE, sizeof (guint32));
+  writer.factory_indexes = g_hash_table_new (g_direct_hash, g_direct_equal);
+  writer.blueprints = g_array_new (FALSE, FALSE, sizeof (BlueprintRecord));
+  writer.params = g_array_new (FALSE, FALSE, sizeof (guint32));
+  writer.pipelines = g_array_new (FALSE, FALSE, sizeof (guint32));
+  writer.deps = g_array_new (FALSE, FALSE, sizeof (guint32));
 
   for (item = g_list_first (blueprints);
        item;
-       item = g_list_next (item)) {
-    CodecBlueprint *codec_blueprint = item->data;
-    if (!save_codec_blueprint (fd, codec_blueprint)) {
-      GST_WARNING ("Unable to save codec cache");
-      close (fd);
-      g_free (tmp_path);
-      g_free (cache_path);
-      return FALSE;
-    }
+       item = g_list_next (item))
+    cache_writer_add_blueprint (&writer, item->data);
+
+  stamps = get_factory_stamps ();
+  g_hash_table_foreach (stamps, cache_writer_add_dep, &writer);
+  g_hash_table_destroy (stamps);
+
+  header.n_blueprints = writer.blueprints->len;
+  header.n_factories = writer.factories->len;
+  header.n_params = writer.params->len / 2;
+  header.n_pipeline_words = writer.pipelines->len;
+  header.n_deps = writer.deps->len / 2;
+  header.strings_size = writer.strings->len;
+
+  ok = write_all (fd, magic, sizeof (magic)) &&
+    write_all (fd, &header, sizeof (header)) &&
+    write_all (fd, writer.factories->data,
+        writer.factories->len * sizeof (guint32)) &&
+    write_all (fd, writer.blueprints->data,
+        writer.blueprints->len * sizeof (BlueprintRecord)) &&
+    write_all (fd, writer.params->data,
+        writer.params->len * sizeof (guint32)) &&
+    write_all (fd, writer.pipelines->data,
+        writer.pipelines->len * sizeof (guint32)) &&
+    write_all (fd, writer.deps->data, writer.deps->len * sizeof (guint32)) &&
+    write_all (fd, writer.strings->data, writer.strings->len);
+
+  g_byte_array_free (writer.strings, TRUE);
+  g_hash_table_destroy (writer.string_offsets);
+  g_array_free (writer.factories, TRUE);
+  g_hash_table_destroy (writer.factory_indexes);
+  g_array_free (writer.blueprints, TRUE);
+  g_array_free (writer.params, TRUE);
+  g_array_free (writer.pipelines, TRUE);
+  g_array_free (writer.deps, TRUE);
+
+  if (!ok) {
+    GST_WARNING ("Unable to save codec cache");
+    close (fd);
+    g_unlink (tmp_path);
+    g_free (tmp_path);
+    g_free (cache_path);
+    return FALSE;
   }
 
-
   if (close (fd) < 0) {
     GST_DEBUG ("Can't close codecs cache file : %s", g_strerror (errno));
       g_free (tmp_path);
@@ -570,3 +976,552 @@ save_codecs_cache (FsMediaType media_type, GList *blueprints)
   GST_DEBUG ("Wrote binary codecs cache");
   return TRUE;
 }
+
+
+/*
+ * The config cache remembers the config parameters (like the Vorbis or Theora
+ * headers) that were discovered by running the encoder of a codec. It is a
+ * GKeyFile per media type with one group per encoder setup, the name of the
+ * group is a checksum of the key made of the send pipeline (or profile), the
+ * send caps and the caps of the raw media fed to the encoder. Each entry also
+ * records the version of the plugin of every element in the pipeline and is
+ * dropped if any of them changes.
+ *
+ * Every setup also has an entry with "ANY" input caps which holds the last
+ * config discovered for it, it is used before the input caps are known. If
+ * the encoder then produces another config, the session announces the new
+ * codecs.
+ */
+
+static GStaticMutex config_cache_mutex = G_STATIC_MUTEX_INIT;
+static GKeyFile *config_cache[FS_MEDIA_TYPE_LAST+1] = { NULL };
+static gboolean config_cache_dirty[FS_MEDIA_TYPE_LAST+1] = { FALSE };
+static gboolean config_cache_save_pending[FS_MEDIA_TYPE_LAST+1] = { FALSE };
+
+#define CONFIG_CACHE_ANY_INPUT_CAPS "ANY"
+
+static gchar *
+get_codec_config_cache_path (FsMediaType media_type) {
+  gchar *cache_path;
+
+  if (media_type == FS_MEDIA_TYPE_AUDIO) {
+    cache_path = g_strdup (g_getenv ("FS_AUDIO_CODECS_CONFIG_CACHE"));
+    if (cache_path == NULL) {
+      cache_path = g_build_filename (g_get_user_cache_dir (), "farsight",
+          "codecs-config.audio." HOST_CPU ".cache", NULL);
+    }
+  } else if (media_type == FS_MEDIA_TYPE_VIDEO) {
+    cache_path = g_strdup (g_getenv ("FS_VIDEO_CODECS_CONFIG_CACHE"));
+    if (cache_path == NULL) {
+      cache_path = g_build_filename (g_get_user_cache_dir (), "farsight",
+          "codecs-config.video." HOST_CPU ".cache", NULL);
+    }
+  } else {
+    GST_ERROR ("Unknown media type %d for config cache", media_type);
+    return NULL;
+  }
+
+  return cache_path;
+}
+
+/* Must be called with the config cache mutex held */
+static GKeyFile *
+get_codec_config_cache_locked (FsMediaType media_type)
+{
+  gchar *cache_path;
+  GError *error = NULL;
+
+  if (media_type > FS_MEDIA_TYPE_LAST)
+    return NULL;
+
+  if (config_cache[media_type])
+    return config_cache[media_type];
+
+  config_cache[media_type] = g_key_file_new ();
+
+  cache_path = get_codec_config_cache_path (media_type);
+  if (!cache_path)
+    return config_cache[media_type];
+
+  if (!g_key_file_load_from_file (config_cache[media_type], cache_path,
+          G_KEY_FILE_NONE, &error))
+  {
+    GST_DEBUG ("Could not load config cache %s: %s", cache_path,
+        error->message);
+    g_clear_error (&error);
+  }
+  else
+  {
+    GST_DEBUG ("Loaded config cache %s", cache_path);
+  }
+
+  g_free (cache_path);
+
+  return config_cache[media_type];
+}
+
+static void
+append_factory_version (GString *versions, GstElementFactory *factory)
+{
+  GstPluginFeature *feature = GST_PLUGIN_FEATURE (factory);
+  GstPlugin *plugin = NULL;
+
+  if (versions->len)
+    g_string_append_c (versions, ';');
+
+  g_string_append (versions, gst_plugin_feature_get_name (feature));
+  g_string_append_c (versions, '=');
+
+  if (feature->plugin_name)
+    plugin = gst_default_registry_find_plugin (feature->plugin_name);
+
+  if (plugin)
+  {
+    g_string_append (versions, gst_plugin_get_version (plugin));
+    gst_object_unref (plugin);
+  }
+}
+
+/*
+ * Returns the key of the config cache for this encoder setup and the
+ * versions of the elements it uses in @versions
+ */
+static gchar *
+codec_config_cache_key (CodecBlueprint *blueprint, const gchar *send_profile,
+    const FsCodec *send_codec, const gchar *input_caps, gchar **versions)
+{
+  GString *key = g_string_new (NULL);
+  GString *versions_str = g_string_new (NULL);
+  GstCaps *caps;
+  gchar *caps_str;
+  GList *walk, *walk2;
+
+  if (send_profile)
+  {
+    gchar **elements = g_strsplit (send_profile, "!", -1);
+    gint i;
+
+    g_string_append (key, send_profile);
+
+    /* Only the elements named by their factory are taken into account */
+    for (i = 0; elements[i]; i++)
+    {
+      gchar **words = g_strsplit_set (g_strstrip (elements[i]), " \t", 2);
+      GstElementFactory *factory = NULL;
+
+      if (words[0] && words[0][0])
+        factory = gst_element_factory_find (words[0]);
+      if (factory)
+      {
+        append_factory_version (versions_str, factory);
+        gst_object_unref (factory);
+      }
+      g_strfreev (words);
+    }
+    g_strfreev (elements);
+  }
+  else if (blueprint)
+  {
+    for (walk = blueprint->send_pipeline_factory; walk;
+         walk = g_list_next (walk))
+    {
+      if (walk != blueprint->send_pipeline_factory)
+        g_string_append (key, " ! ");
+      for (walk2 = walk->data; walk2; walk2 = g_list_next (walk2))
+      {
+        if (walk2 != walk->data)
+          g_string_append_c (key, ',');
+        g_string_append (key,
+            gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (walk2->data)));
+        append_factory_version (versions_str, walk2->data);
+      }
+    }
+  }
+
+  /* The config does not depend on the payload type */
+  caps = fs_codec_to_gst_caps (send_codec);
+  gst_structure_remove_field (gst_caps_get_structure (caps, 0), "payload");
+  caps_str = gst_caps_to_string (caps);
+  gst_caps_unref (caps);
+
+  g_string_append_c (key, '\n');
+  g_string_append (key, caps_str);
+  g_free (caps_str);
+
+  /* The same encoder can produce another config from other raw media */
+  g_string_append_c (key, '\n');
+  g_string_append (key, input_caps);
+
+  *versions = g_string_free (versions_str, FALSE);
+  return g_string_free (key, FALSE);
+}
+
+static gchar *
+codec_config_cache_input_caps_string (const GstCaps *input_caps)
+{
+  if (!input_caps || !gst_caps_is_fixed (input_caps))
+    return g_strdup (CONFIG_CACHE_ANY_INPUT_CAPS);
+  else
+    return gst_caps_to_string (input_caps);
+}
+
+/**
+ * lookup_codec_config_cache:
+ * @blueprint: the #CodecBlueprint of the codec, or %NULL
+ * @send_profile: the send profile of the codec, or %NULL
+ * @send_codec: the #FsCodec used to build the encoder
+ * @input_caps: the caps of the media fed to the encoder, or %NULL if they
+ *  are not known yet
+ * @codec: the #FsCodec to which the cached config parameters are added
+ *
+ * Looks for the config parameters discovered earlier with the same encoder
+ * setup. An entry for which the version of any element changed since it
+ * was stored is removed. If @input_caps is %NULL, the config that was
+ * discovered last for this encoder setup is used.
+ *
+ * Returns: %TRUE if the config parameters were found and added to @codec
+ */
+gboolean
+lookup_codec_config_cache (CodecBlueprint *blueprint,
+    const gchar *send_profile, const FsCodec *send_codec,
+    const GstCaps *input_caps, FsCodec *codec)
+{
+  GKeyFile *cache;
+  gchar *key, *versions;
+  gchar *group = NULL;
+  gchar *stored = NULL;
+  gchar **names = NULL;
+  gchar **values = NULL;
+  gsize names_len = 0, values_len = 0;
+  gboolean ret = FALSE;
+  gchar *input_caps_str;
+  gsize i;
+
+  if (!blueprint && !send_profile)
+    return FALSE;
+
+  input_caps_str = codec_config_cache_input_caps_string (input_caps);
+  key = codec_config_cache_key (blueprint, send_profile, send_codec,
+      input_caps_str, &versions);
+  g_free (input_caps_str);
+  group = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+
+  g_static_mutex_lock (&config_cache_mutex);
+
+  cache = get_codec_config_cache_locked (codec->media_type);
+  if (!cache || !g_key_file_has_group (cache, group))
+    goto out;
+
+  stored = g_key_file_get_string (cache, group, "Key", NULL);
+  if (!stored || strcmp (stored, key))
+    goto out;
+  g_free (stored);
+
+  stored = g_key_file_get_string (cache, group, "Versions", NULL);
+  if (!stored || strcmp (stored, versions))
+  {
+    GST_DEBUG ("Cached config for " FS_CODEC_FORMAT " is outdated (%s != %s)",
+        FS_CODEC_ARGS (send_codec), stored, versions);
+    g_key_file_remove_group (cache, group, NULL);
+    config_cache_dirty[codec->media_type] = TRUE;
+    goto out;
+  }
+
+  names = g_key_file_get_string_list (cache, group, "ParamNames", &names_len,
+      NULL);
+  values = g_key_file_get_string_list (cache, group, "ParamValues",
+      &values_len, NULL);
+  if (!names || !values || names_len != values_len)
+  {
+    GST_WARNING ("Invalid entry in the config cache, removing it");
+    g_key_file_remove_group (cache, group, NULL);
+    config_cache_dirty[codec->media_type] = TRUE;
+    goto out;
+  }
+
+  for (i = 0; i < names_len; i++)
+  {
+    FsCodecParameter *param = fs_codec_get_optional_parameter (codec,
+        names[i], NULL);
+
+    if (param)
+      fs_codec_remove_optional_parameter (codec, param);
+    fs_codec_add_optional_parameter (codec, names[i], values[i]);
+  }
+
+  GST_DEBUG ("Got config for " FS_CODEC_FORMAT " from the cache",
+      FS_CODEC_ARGS (codec));
+  ret = TRUE;
+
+ out:
+  g_static_mutex_unlock (&config_cache_mutex);
+
+  g_strfreev (names);
+  g_strfreev (values);
+  g_free (stored);
+  g_free (group);
+  g_free (versions);
+  g_free (key);
+
+  return ret;
+}
+
+/* Must be called with the config cache mutex held */
+static void
+store_codec_config_cache_entry_locked (CodecBlueprint *blueprint,
+    const gchar *send_profile, const FsCodec *send_codec,
+    const gchar *input_caps, const FsCodec *codec,
+    GPtrArray *names, GPtrArray *values)
+{
+  GKeyFile *cache;
+  gchar *key, *versions;
+  gchar *group;
+  gchar **old_names = NULL, **old_values = NULL;
+  gsize old_names_len = 0, old_values_len = 0;
+  guint i;
+
+  key = codec_config_cache_key (blueprint, send_profile, send_codec,
+      input_caps, &versions);
+  group = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+
+  cache = get_codec_config_cache_locked (codec->media_type);
+  if (!cache)
+    goto out;
+
+  /* Don't dirty the cache if nothing changed, an entry whose lists do not
+   * have the same length (corrupted file) is stale and is overwritten */
+  old_names = g_key_file_get_string_list (cache, group, "ParamNames",
+      &old_names_len, NULL);
+  old_values = g_key_file_get_string_list (cache, group, "ParamValues",
+      &old_values_len, NULL);
+  if (old_names && old_values && old_names_len == old_values_len &&
+      old_names_len == names->len)
+  {
+    for (i = 0; i < names->len; i++)
+      if (strcmp (old_names[i], g_ptr_array_index (names, i)) ||
+          strcmp (old_values[i], g_ptr_array_index (values, i)))
+        break;
+    if (i == names->len)
+      goto out;
+  }
+
+  g_key_file_set_string (cache, group, "Key", key);
+  g_key_file_set_string (cache, group, "Versions", versions);
+  g_key_file_set_string_list (cache, group, "ParamNames",
+      (const gchar * const *) names->pdata, names->len);
+  g_key_file_set_string_list (cache, group, "ParamValues",
+      (const gchar * const *) values->pdata, values->len);
+  config_cache_dirty[codec->media_type] = TRUE;
+
+ out:
+  g_strfreev (old_names);
+  g_strfreev (old_values);
+  g_free (group);
+  g_free (versions);
+  g_free (key);
+}
+
+/**
+ * store_codec_config_cache:
+ * @blueprint: the #CodecBlueprint of the codec, or %NULL
+ * @send_profile: the send profile of the codec, or %NULL
+ * @send_codec: the #FsCodec used to build the encoder
+ * @input_caps: the caps of the media fed to the encoder, or %NULL if they
+ *  are not known
+ * @codec: the #FsCodec with the discovered config parameters
+ *
+ * Remembers the config parameters of @codec for this encoder setup, replacing
+ * the previous ones if they were different. It is only written to disk by
+ * save_codec_config_cache().
+ */
+void
+store_codec_config_cache (CodecBlueprint *blueprint,
+    const gchar *send_profile, const FsCodec *send_codec,
+    const GstCaps *input_caps, const FsCodec *codec)
+{
+  GPtrArray *names = g_ptr_array_new ();
+  GPtrArray *values = g_ptr_array_new ();
+  gchar *input_caps_str;
+  GList *item;
+
+  if (!blueprint && !send_profile)
+    return;
+
+  for (item = codec->optional_params; item; item = g_list_next (item))
+  {
+    FsCodecParameter *param = item->data;
+
+    if (codec_has_config_data_named ((FsCodec *) codec, param->name))
+    {
+      g_ptr_array_add (names, param->name);
+      g_ptr_array_add (values, param->value);
+    }
+  }
+
+  /* Nothing was discovered, there is nothing worth remembering */
+  if (names->len == 0)
+  {
+    g_ptr_array_free (names, TRUE);
+    g_ptr_array_free (values, TRUE);
+    return;
+  }
+
+  input_caps_str = codec_config_cache_input_caps_string (input_caps);
+
+  g_static_mutex_lock (&config_cache_mutex);
+
+  /* The entry for these input caps and the one used before the input caps
+   * are known */
+  if (strcmp (input_caps_str, CONFIG_CACHE_ANY_INPUT_CAPS))
+    store_codec_config_cache_entry_locked (blueprint, send_profile,
+        send_codec, input_caps_str, codec, names, values);
+  store_codec_config_cache_entry_locked (blueprint, send_profile,
+      send_codec, CONFIG_CACHE_ANY_INPUT_CAPS, codec, names, values);
+
+  g_static_mutex_unlock (&config_cache_mutex);
+
+  g_free (input_caps_str);
+  g_ptr_array_free (names, TRUE);
+  g_ptr_array_free (values, TRUE);
+}
+
+/**
+ * invalidate_codec_config_cache:
+ * @media_type: a #FsMediaType
+ *
+ * Drops all of the cached config parameters of this media type, it is
+ * called when the codecs cache is rebuilt because the installed elements
+ * changed.
+ */
+void
+invalidate_codec_config_cache (FsMediaType media_type)
+{
+  GKeyFile *cache;
+  gchar **groups;
+  gint i;
+
+  g_static_mutex_lock (&config_cache_mutex);
+  cache = get_codec_config_cache_locked (media_type);
+  if (cache)
+  {
+    groups = g_key_file_get_groups (cache, NULL);
+    for (i = 0; groups[i]; i++)
+      g_key_file_remove_group (cache, groups[i], NULL);
+    if (i)
+      config_cache_dirty[media_type] = TRUE;
+    g_strfreev (groups);
+  }
+  g_static_mutex_unlock (&config_cache_mutex);
+}
+
+/**
+ * save_codec_config_cache:
+ * @media_type: a #FsMediaType
+ *
+ * Writes the config cache to disk if it was modified
+ *
+ * Returns: %FALSE if it could not be written
+ */
+gboolean
+save_codec_config_cache (FsMediaType media_type)
+{
+  gchar *cache_path;
+  gchar *dir;
+  gchar *data = NULL;
+  gsize length;
+  GError *error = NULL;
+  gboolean ret = TRUE;
+
+  if (media_type > FS_MEDIA_TYPE_LAST)
+    return FALSE;
+
+  g_static_mutex_lock (&config_cache_mutex);
+
+  if (!config_cache[media_type] || !config_cache_dirty[media_type])
+    goto out;
+
+  cache_path = get_codec_config_cache_path (media_type);
+  if (!cache_path)
+  {
+    ret = FALSE;
+    goto out;
+  }
+
+  data = g_key_file_to_data (config_cache[media_type], &length, NULL);
+
+  dir = g_path_get_dirname (cache_path);
+  g_mkdir_with_parents (dir, 0777);
+  g_free (dir);
+
+  if (g_file_set_contents (cache_path, data, length, &error))
+  {
+    GST_DEBUG ("Wrote config cache %s", cache_path);
+    config_cache_dirty[media_type] = FALSE;
+  }
+  else
+  {
+    GST_DEBUG ("Unable to save config cache %s: %s", cache_path,
+        error->message);
+    g_clear_error (&error);
+    ret = FALSE;
+  }
+
+  g_free (data);
+  g_free (cache_path);
+
+ out:
+  g_static_mutex_unlock (&config_cache_mutex);
+
+  return ret;
+}
+
+static gpointer
+save_codec_config_cache_thread (gpointer data)
+{
+  FsMediaType media_type = GPOINTER_TO_INT (data);
+
+  g_static_mutex_lock (&config_cache_mutex);
+  config_cache_save_pending[media_type] = FALSE;
+  g_static_mutex_unlock (&config_cache_mutex);
+
+  save_codec_config_cache (media_type);
+
+  return NULL;
+}
+
+/**
+ * save_codec_config_cache_async:
+ * @media_type: a #FsMediaType
+ *
+ * Writes the config cache to disk from another thread if it was modified,
+ * so that streaming threads never wait on the disk.
+ */
+void
+save_codec_config_cache_async (FsMediaType media_type)
+{
+  GError *error = NULL;
+
+  if (media_type > FS_MEDIA_TYPE_LAST)
+    return;
+
+  g_static_mutex_lock (&config_cache_mutex);
+  if (!config_cache_dirty[media_type] || config_cache_save_pending[media_type])
+  {
+    g_static_mutex_unlock (&config_cache_mutex);
+    return;
+  }
+  config_cache_save_pending[media_type] = TRUE;
+  g_static_mutex_unlock (&config_cache_mutex);
+
+  if (!g_thread_create (save_codec_config_cache_thread,
+          GINT_TO_POINTER (media_type), FALSE, &error))
+  {
+    GST_WARNING ("Could not start the thread to save the config cache: %s",
+        error ? error->message : "unknown error");
+    g_clear_error (&error);
+
+    g_static_mutex_lock (&config_cache_mutex);
+    config_cache_save_pending[media_type] = FALSE;
+    g_static_mutex_unlock (&config_cache_mutex);
+  }
+}
@@ -31,9 +31,20 @@
 
 G_BEGIN_DECLS
 
-GList *load_codecs_cache (FsMediaType media_type);
+gboolean load_codecs_cache (FsMediaType media_type, GList **blueprints,
+    GList **changed_factories, GstCaps **stale_caps);
 gboolean save_codecs_cache (FsMediaType media_type, GList *codec_blueprints);
 
+gboolean lookup_codec_config_cache (CodecBlueprint *blueprint,
+    const gchar *send_profile, const FsCodec *send_codec,
+    const GstCaps *input_caps, FsCodec *codec);
+void store_codec_config_cache (CodecBlueprint *blueprint,
+    const gchar *send_profile, const FsCodec *send_codec,
+    const GstCaps *input_caps, const FsCodec *codec);
+void invalidate_codec_config_cache (FsMediaType media_type);
+gboolean save_codec_config_cache (FsMediaType media_type);
+void save_codec_config_cache_async (FsMediaType media_type);
+
 
 G_END_DECLS
 
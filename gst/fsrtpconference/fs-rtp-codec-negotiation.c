@@ -28,6 +28,7 @@
 
 #include "fs-rtp-codec-negotiation.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "fs-rtp-codec-specific.h"
@@ -360,7 +361,7 @@ _find_matching_blueprint (FsCodec *codec, GList *blueprints)
   {
     CodecBlueprint *bp = item->data;
 
-    if (gst_caps_can_intersect (caps, bp->rtp_caps))
+    if (gst_caps_can_intersect (caps, codec_blueprint_get_rtp_caps (bp)))
       break;
   }
 
@@ -410,7 +411,7 @@ _is_disabled (GList *codec_prefs, CodecBlueprint *bp)
     if (!caps)
       continue;
 
-    if (gst_caps_can_intersect (caps, bp->rtp_caps))
+    if (gst_caps_can_intersect (caps, codec_blueprint_get_rtp_caps (bp)))
       ok = TRUE;
 
     gst_caps_unref (caps);
@@ -1136,6 +1137,218 @@ lookup_codec_association_by_codec (GList *codec_associations, FsCodec *codec)
   return NULL;
 }
 
+/*
+ * The fingerprints follow the rules of fs_codec_are_equal(): the encoding
+ * and parameter names are hashed case-insensitively and the order of the
+ * optional parameters doesn't matter.
+ */
+
+#define FINGERPRINT_INIT G_GUINT64_CONSTANT (14695981039346656037)
+#define FINGERPRINT_PRIME G_GUINT64_CONSTANT (1099511628211)
+
+static inline guint64
+fingerprint_add_uint (guint64 hash, guint64 value)
+{
+  guint i;
+
+  for (i = 0; i < 8; i++, value >>= 8)
+    hash = (hash ^ (value & 0xff)) * FINGERPRINT_PRIME;
+
+  return hash;
+}
+
+static guint64
+fingerprint_add_string (guint64 hash, const gchar *str, gboolean casefold)
+{
+  if (!str)
+    return fingerprint_add_uint (hash, 0);
+
+  for (; *str; str++)
+    hash = (hash ^ (guchar) (casefold ? g_ascii_tolower (*str) : *str)) *
+      FINGERPRINT_PRIME;
+
+  /* Terminate it so that "ab" "c" and "a" "bc" differ */
+  return (hash ^ 0xff) * FINGERPRINT_PRIME;
+}
+
+static gint
+compare_uint64 (gconstpointer a, gconstpointer b)
+{
+  guint64 value1 = *(const guint64 *) a;
+  guint64 value2 = *(const guint64 *) b;
+
+  if (value1 < value2)
+    return -1;
+  else if (value1 > value2)
+    return 1;
+  else
+    return 0;
+}
+
+static guint64
+codec_fingerprint (FsCodec *codec)
+{
+  guint64 hash = FINGERPRINT_INIT;
+  guint64 *param_hashes;
+  guint n_params;
+  GList *item;
+  guint i;
+
+  if (!codec)
+    return hash;
+
+  hash = fingerprint_add_uint (hash, codec->id);
+  hash = fingerprint_add_uint (hash, codec->media_type);
+  hash = fingerprint_add_uint (hash, codec->clock_rate);
+  hash = fingerprint_add_uint (hash, codec->channels);
+  hash = fingerprint_add_uint (hash, codec->ABI.ABI.ptime);
+  hash = fingerprint_add_uint (hash, codec->ABI.ABI.maxptime);
+  hash = fingerprint_add_string (hash, codec->encoding_name, TRUE);
+
+  /* The parameters are a set, so their hashes are sorted and the duplicates
+   * are skipped before they are combined */
+  n_params = g_list_length (codec->optional_params);
+  param_hashes = g_newa (guint64, n_params + 1);
+
+  for (item = codec->optional_params, i = 0; item; item = item->next, i++)
+  {
+    FsCodecParameter *param = item->data;
+
+    param_hashes[i] = fingerprint_add_string (
+        fingerprint_add_string (FINGERPRINT_INIT, param->name, TRUE),
+        param->value, FALSE);
+  }
+
+  qsort (param_hashes, n_params, sizeof (guint64), compare_uint64);
+
+  for (i = 0; i < n_params; i++)
+    if (i == 0 || param_hashes[i] != param_hashes[i - 1])
+      hash = fingerprint_add_uint (hash, param_hashes[i]);
+
+  return hash;
+}
+
+/**
+ * codec_list_fingerprint:
+ * @codecs: a #GList of #FsCodec
+ *
+ * Computes a 64 bit fingerprint of a list of codecs. Two lists that
+ * fs_codec_list_are_equal() considers equal always have the same
+ * fingerprint, and the chances of two different lists having the same one
+ * are negligible, so it can be used to detect changes without comparing
+ * the lists.
+ *
+ * Returns: the fingerprint, never 0
+ */
+
+guint64
+codec_list_fingerprint (GList *codecs)
+{
+  guint64 hash = FINGERPRINT_INIT;
+
+  for (; codecs; codecs = g_list_next (codecs))
+    hash = fingerprint_add_uint (hash, codec_fingerprint (codecs->data));
+
+  return hash ? hash : 1;
+}
+
+/**
+ * codec_associations_list_fingerprint:
+ * @list: a #GList of #CodecAssociation
+ *
+ * Same as codec_list_fingerprint(), but for the #CodecAssociation that
+ * codec_associations_list_are_equal() looks at.
+ *
+ * Returns: the fingerprint, never 0
+ */
+
+guint64
+codec_associations_list_fingerprint (GList *list)
+{
+  guint64 hash = FINGERPRINT_INIT;
+
+  for (; list; list = g_list_next (list))
+  {
+    CodecAssociation *ca = list->data;
+
+    /* Same test as in codec_associations_list_are_equal() */
+    if (ca->disable && ca->reserved)
+      continue;
+
+    hash = fingerprint_add_uint (hash, ca->recv_only);
+    hash = fingerprint_add_uint (hash, codec_fingerprint (ca->codec));
+  }
+
+  return hash ? hash : 1;
+}
+
+/**
+ * codec_association_list_copy:
+ * @list: a #GList of #CodecAssociation
+ *
+ * Makes a deep copy of a #GList of #CodecAssociation
+ *
+ * Returns: a new #GList of #CodecAssociation
+ */
+
+GList *
+codec_association_list_copy (GList *list)
+{
+  GList *copy = NULL;
+  GList *item;
+
+  for (item = list; item; item = g_list_next (item))
+    copy = g_list_prepend (copy, codec_association_copy (item->data));
+
+  return g_list_reverse (copy);
+}
+
+static gboolean
+codecs_are_equal_or_null (FsCodec *codec1, FsCodec *codec2)
+{
+  if (codec1 == NULL || codec2 == NULL)
+    return codec1 == codec2;
+
+  return fs_codec_are_equal (codec1, codec2);
+}
+
+/**
+ * codec_associations_list_are_identical:
+ * @list1: a #GList of #CodecAssociation
+ * @list2: a #GList of #CodecAssociation
+ *
+ * Compares two lists of #CodecAssociation including the disabled and
+ * reserved ones and all of their flags, unlike
+ * codec_associations_list_are_equal() which only compares what the user
+ * can see.
+ *
+ * Returns: %TRUE if negotiating against either list gives the same result
+ */
+
+gboolean
+codec_associations_list_are_identical (GList *list1, GList *list2)
+{
+  for (; list1 && list2;
+       list1 = g_list_next (list1), list2 = g_list_next (list2))
+  {
+    CodecAssociation *ca1 = list1->data;
+    CodecAssociation *ca2 = list2->data;
+
+    if (ca1->blueprint != ca2->blueprint ||
+        ca1->reserved != ca2->reserved ||
+        ca1->disable != ca2->disable ||
+        ca1->need_config != ca2->need_config ||
+        ca1->recv_only != ca2->recv_only ||
+        g_strcmp0 (ca1->send_profile, ca2->send_profile) ||
+        g_strcmp0 (ca1->recv_profile, ca2->recv_profile) ||
+        !codecs_are_equal_or_null (ca1->codec, ca2->codec) ||
+        !codecs_are_equal_or_null (ca1->send_codec, ca2->send_codec))
+      return FALSE;
+  }
+
+  return (list1 == NULL && list2 == NULL);
+}
+
 /**
  * codec_association_list_destroy:
  * @list: a #GList of #CodecAssociation
@@ -1369,3 +1582,196 @@ lookup_codec_association_by_codec_for_sending (GList *codec_associations,
 
   return NULL;
 }
+
+
+/*
+ * The CodecAssociationTable is an index over a list of CodecAssociation that
+ * is built once per negotiation and never modified afterwards. It has a
+ * direct index by payload type and one by encoding name, and the caps that
+ * are given to rtpbin for each payload type so they can be handed out
+ * without looking at the CodecAssociation themselves.
+ */
+
+struct _CodecAssociationTable {
+  GList *codec_associations;
+  CodecAssociation *by_pt[128];
+  GstCaps *pt_caps[128];
+  GHashTable *by_name;  /* lowercase encoding-name -> GList of CA */
+};
+
+static void
+free_name_bucket (GList *bucket)
+{
+  g_list_free (bucket);
+}
+
+/**
+ * codec_association_table_new:
+ * @codec_associations: a #GList of #CodecAssociation
+ *
+ * Indexes a list of #CodecAssociation, the list is not copied and must not
+ * be modified or destroyed while the table is used.
+ *
+ * Returns: a new #CodecAssociationTable
+ */
+
+CodecAssociationTable *
+codec_association_table_new (GList *codec_associations)
+{
+  CodecAssociationTable *table = g_slice_new0 (CodecAssociationTable);
+  GList *item;
+
+  table->codec_associations = codec_associations;
+  table->by_name = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) free_name_bucket);
+
+  for (item = codec_associations; item; item = g_list_next (item))
+  {
+    CodecAssociation *ca = item->data;
+    gint pt = ca->codec->id;
+
+    if (ca->codec->encoding_name)
+    {
+      gchar *name = g_ascii_strdown (ca->codec->encoding_name, -1);
+      GList *bucket = g_hash_table_lookup (table->by_name, name);
+
+      /* There are rarely more than a couple of codecs with the same name,
+       * appending keeps them in the order of the list */
+      if (bucket)
+      {
+        bucket = g_list_append (bucket, ca);
+        g_free (name);
+      }
+      else
+      {
+        g_hash_table_insert (table->by_name, name, g_list_append (NULL, ca));
+      }
+    }
+
+    /* Same as lookup_codec_association_by_pt(), the first usable one wins */
+    if (pt >= 0 && pt < 128 && !table->by_pt[pt] &&
+        !ca->disable && !ca->reserved)
+    {
+      FsCodec *codec = codec_copy_filtered (ca->codec, FS_PARAM_TYPE_CONFIG);
+
+      table->by_pt[pt] = ca;
+      table->pt_caps[pt] = fs_codec_to_gst_caps (codec);
+      fs_codec_destroy (codec);
+    }
+  }
+
+  return table;
+}
+
+void
+codec_association_table_free (CodecAssociationTable *table)
+{
+  guint i;
+
+  if (!table)
+    return;
+
+  for (i = 0; i < 128; i++)
+    if (table->pt_caps[i])
+      gst_caps_unref (table->pt_caps[i]);
+
+  g_hash_table_destroy (table->by_name);
+  g_slice_free (CodecAssociationTable, table);
+}
+
+/**
+ * codec_association_table_lookup_by_pt:
+ * @table: a #CodecAssociationTable or %NULL
+ * @pt: a payload-type number
+ *
+ * Same as lookup_codec_association_by_pt() on the indexed list
+ *
+ * Returns: a #CodecAssociation
+ */
+
+CodecAssociation *
+codec_association_table_lookup_by_pt (CodecAssociationTable *table, gint pt)
+{
+  if (!table || pt < 0 || pt >= 128)
+    return NULL;
+
+  return table->by_pt[pt];
+}
+
+/**
+ * codec_association_table_get_pt_caps:
+ * @table: a #CodecAssociationTable or %NULL
+ * @pt: a payload-type number
+ *
+ * Gets the caps of the codec with this payload type, without its config
+ * parameters, as they are given to rtpbin. Only reads the table itself so it
+ * can be called while the #CodecAssociation are being modified.
+ *
+ * Returns: a new reference to a #GstCaps or %NULL
+ */
+
+GstCaps *
+codec_association_table_get_pt_caps (CodecAssociationTable *table, guint pt)
+{
+  if (!table || pt >= 128 || !table->pt_caps[pt])
+    return NULL;
+
+  return gst_caps_ref (table->pt_caps[pt]);
+}
+
+static GList *
+codec_association_table_lookup_name (CodecAssociationTable *table,
+    const gchar *encoding_name)
+{
+  gchar *name;
+  GList *bucket;
+
+  if (!table || !encoding_name)
+    return NULL;
+
+  name = g_ascii_strdown (encoding_name, -1);
+  bucket = g_hash_table_lookup (table->by_name, name);
+  g_free (name);
+
+  return bucket;
+}
+
+/**
+ * codec_association_table_lookup_by_codec:
+ * @table: a #CodecAssociationTable or %NULL
+ * @codec: The #FsCodec to look for
+ *
+ * Same as lookup_codec_association_by_codec() on the indexed list, but
+ * only looks at the associations with the same encoding name
+ *
+ * Returns: a #CodecAssociation
+ */
+
+CodecAssociation *
+codec_association_table_lookup_by_codec (CodecAssociationTable *table,
+    FsCodec *codec)
+{
+  return lookup_codec_association_by_codec (
+      codec_association_table_lookup_name (table, codec->encoding_name),
+      codec);
+}
+
+/**
+ * codec_association_table_lookup_by_codec_for_sending:
+ * @table: a #CodecAssociationTable or %NULL
+ * @codec: The #FsCodec to look for
+ *
+ * Same as lookup_codec_association_by_codec_for_sending() on the indexed
+ * list, but only looks at the associations with the same encoding name
+ *
+ * Returns: a #CodecAssociation
+ */
+
+CodecAssociation *
+codec_association_table_lookup_by_codec_for_sending (
+    CodecAssociationTable *table, FsCodec *codec)
+{
+  return lookup_codec_association_by_codec_for_sending (
+      codec_association_table_lookup_name (table, codec->encoding_name),
+      codec);
+}
@@ -110,15 +110,49 @@ codec_associations_to_send_codecs (GList *codec_associations);
 gboolean
 codec_associations_list_are_equal (GList *list1, GList *list2);
 
+guint64
+codec_list_fingerprint (GList *codecs);
+
+guint64
+codec_associations_list_fingerprint (GList *list);
+
 void
 codec_association_list_destroy (GList *list);
 
+GList *
+codec_association_list_copy (GList *list);
+
+gboolean
+codec_associations_list_are_identical (GList *list1, GList *list2);
+
 typedef gboolean (*CAFindFunc) (CodecAssociation *ca, gpointer user_data);
 
 CodecAssociation *
 lookup_codec_association_custom (GList *codec_associations,
     CAFindFunc func, gpointer user_data);
 
+typedef struct _CodecAssociationTable CodecAssociationTable;
+
+CodecAssociationTable *
+codec_association_table_new (GList *codec_associations);
+
+void
+codec_association_table_free (CodecAssociationTable *table);
+
+CodecAssociation *
+codec_association_table_lookup_by_pt (CodecAssociationTable *table, gint pt);
+
+GstCaps *
+codec_association_table_get_pt_caps (CodecAssociationTable *table, guint pt);
+
+CodecAssociation *
+codec_association_table_lookup_by_codec (CodecAssociationTable *table,
+    FsCodec *codec);
+
+CodecAssociation *
+codec_association_table_lookup_by_codec_for_sending (
+    CodecAssociationTable *table, FsCodec *codec);
+
 GstElement *
 parse_bin_from_description_all_linked (const gchar *bin_description,
     guint *src_pad_count, guint *sink_pad_count, GError **error);
@@ -281,18 +281,135 @@ static const struct SdpNegoFunction sdp_nego_functions[] = {
   {0, NULL, NULL}
 };
 
+/*
+ * The tables above are indexed once, the first time they are used: the
+ * negotiation functions are put in a case-insensitive hash table per media
+ * type and the names of their parameters are interned as lowercase quarks.
+ * The lookups done for every parameter of every codec during a negotiation
+ * then only compare integers.
+ */
+
+struct SdpNegoIndex {
+  GHashTable *functions[FS_MEDIA_TYPE_LAST + 1];
+  GQuark param_quarks[G_N_ELEMENTS (sdp_nego_functions)][MAX_PARAMS];
+  GQuark ptime_quark;
+  GQuark maxptime_quark;
+};
+
+static guint
+ascii_strcase_hash (gconstpointer key)
+{
+  const gchar *p;
+  guint hash = 5381;
+
+  for (p = key; *p; p++)
+    hash = (hash << 5) + hash + g_ascii_tolower (*p);
+
+  return hash;
+}
+
+static gboolean
+ascii_strcase_equal (gconstpointer a, gconstpointer b)
+{
+  return !g_ascii_strcasecmp (a, b);
+}
+
+static gpointer
+sdp_nego_index_init (gpointer data)
+{
+  struct SdpNegoIndex *index = g_new0 (struct SdpNegoIndex, 1);
+  gint i, j;
+
+  for (i = 0; i <= FS_MEDIA_TYPE_LAST; i++)
+    index->functions[i] = g_hash_table_new (ascii_strcase_hash,
+        ascii_strcase_equal);
+
+  for (i = 0; sdp_nego_functions[i].sdp_negotiate_codec; i++)
+  {
+    const struct SdpNegoFunction *nf = &sdp_nego_functions[i];
+
+    /* Keep the first one if there are duplicates, like the linear scan did */
+    if (!g_hash_table_lookup (index->functions[nf->media_type],
+            nf->encoding_name))
+      g_hash_table_insert (index->functions[nf->media_type],
+          (gpointer) nf->encoding_name, (gpointer) nf);
+
+    /* The names in the table are all lowercase */
+    for (j = 0; j < MAX_PARAMS && nf->params[j].name; j++)
+      index->param_quarks[i][j] =
+        g_quark_from_static_string (nf->params[j].name);
+  }
+
+  index->ptime_quark = g_quark_from_static_string ("ptime");
+  index->maxptime_quark = g_quark_from_static_string ("maxptime");
+
+  return index;
+}
+
+static const struct SdpNegoIndex *
+get_sdp_nego_index (void)
+{
+  static GOnce index_once = G_ONCE_INIT;
+
+  return g_once (&index_once, sdp_nego_index_init, NULL);
+}
+
+/*
+ * Returns the quark of the lowercase version of @name, or 0 if there is
+ * none, in which case it can't be the name of any known parameter
+ */
+static GQuark
+param_name_quark (const gchar *name)
+{
+  gchar buf[64];
+  gchar *lower;
+  GQuark quark;
+  gsize i;
+
+  for (i = 0; name[i] && i < sizeof (buf) - 1; i++)
+    buf[i] = g_ascii_tolower (name[i]);
+
+  if (!name[i])
+  {
+    buf[i] = 0;
+    return g_quark_try_string (buf);
+  }
+
+  lower = g_ascii_strdown (name, -1);
+  quark = g_quark_try_string (lower);
+  g_free (lower);
+
+  return quark;
+}
+
 static const struct SdpNegoFunction *
 get_sdp_nego_function (FsMediaType media_type, const gchar *encoding_name)
 {
-  int i;
+  const struct SdpNegoIndex *index = get_sdp_nego_index ();
 
-  for (i = 0; sdp_nego_functions[i].sdp_negotiate_codec; i++)
-    if (sdp_nego_functions[i].media_type == media_type &&
-        !g_ascii_strcasecmp (sdp_nego_functions[i].encoding_name,
-            encoding_name))
-      return &sdp_nego_functions[i];
+  if (media_type > FS_MEDIA_TYPE_LAST || !encoding_name)
+    return NULL;
 
-  return NULL;
+  return g_hash_table_lookup (index->functions[media_type], encoding_name);
+}
+
+/* Returns the index of the param named @param_quark in @nf or -1 */
+static gint
+sdp_nego_function_find_param (const struct SdpNegoFunction *nf,
+    GQuark param_quark)
+{
+  const struct SdpNegoIndex *index = get_sdp_nego_index ();
+  const GQuark *quarks = index->param_quarks[nf - sdp_nego_functions];
+  gint i;
+
+  if (!param_quark)
+    return -1;
+
+  for (i = 0; i < MAX_PARAMS && quarks[i]; i++)
+    if (quarks[i] == param_quark)
+      return i;
+
+  return -1;
 }
 
 
@@ -338,12 +455,9 @@ codec_param_check_type (const struct SdpNegoFunction *nf,
   if (!nf)
     return FALSE;
 
-  for (i = 0; nf->params[i].name; i++)
-    if (nf->params[i].paramtype & paramtypes &&
-        !g_ascii_strcasecmp (nf->params[i].name, param_name))
-      return TRUE;
+  i = sdp_nego_function_find_param (nf, param_name_quark (param_name));
 
-  return FALSE;
+  return (i >= 0 && (nf->params[i].paramtype & paramtypes));
 }
 
 
@@ -377,24 +491,29 @@ codec_has_config_data_named (FsCodec *codec, const gchar *param_name)
 FsCodec *
 codec_copy_filtered (FsCodec *codec, FsParamType paramtypes)
 {
-  FsCodec *copy = fs_codec_copy (codec);
+  FsCodec *copy;
   GList *item = NULL;
   const struct SdpNegoFunction *nf;
 
   nf = get_sdp_nego_function (codec->media_type, codec->encoding_name);
 
-  if (nf)
-  {
-    for (item = copy->optional_params; item;)
-    {
-      FsCodecParameter *param = item->data;
-      GList *next = g_list_next (item);
+  if (!nf)
+    return fs_codec_copy (codec);
 
-      if (codec_param_check_type (nf, param->name, paramtypes))
-        fs_codec_remove_optional_parameter (copy, param);
+  /* Only copy the parameters we keep instead of copying them all and
+   * removing some */
+  copy = fs_codec_new (codec->id, codec->encoding_name, codec->media_type,
+      codec->clock_rate);
+  copy->channels = codec->channels;
+  copy->ABI.ABI.ptime = codec->ABI.ABI.ptime;
+  copy->ABI.ABI.maxptime = codec->ABI.ABI.maxptime;
 
-      item = next;
-    }
+  for (item = codec->optional_params; item; item = g_list_next (item))
+  {
+    FsCodecParameter *param = item->data;
+
+    if (!codec_param_check_type (nf, param->name, paramtypes))
+      fs_codec_add_optional_parameter (copy, param->name, param->value);
   }
 
   return copy;
@@ -457,7 +576,7 @@ sdp_negotiate_codec (FsCodec *local_codec, FsParamType local_paramtypes,
 }
 
 static const struct SdpParam *
-get_sdp_param (const struct SdpNegoFunction *nf, const gchar *param_name)
+get_sdp_param (const struct SdpNegoFunction *nf, GQuark param_quark)
 {
   static const struct SdpParam ptime_params = {
     "ptime", FS_PARAM_TYPE_SEND_AVOID_NEGO, param_minimum
@@ -465,23 +584,23 @@ get_sdp_param (const struct SdpNegoFunction *nf, const gchar *param_name)
   static const struct SdpParam maxptime_params = {
     "maxptime", FS_PARAM_TYPE_SEND_AVOID_NEGO, param_minimum
   };
+  const struct SdpNegoIndex *index = get_sdp_nego_index ();
 
   if (nf)
   {
-    gint i;
+    gint i = sdp_nego_function_find_param (nf, param_quark);
 
-    for (i = 0; nf->params[i].name; i++)
-      if (!g_ascii_strcasecmp (param_name, nf->params[i].name))
-        return &nf->params[i];
+    if (i >= 0)
+      return &nf->params[i];
 
     if (nf->media_type != FS_MEDIA_TYPE_AUDIO)
       return NULL;
   }
 
-  if (!g_ascii_strcasecmp (param_name, "ptime"))
+  if (param_quark == index->ptime_quark)
     return &ptime_params;
 
-  if (!g_ascii_strcasecmp (param_name, "maxptime"))
+  if (param_quark == index->maxptime_quark)
     return &maxptime_params;
 
   return NULL;
@@ -498,7 +617,7 @@ param_negotiate (const struct SdpNegoFunction *nf, const gchar *param_name,
 {
   const struct SdpParam *sdp_param = NULL;
 
-  sdp_param = get_sdp_param (nf, param_name);
+  sdp_param = get_sdp_param (nf, param_name_quark (param_name));
 
   if (sdp_param)
   {
@@ -555,14 +674,42 @@ param_negotiate (const struct SdpNegoFunction *nf, const gchar *param_name,
   return TRUE;
 }
 
+/*
+ * Returns the first parameter of @codec named @name whose entry in @used is
+ * still %FALSE and marks it as used, or %NULL
+ */
+static FsCodecParameter *
+take_unused_param (FsCodec *codec, gboolean *used, const gchar *name)
+{
+  GList *item;
+  guint i;
+
+  for (item = codec->optional_params, i = 0;
+       item;
+       item = g_list_next (item), i++)
+  {
+    FsCodecParameter *param = item->data;
+
+    if (!used[i] && !g_ascii_strcasecmp (param->name, name))
+    {
+      used[i] = TRUE;
+      return param;
+    }
+  }
+
+  return NULL;
+}
+
 static FsCodec *
 sdp_negotiate_codec_default (FsCodec *local_codec, FsParamType local_paramtypes,
     FsCodec *remote_codec, FsParamType remote_paramtypes,
     const struct SdpNegoFunction *nf)
 {
   FsCodec *negotiated_codec = NULL;
-  FsCodec *local_codec_copy = NULL;
   GList *local_param_e = NULL, *remote_param_e = NULL;
+  gboolean *local_param_used;
+  guint n_local_params;
+  guint i;
 
   GST_LOG ("Using default codec negotiation function for %s",
       local_codec->encoding_name);
@@ -576,11 +723,16 @@ sdp_negotiate_codec_default (FsCodec *local_codec, FsParamType local_paramtypes,
     return NULL;
   }
 
-  negotiated_codec = fs_codec_copy (remote_codec);
-  while (negotiated_codec->optional_params)
-    fs_codec_remove_optional_parameter (negotiated_codec,
-        negotiated_codec->optional_params->data);
-
+  /* This is called for every pair of codecs with the same name during a
+   * negotiation, so instead of copying the local codec and removing the
+   * parameters as they are matched, we just mark them on the stack, and the
+   * result starts without parameters instead of being a full copy */
+  negotiated_codec = fs_codec_new (remote_codec->id,
+      remote_codec->encoding_name, remote_codec->media_type,
+      remote_codec->clock_rate);
+  negotiated_codec->channels = remote_codec->channels;
+  negotiated_codec->ABI.ABI.ptime = remote_codec->ABI.ABI.ptime;
+  negotiated_codec->ABI.ABI.maxptime = remote_codec->ABI.ABI.maxptime;
 
   /* Lets fix here missing clock rates and channels counts */
   if (negotiated_codec->channels == 0 && local_codec->channels)
@@ -588,46 +740,46 @@ sdp_negotiate_codec_default (FsCodec *local_codec, FsParamType local_paramtypes,
   if (negotiated_codec->clock_rate == 0)
     negotiated_codec->clock_rate = local_codec->clock_rate;
 
-  local_codec_copy = fs_codec_copy (local_codec);
+  n_local_params = g_list_length (local_codec->optional_params);
+  local_param_used = g_newa (gboolean, n_local_params + 1);
+  for (i = 0; i < n_local_params; i++)
+    local_param_used[i] = FALSE;
 
   for (remote_param_e = remote_codec->optional_params;
        remote_param_e;
        remote_param_e = g_list_next (remote_param_e))
   {
     FsCodecParameter *remote_param = remote_param_e->data;
-    FsCodecParameter *local_param =  fs_codec_get_optional_parameter (
-        local_codec_copy, remote_param->name, NULL);
+    FsCodecParameter *local_param = take_unused_param (local_codec,
+        local_param_used, remote_param->name);
 
     if (!param_negotiate (nf, remote_param->name,
             local_codec, local_param, local_paramtypes,
             remote_codec, remote_param, remote_paramtypes,
             negotiated_codec))
       goto non_matching_codec;
-
-    if (local_param)
-      fs_codec_remove_optional_parameter (local_codec_copy, local_param);
   }
 
-  for (local_param_e = local_codec_copy->optional_params;
+  for (local_param_e = local_codec->optional_params, i = 0;
        local_param_e;
-       local_param_e = g_list_next (local_param_e))
+       local_param_e = g_list_next (local_param_e), i++)
   {
     FsCodecParameter *local_param = local_param_e->data;
 
+    if (local_param_used[i])
+      continue;
+
     if (!param_negotiate (nf, local_param->name,
             local_codec, local_param, local_paramtypes,
             remote_codec, NULL, remote_paramtypes, negotiated_codec))
       goto non_matching_codec;
   }
 
-  fs_codec_destroy (local_codec_copy);
-
   return negotiated_codec;
 
 non_matching_codec:
 
   GST_LOG ("Codecs don't really match");
-  fs_codec_destroy (local_codec_copy);
   fs_codec_destroy (negotiated_codec);
   return NULL;
 }
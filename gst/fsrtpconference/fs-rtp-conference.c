@@ -46,6 +46,7 @@
 #include "fs-rtp-session.h"
 #include "fs-rtp-stream.h"
 #include "fs-rtp-participant.h"
+#include "fs-rtp-discover-codecs.h"
 
 
 GST_DEBUG_CATEGORY (fsrtpconference_debug);
@@ -110,6 +111,9 @@ struct _FsRtpConferencePrivate
 
   /* Array of all internal threads, as GThreads */
   GPtrArray *threads;
+
+  /* Created on first use, protected by GST_OBJECT_LOCK */
+  FsRtpTimerWheel *timer_wheel;
 };
 
 static void fs_rtp_conference_do_init (GType type);
@@ -228,6 +232,12 @@ fs_rtp_conference_finalize (GObject * object)
 
   g_ptr_array_free (self->priv->threads, TRUE);
 
+  if (self->priv->timer_wheel)
+    fs_rtp_timer_wheel_free (self->priv->timer_wheel);
+
+  fs_rtp_blueprints_unref (FS_MEDIA_TYPE_AUDIO);
+  fs_rtp_blueprints_unref (FS_MEDIA_TYPE_VIDEO);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -321,6 +331,14 @@ fs_rtp_conference_init (FsRtpConference *conf,
 
   conf->priv->threads = g_ptr_array_new ();
 
+  /* Find the codecs while the application sets up its pipeline, this is done
+   * here and not when the plugin is loaded because the registry may still
+   * be incomplete at that time. Only the first conference starts the
+   * discovery, every conference keeps the lists alive until it is
+   * finalized */
+  fs_rtp_blueprints_discover_async (FS_MEDIA_TYPE_AUDIO);
+  fs_rtp_blueprints_discover_async (FS_MEDIA_TYPE_VIDEO);
+
   conf->gstrtpbin = gst_element_factory_make ("gstrtpbin", "rtpbin");
 
   if (!conf->gstrtpbin) {
@@ -963,6 +981,29 @@ fs_rtp_conference_is_internal_thread (FsRtpConference *self)
   return ret;
 }
 
+/**
+ * fs_rtp_conference_get_timer_wheel:
+ * @self: a #FsRtpConference
+ *
+ * Gets the timer wheel shared by all of the sessions of this conference,
+ * it is valid as long as the conference is alive.
+ *
+ * Returns: the #FsRtpTimerWheel
+ */
+FsRtpTimerWheel *
+fs_rtp_conference_get_timer_wheel (FsRtpConference *self)
+{
+  FsRtpTimerWheel *wheel;
+
+  GST_OBJECT_LOCK (self);
+  if (!self->priv->timer_wheel)
+    self->priv->timer_wheel = fs_rtp_timer_wheel_new ();
+  wheel = self->priv->timer_wheel;
+  GST_OBJECT_UNLOCK (self);
+
+  return wheel;
+}
+
 GList *
 codecs_copy_with_new_ptime (GList *codecs)
 {
@@ -28,6 +28,8 @@
 
 #include <gst/farsight/fs-base-conference.h>
 
+#include "fs-rtp-timer-wheel.h"
+
 G_BEGIN_DECLS
 
 #define FS_TYPE_RTP_CONFERENCE \
@@ -81,6 +83,8 @@ GList *codecs_copy_with_new_ptime (GList *codecs);
 
 gboolean fs_rtp_conference_is_internal_thread (FsRtpConference *self);
 
+FsRtpTimerWheel *fs_rtp_conference_get_timer_wheel (FsRtpConference *self);
+
 G_END_DECLS
 
 #endif /* __FS_RTP_CONFERENCE_H__ */
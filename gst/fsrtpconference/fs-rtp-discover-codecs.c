@@ -69,11 +69,16 @@ static gboolean create_codec_lists (FsMediaType media_type,
   GList *recv_list, GList *send_list);
 static GList *remove_dynamic_duplicates (GList *list);
 static void parse_codec_cap_list (GList *list, FsMediaType media_type);
-static GList *detect_send_codecs (GstCaps *caps);
-static GList *detect_recv_codecs (GstCaps *caps);
+static GList *detect_send_codecs (GstCaps *caps, GstCaps *restrict_caps);
+static GList *detect_recv_codecs (GstCaps *caps, GstCaps *restrict_caps);
 static GList *codec_cap_list_intersect (GList *list1, GList *list2);
 static GList *get_plugins_filtered_from_caps (FilterFunc filter,
-  GstCaps *caps, GstPadDirection direction);
+  GstCaps *caps, GstPadDirection direction, GstCaps *restrict_caps);
+static gboolean is_payloader (GstElementFactory *factory);
+static gboolean is_depayloader (GstElementFactory *factory);
+static gboolean is_encoder (GstElementFactory *factory);
+static gboolean is_decoder (GstElementFactory *factory);
+static gint compare_ranks (GstPluginFeature * f1, GstPluginFeature * f2);
 static gboolean extract_field_data (GQuark field_id,
                                     const GValue *value,
                                     gpointer user_data);
@@ -84,6 +89,30 @@ static gboolean extract_field_data (GQuark field_id,
 static GList *list_codec_blueprints[FS_MEDIA_TYPE_LAST+1] = { NULL };
 static gint codecs_lists_ref[FS_MEDIA_TYPE_LAST+1] = { 0 };
 
+/* The lists can be filled from the background discovery thread, so all of
+ * the above and below is protected by this mutex. While a discovery is
+ * running in the background, the list of its media type is not touched by
+ * anyone else. */
+static GStaticMutex codecs_lists_mutex = G_STATIC_MUTEX_INIT;
+static GCond *codecs_lists_cond = NULL;
+static gboolean codecs_lists_discovering[FS_MEDIA_TYPE_LAST+1] = { FALSE };
+static GstClockTime codecs_lists_discovery_time[FS_MEDIA_TYPE_LAST+1] =
+  { 0 };
+static gboolean codecs_lists_from_cache[FS_MEDIA_TYPE_LAST+1] = { FALSE };
+
+/* Elements that are added to the blueprints without being found from their
+ * caps, if one of them changes, everything has to be rediscovered */
+static const gchar *helper_factories[] = {
+  "fsvideoanyrate",
+  "ffmpegcolorspace",
+  "videoscale",
+  "audioconvert",
+  "audioresample",
+  "rtpdtmfsrc",
+  "rtpdtmfdepay",
+  NULL
+};
+
 
 static void
 debug_pipeline (GList *pipeline)
@@ -197,49 +226,355 @@ codec_cap_list_free (GList *list)
   g_list_free (list);
 }
 
+static gboolean
+is_helper_factory (const gchar *name)
+{
+  guint i;
+
+  for (i = 0; helper_factories[i]; i++)
+    if (!strcmp (name, helper_factories[i]))
+      return TRUE;
+
+  return FALSE;
+}
+
 /**
- * fs_rtp_blueprints_get
- * @media_type: a #FsMediaType
+ * codec_blueprints_use_factory
+ * @factory: a #GstElementFactory
  *
- * find all plugins that follow the pattern:
- * input (microphone) -> N* -> rtp payloader -> network
- * network  -> rtp depayloader -> N* -> output (soundcard)
- * media_type defines if we want audio or video codecs
+ * Tells if the discovery looks at this element, the cache records the
+ * version of all of these and only has to be updated when one of them changes
  *
- * Returns: a #GList of #CodecBlueprint or NULL on error
+ * Returns: %TRUE if the blueprints may depend on this factory
  */
-GList *
-fs_rtp_blueprints_get (FsMediaType media_type, GError **error)
+gboolean
+codec_blueprints_use_factory (GstElementFactory *factory)
 {
-  GstCaps *caps;
+  return is_payloader (factory) || is_depayloader (factory) ||
+    is_encoder (factory) || is_decoder (factory) ||
+    is_helper_factory (gst_plugin_feature_get_name (
+            GST_PLUGIN_FEATURE (factory)));
+}
+
+/*
+ * Appends the non-RTP caps of the always pads of @factory in @direction,
+ * those are the caps create_codec_cap_list() looks at
+ */
+static void
+append_factory_media_caps (GstCaps *caps, GstElementFactory *factory,
+    GstPadDirection direction)
+{
+  const GList *pads;
+
+  for (pads = gst_element_factory_get_static_pad_templates (factory);
+       pads;
+       pads = g_list_next (pads))
+  {
+    GstStaticPadTemplate *padtemplate = pads->data;
+    GstCaps *template_caps;
+    guint i;
+
+    if (padtemplate->direction != direction ||
+        padtemplate->presence != GST_PAD_ALWAYS)
+      continue;
+
+    template_caps = gst_static_pad_template_get_caps (padtemplate);
+    if (!template_caps)
+      continue;
+
+    if (!gst_caps_is_any (template_caps))
+    {
+      for (i = 0; i < gst_caps_get_size (template_caps); i++)
+      {
+        GstStructure *structure = gst_caps_get_structure (template_caps, i);
+
+        if (g_ascii_strcasecmp (gst_structure_get_name (structure),
+                "application/x-rtp"))
+          gst_caps_append_structure (caps, gst_structure_copy (structure));
+      }
+    }
+
+    gst_caps_unref (template_caps);
+  }
+}
+
+/* Returns the media caps of all the roles @factory can have in a codec */
+static GstCaps *
+get_factory_media_caps (GstElementFactory *factory)
+{
+  GstCaps *caps = gst_caps_new_empty ();
+
+  if (is_payloader (factory) || is_decoder (factory))
+    append_factory_media_caps (caps, factory, GST_PAD_SINK);
+  if (is_depayloader (factory) || is_encoder (factory))
+    append_factory_media_caps (caps, factory, GST_PAD_SRC);
+
+  return caps;
+}
+
+static gboolean
+factory_media_caps_intersect (GstElementFactory *factory,
+    GstPadDirection direction, GstCaps *caps)
+{
+  GstCaps *media_caps = gst_caps_new_empty ();
+  gboolean ret;
+
+  append_factory_media_caps (media_caps, factory, direction);
+  ret = gst_caps_can_intersect (media_caps, caps);
+  gst_caps_unref (media_caps);
+
+  return ret;
+}
+
+/*
+ * A blueprint is made of all the encoders (or decoders) that match the caps
+ * of one payloader (or depayloader), so the region to rediscover has to
+ * cover the whole caps of the payloaders and depayloaders it touches.
+ */
+static void
+expand_stale_caps (GstCaps *stale_caps)
+{
+  GstCaps *expansion = gst_caps_new_empty ();
+  GList *features, *walk;
+
+  features = gst_registry_get_feature_list (gst_registry_get_default (),
+      GST_TYPE_ELEMENT_FACTORY);
+
+  for (walk = features; walk; walk = g_list_next (walk))
+  {
+    GstElementFactory *factory = GST_ELEMENT_FACTORY (walk->data);
+    GstPadDirection direction;
+
+    if (is_payloader (factory))
+      direction = GST_PAD_SINK;
+    else if (is_depayloader (factory))
+      direction = GST_PAD_SRC;
+    else
+      continue;
+
+    if (factory_media_caps_intersect (factory, direction, stale_caps))
+      append_factory_media_caps (expansion, factory, direction);
+  }
+
+  gst_plugin_feature_list_free (features);
+
+  gst_caps_append (stale_caps, expansion);
+}
+
+/* Same as remove_dynamic_duplicates(), for lists that were merged */
+static GList *
+remove_dynamic_duplicate_blueprints (GList *list)
+{
+  GList *walk1, *walk2;
+
+  for (walk1 = list; walk1; walk1 = g_list_next (walk1))
+  {
+    CodecBlueprint *bp = walk1->data;
+
+    if (bp->codec->id == FS_CODEC_ID_ANY || bp->codec->id >= 96)
+      continue;
+
+    walk2 = list;
+    while (walk2)
+    {
+      CodecBlueprint *cur_bp = walk2->data;
+      GList *next = g_list_next (walk2);
+
+      if (cur_bp->codec->id == FS_CODEC_ID_ANY &&
+          !g_ascii_strcasecmp (bp->codec->encoding_name,
+              cur_bp->codec->encoding_name))
+      {
+        list = g_list_delete_link (list, walk2);
+        codec_blueprint_destroy (cur_bp);
+      }
+
+      walk2 = next;
+    }
+  }
+
+  return list;
+}
+
+/*
+ * A full discovery lists the blueprints in the order of their depayloader
+ * (the first factory of the receive pipeline), sorted like
+ * get_plugins_filtered_from_caps() sorts the factories
+ */
+static gint
+compare_blueprint_discovery_order (CodecBlueprint *bp1, CodecBlueprint *bp2)
+{
+  GList *depay1 = bp1->receive_pipeline_factory ?
+    bp1->receive_pipeline_factory->data : NULL;
+  GList *depay2 = bp2->receive_pipeline_factory ?
+    bp2->receive_pipeline_factory->data : NULL;
+
+  if (!depay1 || !depay2)
+    return (depay1 ? -1 : 0) + (depay2 ? 1 : 0);
+
+  return compare_ranks (depay1->data, depay2->data);
+}
+
+/*
+ * Merges two lists of blueprints that are each in discovery order, so that
+ * the result is in the order a full discovery would have produced, the
+ * blueprints of @list1 come first among the ones that share a depayloader.
+ */
+static GList *
+merge_blueprints_in_discovery_order (GList *list1, GList *list2)
+{
+  GList *merged = NULL;
+
+  while (list1 || list2)
+  {
+    GList **from;
+
+    if (!list2 || (list1 && compare_blueprint_discovery_order (list1->data,
+                list2->data) <= 0))
+      from = &list1;
+    else
+      from = &list2;
+
+    merged = g_list_prepend (merged, (*from)->data);
+    *from = g_list_delete_link (*from, *from);
+  }
+
+  return g_list_reverse (merged);
+}
+
+/*
+ * Rediscovers the codecs that may be affected by @changed_factories and
+ * merges them with the @cached blueprints that are still valid, @stale_caps
+ * are the media caps of the cached blueprints that had to be dropped. The
+ * special sources are always redone since they depend on the other codecs.
+ *
+ * Takes ownership of @cached, returns FALSE if a full discovery is needed.
+ */
+static gboolean
+update_blueprints (FsMediaType media_type, GstCaps *caps, GList *cached,
+    GList *changed_factories, GstCaps *stale_caps)
+{
+  GstCaps *dirty_caps = gst_caps_new_empty ();
   GList *recv_list = NULL;
   GList *send_list = NULL;
-  gboolean ret;
+  GList *found = NULL;
+  GList *kept = NULL;
+  GList *rediscovered = NULL;
+  GList *blueprints = NULL;
+  GList *walk;
 
-  if (media_type > FS_MEDIA_TYPE_LAST)
+  for (walk = changed_factories; walk; walk = g_list_next (walk))
   {
-    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
-      "Invalid media type given");
-    return NULL;
+    GstElementFactory *factory;
+
+    if (is_helper_factory (walk->data))
+    {
+      GST_DEBUG ("Helper element %s changed, rediscovering everything",
+          (gchar *) walk->data);
+      goto full;
+    }
+
+    GST_DEBUG ("Element %s changed", (gchar *) walk->data);
+
+    factory = gst_element_factory_find (walk->data);
+    if (factory)
+    {
+      gst_caps_append (dirty_caps, get_factory_media_caps (factory));
+      gst_object_unref (factory);
+    }
   }
 
-  codecs_lists_ref[media_type]++;
+  if (stale_caps)
+    gst_caps_append (dirty_caps, gst_caps_copy (stale_caps));
 
-  /* if already computed just return list */
-  if (codecs_lists_ref[media_type] > 1)
+  if (!gst_caps_is_empty (dirty_caps))
   {
-    if (!list_codec_blueprints[media_type])
-      g_set_error (error, FS_ERROR, FS_ERROR_NO_CODECS,
-          "No codecs for media type %s detected",
-          fs_media_type_to_string (media_type));
-    return list_codec_blueprints[media_type];
+    expand_stale_caps (dirty_caps);
+
+    recv_list = detect_recv_codecs (caps, dirty_caps);
+    send_list = detect_send_codecs (caps, dirty_caps);
+
+    if (recv_list && send_list &&
+        create_codec_lists (media_type, recv_list, send_list))
+      found = list_codec_blueprints[media_type];
+    list_codec_blueprints[media_type] = NULL;
+
+    if (recv_list)
+      codec_cap_list_free (recv_list);
+    if (send_list)
+      codec_cap_list_free (send_list);
   }
 
-  list_codec_blueprints[media_type] = load_codecs_cache (media_type);
-  if (list_codec_blueprints[media_type]) {
-    GST_DEBUG ("Loaded codec blueprints from cache file");
-    return list_codec_blueprints[media_type];
+  /* Keep the cached blueprints outside of the rediscovered region, the
+   * special ones have no send pipeline */
+  for (walk = cached; walk; walk = g_list_next (walk))
+  {
+    CodecBlueprint *bp = walk->data;
+
+    if (bp->send_pipeline_factory &&
+        !gst_caps_can_intersect (codec_blueprint_get_media_caps (bp),
+            dirty_caps))
+      kept = g_list_prepend (kept, bp);
+    else
+      codec_blueprint_destroy (bp);
+  }
+  g_list_free (cached);
+  kept = g_list_reverse (kept);
+
+  for (walk = found; walk; walk = g_list_next (walk))
+  {
+    CodecBlueprint *bp = walk->data;
+
+    if (gst_caps_can_intersect (codec_blueprint_get_media_caps (bp),
+            dirty_caps))
+      rediscovered = g_list_prepend (rediscovered, bp);
+    else
+      codec_blueprint_destroy (bp);
   }
+  g_list_free (found);
+  rediscovered = g_list_reverse (rediscovered);
+
+  gst_caps_unref (dirty_caps);
+
+  /* The order is the default preference of the codecs, so the rediscovered
+   * ones are put back where they were instead of at the end */
+  blueprints = merge_blueprints_in_discovery_order (kept, rediscovered);
+
+  if (!blueprints)
+    return FALSE;
+
+  blueprints = remove_dynamic_duplicate_blueprints (blueprints);
+
+  list_codec_blueprints[media_type] =
+    fs_rtp_special_sources_add_blueprints (blueprints);
+
+  GST_DEBUG ("Updated %s codec blueprints from the cache",
+      fs_media_type_to_string (media_type));
+
+  return TRUE;
+
+ full:
+  gst_caps_unref (dirty_caps);
+  g_list_foreach (cached, (GFunc) codec_blueprint_destroy, NULL);
+  g_list_free (cached);
+  return FALSE;
+}
+
+/*
+ * Fills list_codec_blueprints[media_type], from the cache if possible.
+ * Returns FALSE if no codecs were found.
+ */
+static gboolean
+discover_blueprints (FsMediaType media_type, gboolean *from_cache,
+    GError **error)
+{
+  GstCaps *caps;
+  GList *recv_list = NULL;
+  GList *send_list = NULL;
+  GList *cached = NULL;
+  GList *changed_factories = NULL;
+  GstCaps *stale_caps = NULL;
+
+  *from_cache = FALSE;
 
   /* caps used to find the payloaders and depayloaders based on media type */
   if (media_type == FS_MEDIA_TYPE_AUDIO)
@@ -256,18 +591,46 @@ fs_rtp_blueprints_get (FsMediaType media_type, GError **error)
   {
     g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
       "Invalid media type given to load_codecs");
-    codecs_lists_ref[media_type]--;
-    return NULL;
+    return FALSE;
   }
 
-  recv_list = detect_recv_codecs (caps);
-  send_list = detect_send_codecs (caps);
+  if (load_codecs_cache (media_type, &cached, &changed_factories,
+          &stale_caps))
+  {
+    gboolean updated;
+
+    if (!changed_factories)
+    {
+      GST_DEBUG ("Loaded codec blueprints from cache file");
+      list_codec_blueprints[media_type] = cached;
+      *from_cache = TRUE;
+      gst_caps_unref (caps);
+      return TRUE;
+    }
+
+    updated = update_blueprints (media_type, caps, cached, changed_factories,
+        stale_caps);
+
+    g_list_foreach (changed_factories, (GFunc) g_free, NULL);
+    g_list_free (changed_factories);
+    if (stale_caps)
+      gst_caps_unref (stale_caps);
+
+    if (updated)
+    {
+      save_codecs_cache (media_type, list_codec_blueprints[media_type]);
+      gst_caps_unref (caps);
+      return TRUE;
+    }
+  }
+
+  recv_list = detect_recv_codecs (caps, NULL);
+  send_list = detect_send_codecs (caps, NULL);
 
   gst_caps_unref (caps);
   /* if we can't send or recv let's just stop here */
   if (!recv_list && !send_list)
   {
-    codecs_lists_ref[media_type]--;
     g_set_error (error, FS_ERROR, FS_ERROR_NO_CODECS,
       "No codecs for media type %s detected",
       fs_media_type_to_string (media_type));
@@ -276,18 +639,172 @@ fs_rtp_blueprints_get (FsMediaType media_type, GError **error)
     goto out;
   }
 
-  ret = create_codec_lists (media_type, recv_list, send_list);
+  if (create_codec_lists (media_type, recv_list, send_list))
+    list_codec_blueprints[media_type] = fs_rtp_special_sources_add_blueprints (
+        list_codec_blueprints[media_type]);
 
   /* Save the codecs blueprint cache */
   save_codecs_cache (media_type, list_codec_blueprints[media_type]);
 
+  /* The installed elements changed, so may have their config */
+  invalidate_codec_config_cache (media_type);
+  save_codec_config_cache (media_type);
+
  out:
   if (recv_list)
     codec_cap_list_free (recv_list);
   if (send_list)
     codec_cap_list_free (send_list);
 
-  return list_codec_blueprints[media_type];
+  return (list_codec_blueprints[media_type] != NULL);
+}
+
+/**
+ * fs_rtp_blueprints_get
+ * @media_type: a #FsMediaType
+ *
+ * find all plugins that follow the pattern:
+ * input (microphone) -> N* -> rtp payloader -> network
+ * network  -> rtp depayloader -> N* -> output (soundcard)
+ * media_type defines if we want audio or video codecs
+ *
+ * If fs_rtp_blueprints_discover_async() was called before and the discovery
+ * is still running, this waits for it to finish.
+ *
+ * Returns: a #GList of #CodecBlueprint or NULL on error
+ */
+GList *
+fs_rtp_blueprints_get (FsMediaType media_type, GError **error)
+{
+  GList *blueprints;
+  GstClockTime start;
+
+  if (media_type > FS_MEDIA_TYPE_LAST)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+      "Invalid media type given");
+    return NULL;
+  }
+
+  g_static_mutex_lock (&codecs_lists_mutex);
+
+  while (codecs_lists_discovering[media_type])
+    g_cond_wait (codecs_lists_cond,
+        g_static_mutex_get_mutex (&codecs_lists_mutex));
+
+  codecs_lists_ref[media_type]++;
+
+  /* if already computed just return list, if a background discovery failed,
+   * it is tried again here */
+  if (list_codec_blueprints[media_type])
+  {
+    blueprints = list_codec_blueprints[media_type];
+    g_static_mutex_unlock (&codecs_lists_mutex);
+    return blueprints;
+  }
+
+  start = gst_util_get_timestamp ();
+  if (!discover_blueprints (media_type, &codecs_lists_from_cache[media_type],
+          error))
+    codecs_lists_ref[media_type]--;
+  codecs_lists_discovery_time[media_type] = gst_util_get_timestamp () - start;
+
+  blueprints = list_codec_blueprints[media_type];
+
+  g_static_mutex_unlock (&codecs_lists_mutex);
+
+  return blueprints;
+}
+
+static gpointer
+discovery_thread (gpointer data)
+{
+  FsMediaType media_type = GPOINTER_TO_INT (data);
+  GstClockTime start = gst_util_get_timestamp ();
+  gboolean from_cache = FALSE;
+  GError *error = NULL;
+  gboolean ret;
+
+  GST_DEBUG ("Discovering %s codecs in the background",
+      fs_media_type_to_string (media_type));
+
+  ret = discover_blueprints (media_type, &from_cache, &error);
+
+  g_static_mutex_lock (&codecs_lists_mutex);
+  /* The next fs_rtp_blueprints_get() will try again */
+  if (!ret)
+    GST_WARNING ("Background discovery of %s codecs failed: %s",
+        fs_media_type_to_string (media_type),
+        error ? error->message : "unknown error");
+  codecs_lists_from_cache[media_type] = from_cache;
+  codecs_lists_discovery_time[media_type] = gst_util_get_timestamp () - start;
+  codecs_lists_discovering[media_type] = FALSE;
+  g_cond_broadcast (codecs_lists_cond);
+  g_static_mutex_unlock (&codecs_lists_mutex);
+
+  g_clear_error (&error);
+
+  return NULL;
+}
+
+/**
+ * fs_rtp_blueprints_discover_async
+ * @media_type: a #FsMediaType
+ *
+ * Starts discovering the codecs of this media type in a separate thread,
+ * unless they are already known or being discovered. In all cases, it takes
+ * a reference to the list that the caller must release with
+ * fs_rtp_blueprints_unref(), so that the list stays around until the
+ * sessions need it.
+ */
+void
+fs_rtp_blueprints_discover_async (FsMediaType media_type)
+{
+  GError *error = NULL;
+
+  g_return_if_fail (media_type <= FS_MEDIA_TYPE_LAST);
+
+  g_static_mutex_lock (&codecs_lists_mutex);
+
+  if (!codecs_lists_cond)
+    codecs_lists_cond = g_cond_new ();
+
+  if (codecs_lists_ref[media_type]++ || codecs_lists_discovering[media_type])
+    goto out;
+
+  codecs_lists_discovering[media_type] = TRUE;
+
+  if (!g_thread_create (discovery_thread, GINT_TO_POINTER (media_type), FALSE,
+          &error))
+  {
+    GST_WARNING ("Could not start the codec discovery thread: %s",
+        error ? error->message : "unknown error");
+    g_clear_error (&error);
+    codecs_lists_discovering[media_type] = FALSE;
+  }
+
+ out:
+  g_static_mutex_unlock (&codecs_lists_mutex);
+}
+
+/**
+ * fs_rtp_blueprints_get_discovery_info
+ * @media_type: a #FsMediaType
+ * @discovery_time: location for the time the last discovery took
+ * @from_cache: location for whether the last discovery used the cache
+ *
+ * Gets how the current list of blueprints was found
+ */
+void
+fs_rtp_blueprints_get_discovery_info (FsMediaType media_type,
+    GstClockTime *discovery_time, gboolean *from_cache)
+{
+  g_return_if_fail (media_type <= FS_MEDIA_TYPE_LAST);
+
+  g_static_mutex_lock (&codecs_lists_mutex);
+  *discovery_time = codecs_lists_discovery_time[media_type];
+  *from_cache = codecs_lists_from_cache[media_type];
+  g_static_mutex_unlock (&codecs_lists_mutex);
 }
 
 static gboolean
@@ -320,9 +837,6 @@ create_codec_lists (FsMediaType media_type,
 
   codec_cap_list_free (duplex_list);
 
-  list_codec_blueprints[media_type] =
-    fs_rtp_special_sources_add_blueprints (list_codec_blueprints[media_type]);
-
   return TRUE;
 }
 
@@ -723,7 +1237,7 @@ is_decoder (GstElementFactory *factory)
 
 /* find all encoder/payloader combos and build list for them */
 static GList *
-detect_send_codecs (GstCaps *caps)
+detect_send_codecs (GstCaps *caps, GstCaps *restrict_caps)
 {
   GList *payloaders, *encoders;
   GList *send_list = NULL;
@@ -731,7 +1245,8 @@ detect_send_codecs (GstCaps *caps)
   /* find all payloader caps. All payloaders should be from klass
    * Codec/Payloader/Network and have as output a data of the mimetype
    * application/x-rtp */
-  payloaders = get_plugins_filtered_from_caps (is_payloader, caps, GST_PAD_SINK);
+  payloaders = get_plugins_filtered_from_caps (is_payloader, caps, GST_PAD_SINK,
+      restrict_caps);
 
   /* no payloader found. giving up */
   if (!payloaders)
@@ -745,7 +1260,8 @@ detect_send_codecs (GstCaps *caps)
   }
 
   /* find all encoders based on is_encoder filter */
-  encoders = get_plugins_filtered_from_caps (is_encoder, NULL, GST_PAD_SRC);
+  encoders = get_plugins_filtered_from_caps (is_encoder, NULL, GST_PAD_SRC,
+      restrict_caps);
   if (!encoders)
   {
     codec_cap_list_free (payloaders);
@@ -778,7 +1294,7 @@ detect_send_codecs (GstCaps *caps)
 
 /* find all decoder/depayloader combos and build list for them */
 static GList *
-detect_recv_codecs (GstCaps *caps)
+detect_recv_codecs (GstCaps *caps, GstCaps *restrict_caps)
 {
   GList *depayloaders, *decoders;
   GList *recv_list = NULL;
@@ -787,7 +1303,7 @@ detect_recv_codecs (GstCaps *caps)
    * Codec/Depayr/Network and have as input a data of the mimetype
    * application/x-rtp */
   depayloaders = get_plugins_filtered_from_caps (is_depayloader, caps,
-      GST_PAD_SRC);
+      GST_PAD_SRC, restrict_caps);
 
   /* no depayloader found. giving up */
   if (!depayloaders)
@@ -801,7 +1317,8 @@ detect_recv_codecs (GstCaps *caps)
   }
 
   /* find all decoders based on is_decoder filter */
-  decoders = get_plugins_filtered_from_caps (is_decoder, NULL, GST_PAD_SINK);
+  decoders = get_plugins_filtered_from_caps (is_decoder, NULL, GST_PAD_SINK,
+      restrict_caps);
 
   if (!decoders)
   {
@@ -833,29 +1350,161 @@ detect_recv_codecs (GstCaps *caps)
   return recv_list;
 }
 
+/*
+ * Two caps can only intersect if they have structures with the same name,
+ * so the second list of an intersection is indexed by the names of the
+ * structures of its media caps and only the entries that share one with
+ * the entry of the first list are really intersected.
+ */
+typedef struct {
+  CodecCap **items;
+  guint n_items;
+  GHashTable *buckets;  /* name quark -> GArray of indexes in items */
+  GArray *wildcards;    /* indexes of the items with ANY caps */
+} CodecCapIndex;
+
+static void
+free_bucket (GArray *bucket)
+{
+  g_array_free (bucket, TRUE);
+}
+
+static void
+codec_cap_index_init (CodecCapIndex *index, GList *list)
+{
+  GList *walk;
+  guint i;
+
+  index->n_items = g_list_length (list);
+  index->items = g_new (CodecCap *, index->n_items);
+  index->buckets = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) free_bucket);
+  index->wildcards = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (walk = list, i = 0; walk; walk = g_list_next (walk), i++)
+  {
+    CodecCap *codec_cap = walk->data;
+    guint j;
+
+    index->items[i] = codec_cap;
+
+    if (gst_caps_is_any (codec_cap->caps))
+    {
+      g_array_append_val (index->wildcards, i);
+      continue;
+    }
+
+    for (j = 0; j < gst_caps_get_size (codec_cap->caps); j++)
+    {
+      GstStructure *structure = gst_caps_get_structure (codec_cap->caps, j);
+      gpointer name = GUINT_TO_POINTER (gst_structure_get_name_id (structure));
+      GArray *bucket = g_hash_table_lookup (index->buckets, name);
+
+      if (!bucket)
+      {
+        bucket = g_array_new (FALSE, FALSE, sizeof (guint));
+        g_hash_table_insert (index->buckets, name, bucket);
+      }
+
+      /* Items with several structures of the same name only go in once */
+      if (bucket->len == 0 ||
+          g_array_index (bucket, guint, bucket->len - 1) != i)
+        g_array_append_val (bucket, i);
+    }
+  }
+}
+
+static void
+codec_cap_index_clear (CodecCapIndex *index)
+{
+  g_free (index->items);
+  g_hash_table_destroy (index->buckets);
+  g_array_free (index->wildcards, TRUE);
+}
+
+static gint
+compare_indexes (gconstpointer a, gconstpointer b)
+{
+  guint index_a = *(const guint *) a;
+  guint index_b = *(const guint *) b;
+
+  return (index_a > index_b) - (index_a < index_b);
+}
+
+/*
+ * Returns the indexes of the items that may intersect with @caps, in the
+ * order of the list so that the intersection gives the same result as
+ * trying all of them
+ */
+static GArray *
+codec_cap_index_lookup (CodecCapIndex *index, GstCaps *caps)
+{
+  GArray *matches = g_array_new (FALSE, FALSE, sizeof (guint));
+  guint i, j;
+
+  if (gst_caps_is_any (caps))
+  {
+    for (i = 0; i < index->n_items; i++)
+      g_array_append_val (matches, i);
+    return matches;
+  }
+
+  for (i = 0; i < gst_caps_get_size (caps); i++)
+  {
+    GstStructure *structure = gst_caps_get_structure (caps, i);
+    GArray *bucket = g_hash_table_lookup (index->buckets,
+        GUINT_TO_POINTER (gst_structure_get_name_id (structure)));
+
+    if (bucket)
+      g_array_append_vals (matches, bucket->data, bucket->len);
+  }
+
+  g_array_append_vals (matches, index->wildcards->data, index->wildcards->len);
+
+  if (matches->len < 2)
+    return matches;
+
+  g_array_sort (matches, compare_indexes);
+
+  /* Remove the duplicates */
+  for (i = 1, j = 1; i < matches->len; i++)
+    if (g_array_index (matches, guint, i) !=
+        g_array_index (matches, guint, j - 1))
+      g_array_index (matches, guint, j++) = g_array_index (matches, guint, i);
+  g_array_set_size (matches, j);
+
+  return matches;
+}
+
 /* returns the intersection of two lists */
 static GList *
 codec_cap_list_intersect (GList *list1, GList *list2)
 {
-  GList *walk1, *walk2;
+  GList *walk1;
   CodecCap *codec_cap1, *codec_cap2;
   GstCaps *caps1, *caps2;
   GstCaps *rtp_caps1, *rtp_caps2;
   GList *intersection_list = NULL;
+  CodecCapIndex index;
+
+  codec_cap_index_init (&index, list2);
 
   for (walk1 = g_list_first (list1); walk1; walk1 = g_list_next (walk1))
   {
     CodecCap *item = NULL;
+    GArray *matches;
+    guint i;
 
     codec_cap1 = (CodecCap *)(walk1->data);
     caps1 = codec_cap1->caps;
     rtp_caps1 = codec_cap1->rtp_caps;
-    for (walk2 = list2; walk2; walk2 = g_list_next (walk2))
+    matches = codec_cap_index_lookup (&index, caps1);
+    for (i = 0; i < matches->len; i++)
     {
       GstCaps *intersection = NULL;
       GstCaps *rtp_intersection = NULL;
 
-      codec_cap2 = (CodecCap *)(walk2->data);
+      codec_cap2 = index.items[g_array_index (matches, guint, i)];
       caps2 = codec_cap2->caps;
       rtp_caps2 = codec_cap2->rtp_caps;
 
@@ -930,8 +1579,11 @@ codec_cap_list_intersect (GList *list1, GList *list2)
       }
       gst_caps_unref (intersection);
     }
+    g_array_free (matches, TRUE);
   }
 
+  codec_cap_index_clear (&index);
+
   return intersection_list;
 }
 
@@ -956,6 +1608,9 @@ codec_blueprint_destroy (CodecBlueprint *codec_blueprint)
     gst_caps_unref (codec_blueprint->rtp_caps);
   }
 
+  g_free (codec_blueprint->media_caps_str);
+  g_free (codec_blueprint->rtp_caps_str);
+
   for (walk = codec_blueprint->send_pipeline_factory;
       walk; walk = g_list_next (walk))
   {
@@ -981,9 +1636,67 @@ codec_blueprint_destroy (CodecBlueprint *codec_blueprint)
   g_slice_free (CodecBlueprint, codec_blueprint);
 }
 
+static GstCaps *
+get_lazy_caps (GstCaps **caps, const gchar *caps_str)
+{
+  GstCaps *newcaps;
+
+  if (g_atomic_pointer_get (caps) || !caps_str)
+    return g_atomic_pointer_get (caps);
+
+  /* Blueprints are shared between sessions, so two threads may race here */
+  newcaps = gst_caps_from_string (caps_str);
+  if (!newcaps)
+  {
+    GST_WARNING ("Could not parse caps %s from the cache", caps_str);
+    return NULL;
+  }
+
+  if (!g_atomic_pointer_compare_and_exchange ((volatile gpointer *) caps,
+          NULL, newcaps))
+    gst_caps_unref (newcaps);
+
+  return g_atomic_pointer_get (caps);
+}
+
+/**
+ * codec_blueprint_get_media_caps:
+ * @blueprint: a #CodecBlueprint
+ *
+ * Returns: the media caps of the blueprint, they are only parsed the first
+ * time they are needed if it was loaded from the cache, the caller doesn't
+ * own them
+ */
+GstCaps *
+codec_blueprint_get_media_caps (CodecBlueprint *blueprint)
+{
+  return get_lazy_caps (&blueprint->media_caps, blueprint->media_caps_str);
+}
+
+/**
+ * codec_blueprint_get_rtp_caps:
+ * @blueprint: a #CodecBlueprint
+ *
+ * Returns: the RTP caps of the blueprint, they are only parsed the first
+ * time they are needed if it was loaded from the cache, the caller doesn't
+ * own them
+ */
+GstCaps *
+codec_blueprint_get_rtp_caps (CodecBlueprint *blueprint)
+{
+  return get_lazy_caps (&blueprint->rtp_caps, blueprint->rtp_caps_str);
+}
+
 void
 fs_rtp_blueprints_unref (FsMediaType media_type)
 {
+  g_static_mutex_lock (&codecs_lists_mutex);
+
+  /* The list belongs to the background discovery until it is done */
+  while (codecs_lists_discovering[media_type])
+    g_cond_wait (codecs_lists_cond,
+        g_static_mutex_get_mutex (&codecs_lists_mutex));
+
   codecs_lists_ref[media_type]--;
   if (!codecs_lists_ref[media_type])
   {
@@ -999,6 +1712,7 @@ fs_rtp_blueprints_unref (FsMediaType media_type)
       list_codec_blueprints[media_type] = NULL;
     }
   }
+  g_static_mutex_unlock (&codecs_lists_mutex);
 }
 
 
@@ -1233,11 +1947,14 @@ compare_ranks (GstPluginFeature * f1, GstPluginFeature * f2)
 }
 
 
-/* creates/returns a list of CodecCap based on given filter function and caps */
+/* creates/returns a list of CodecCap based on given filter function and caps,
+ * if restrict_caps is set, only the elements whose media caps intersect it
+ * are looked at */
 static GList *
 get_plugins_filtered_from_caps (FilterFunc filter,
                                 GstCaps *caps,
-                                GstPadDirection direction)
+                                GstPadDirection direction,
+                                GstCaps *restrict_caps)
 {
   GList *walk, *result;
   GList *list = NULL;
@@ -1254,7 +1971,11 @@ get_plugins_filtered_from_caps (FilterFunc filter,
 
     if (!filter (factory))
       continue;
-    
+
+    if (restrict_caps &&
+        !factory_media_caps_intersect (factory, direction, restrict_caps))
+      continue;
+
     if (caps && !check_caps_compatibility (factory, caps, &matched_caps))
       continue;
 
@@ -41,8 +41,13 @@ G_BEGIN_DECLS
 typedef struct _CodecBlueprint
 {
   FsCodec *codec;
+  /* Use codec_blueprint_get_media_caps() and codec_blueprint_get_rtp_caps()
+   * to read these, blueprints loaded from the cache only have the strings
+   * until the caps are needed */
   GstCaps *media_caps;
   GstCaps *rtp_caps;
+  gchar *media_caps_str;
+  gchar *rtp_caps_str;
   /*
    * These are #GList of #GList of #GstElementFactory
    */
@@ -53,9 +58,16 @@ typedef struct _CodecBlueprint
 GList *fs_rtp_blueprints_get (FsMediaType media_type, GError **error);
 void fs_rtp_blueprints_unref (FsMediaType media_type);
 
+void fs_rtp_blueprints_discover_async (FsMediaType media_type);
+void fs_rtp_blueprints_get_discovery_info (FsMediaType media_type,
+    GstClockTime *discovery_time, gboolean *from_cache);
+
 gboolean codec_blueprint_has_factory (CodecBlueprint *blueprint,
     gboolean is_send);
 
+GstCaps *codec_blueprint_get_media_caps (CodecBlueprint *blueprint);
+GstCaps *codec_blueprint_get_rtp_caps (CodecBlueprint *blueprint);
+
 GstElement * create_codec_bin_from_blueprint (const FsCodec *codec,
     CodecBlueprint *blueprint, const gchar *name, gboolean is_send,
     GError **error);
@@ -66,6 +78,7 @@ GstElement * create_codec_bin_from_blueprint (const FsCodec *codec,
  */
 
 void codec_blueprint_destroy (CodecBlueprint *codec_blueprint);
+gboolean codec_blueprints_use_factory (GstElementFactory *factory);
 
 G_END_DECLS
 
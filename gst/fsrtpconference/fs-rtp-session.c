@@ -50,6 +50,72 @@
  * Also, it is possible to declare profiles with only a decoding pipeline,
  * you will only be able to receive from this codec, the encoding may be a
  * secondary pad of some other codec.
+ * </para></refsect2>
+ * <refsect2><title>Send codec bin pool</title>
+ * <para>
+ * If the "send-codec-bin-pool-size" property is set, the encoding bins of the
+ * most preferred negotiated codecs are built in advance and kept in the READY
+ * state, so changing the send codec only needs to relink them. The pool is
+ * refilled from a separate thread every time the codecs are renegotiated.
+ * </para></refsect2>
+ * <refsect2><title>The "<literal>farsight-send-codec-switch-latency</literal>"
+ *   message</title>
+ * |[
+ * "session"          #FsSession          The session that emits the message
+ * "codec"            #FsCodec            The new send codec
+ * "latency"          #guint64            The time in nanoseconds during which
+ *                                        the media was blocked
+ * "from-pool"        #gboolean           %TRUE if the codec bin was ready
+ *                                        in the pool
+ * ]|
+ * <para>
+ * This message is sent on the bus every time the send codec bin is replaced.
+ * </para></refsect2>
+ * <refsect2><title>The "<literal>farsight-codec-discovery</literal>"
+ *   message</title>
+ * |[
+ * "session"          #FsSession          The session that emits the message
+ * "media-type"       #FsMediaType        The media type of the session
+ * "discovery-time"   #guint64            The time in nanoseconds it took to
+ *                                        find the available codecs
+ * "wait-time"        #guint64            The time in nanoseconds the creation
+ *                                        of the session waited for it
+ * "from-cache"       #gboolean           %TRUE if the codecs were loaded from
+ *                                        the cache
+ * ]|
+ * <para>
+ * The codecs are discovered in the background as soon as the first
+ * #FsRtpConference is created, this message is sent when a session is created
+ * to tell how long the discovery took and how much of it was waited for.
+ * </para></refsect2>
+ * <refsect2><title>Codec config cache</title>
+ * <para>
+ * The config discovered by running an encoder is saved in the user's cache
+ * directory (or in the files pointed to by the FS_AUDIO_CODECS_CONFIG_CACHE
+ * and FS_VIDEO_CODECS_CONFIG_CACHE environment variables). Later sessions
+ * using the same elements with the same caps take it from there and are
+ * ready without running the encoder. An entry is dropped when the version of
+ * one of its elements changes.
+ * </para></refsect2>
+ * <refsect2><title>Parallel codec discovery</title>
+ * <para>
+ * Some codecs can only be advertised once some of their parameters have been
+ * discovered by running their encoder. By default, the encoders are tried one
+ * after the other. If the "parallel-codec-discovery" property is set, one
+ * encoder per codec that needs it is run at the same time, each in its own
+ * thread.
+ * </para></refsect2>
+ * <refsect2><title>The "<literal>farsight-codec-config-discovered</literal>"
+ *   message</title>
+ * |[
+ * "session"          #FsSession          The session that emits the message
+ * "codec"            #FsCodec            The codec with its newly discovered
+ *                                        parameters
+ * ]|
+ * <para>
+ * This message is sent on the bus every time the configuration of one codec
+ * has been discovered, the "farsight-codecs-changed" message is still sent
+ * once all of them have been.
  * </para></refsect2><para>
  */
 
@@ -74,6 +140,8 @@
 #include "fs-rtp-substream.h"
 #include "fs-rtp-special-source.h"
 #include "fs-rtp-codec-specific.h"
+#include "fs-rtp-codec-cache.h"
+#include "fs-rtp-ssrc-index.h"
 
 #define GST_CAT_DEFAULT fsrtpconference_debug
 
@@ -98,10 +166,18 @@ enum
   PROP_CONFERENCE,
   PROP_NO_RTCP_TIMEOUT,
   PROP_SSRC,
-  PROP_TOS
+  PROP_TOS,
+  PROP_SEND_CODEC_BIN_POOL_SIZE,
+  PROP_RECV_CODEC_BIN_CACHE_SIZE,
+  PROP_RECV_CODEC_BIN_CACHE_HITS,
+  PROP_RECV_CODEC_BIN_CACHE_MISSES,
+  PROP_PARALLEL_CODEC_DISCOVERY
 };
 
 #define DEFAULT_NO_RTCP_TIMEOUT (7000)
+#define DEFAULT_SEND_CODEC_BIN_POOL_SIZE (0)
+#define DEFAULT_RECV_CODEC_BIN_CACHE_SIZE (0)
+#define DEFAULT_PARALLEL_CODEC_DISCOVERY (FALSE)
 
 struct _FsRtpSessionPrivate
 {
@@ -151,6 +227,14 @@ struct _FsRtpSessionPrivate
   /* This one is protected by the session lock */
   FsCodec *discovery_codec;
 
+  /* In parallel discovery, the elements above are replaced by a tee with
+   * one DiscoveryBranch per codec, the tee follows the same rules as the
+   * other discovery elements, the list is protected by the session lock */
+  GstElement *discovery_tee;
+  GList *discovery_branches;
+  /* Protected by the session lock */
+  gboolean parallel_discovery;
+
   /* Request pad to release on dispose */
   GstPad *rtpbin_send_rtp_sink;
   GstPad *rtpbin_send_rtcp_src;
@@ -167,6 +251,22 @@ struct _FsRtpSessionPrivate
   GstElement *send_codecbin;
   GList *extra_send_capsfilters;
 
+  /* Idle send codec bins in the READY state, most recently used first.
+   * Protected by the session mutex, bins are only added to the conference
+   * for it while holding the send_pad_blocked_mutex */
+  GList *send_codecbin_pool;
+  guint send_codecbin_pool_size;
+  /* Fills the pool from the timer wheel, protected by the session mutex */
+  FsRtpTimer *send_codecbin_pool_timer;
+
+  /* Idle receive codec bins released by stopped substreams, they are out
+   * of the conference, in the READY state and we own a ref to them.
+   * Most recently used first, protected by the session mutex */
+  GList *recv_codecbin_cache;
+  guint recv_codecbin_cache_size;
+  guint recv_codecbin_cache_hits;
+  guint recv_codecbin_cache_misses;
+
   /* These lists are protected by the session mutex */
   GList *streams;
   guint streams_cookie;
@@ -181,6 +281,20 @@ struct _FsRtpSessionPrivate
 
   /* These are protected by the session mutex */
   GList *codec_associations;
+  /* 0 if not computed yet or if the codecs were modified in place */
+  guint64 codec_associations_fingerprint;
+
+  /* Cache of the incremental negotiation, see
+   * fs_rtp_session_negotiate_codecs_locked(), protected by the session mutex */
+  GList *negotiation_base;
+  GList *negotiation_steps;
+  gboolean negotiation_multi_stream;
+
+  /* Index of the codec associations, replaced with the session mutex held
+   * but also read without it by request-pt-map, see
+   * fs_rtp_session_update_codec_association_table_locked() */
+  volatile gpointer codec_association_table;
+  volatile gint codec_association_table_readers;
 
   /* Protected by the session mutex */
   gint no_rtcp_timeout;
@@ -192,6 +306,10 @@ struct _FsRtpSessionPrivate
   GHashTable *ssrc_streams;
   GHashTable *ssrc_streams_manual;
 
+  /* This mirrors the keys of ssrc_streams, it is modified with the session
+   * mutex held, but can be read from the streaming threads without it */
+  FsRtpSsrcIndex *ssrc_index;
+
   GError *construction_error;
 
   GMutex *send_pad_blocked_mutex;
@@ -270,6 +388,9 @@ static FsStreamTransmitter *fs_rtp_session_get_new_stream_transmitter (
 static void _remove_stream (gpointer user_data,
     GObject *where_the_object_was);
 
+static void fs_rtp_session_clear_negotiation_steps (FsRtpSession *self,
+    GList *from);
+
 static gboolean
 fs_rtp_session_update_codecs (FsRtpSession *session,
     FsRtpStream *stream,
@@ -292,6 +413,9 @@ static void
 fs_rtp_session_associate_free_substreams (FsRtpSession *session,
     FsRtpStream *stream, guint32 ssrc);
 
+static void
+fs_rtp_session_schedule_send_codec_bin_pool_fill_locked (FsRtpSession *self);
+
 static void
 _send_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session);
 static void
@@ -371,6 +495,54 @@ fs_rtp_session_class_init (FsRtpSessionClass *klass)
           " (defaults to a random value)",
           0, G_MAXUINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class,
+      PROP_SEND_CODEC_BIN_POOL_SIZE,
+      g_param_spec_uint ("send-codec-bin-pool-size",
+          "The number of idle send codec bins to keep ready",
+          "This is the number of send codec bins for the most preferred"
+          " negotiated codecs that are kept in the READY state so that"
+          " changing the send codec only requires relinking them."
+          " 0 disables the pool",
+          0, G_MAXUINT, DEFAULT_SEND_CODEC_BIN_POOL_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_RECV_CODEC_BIN_CACHE_SIZE,
+      g_param_spec_uint ("recv-codec-bin-cache-size",
+          "The number of idle receive codec bins to keep",
+          "This is the maximum number of receive codec bins released by"
+          " stopped substreams that are kept to be reused by new substreams"
+          " with the same codec, the least recently used are destroyed first."
+          " 0 (the default) disables the cache",
+          0, G_MAXUINT, DEFAULT_RECV_CODEC_BIN_CACHE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_RECV_CODEC_BIN_CACHE_HITS,
+      g_param_spec_uint ("recv-codec-bin-cache-hits",
+          "Number of reused receive codec bins",
+          "This is the number of times a receive codec bin was taken from"
+          " the cache instead of being built",
+          0, G_MAXUINT, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_RECV_CODEC_BIN_CACHE_MISSES,
+      g_param_spec_uint ("recv-codec-bin-cache-misses",
+          "Number of built receive codec bins",
+          "This is the number of times a receive codec bin had to be built"
+          " because there was none for its codec in the cache",
+          0, G_MAXUINT, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_PARALLEL_CODEC_DISCOVERY,
+      g_param_spec_boolean ("parallel-codec-discovery",
+          "Discover the config of all codecs at the same time",
+          "If TRUE, the encoders of all the codecs whose configuration must"
+          " be discovered are run at the same time instead of one after the"
+          " other. It takes effect the next time discovery is started",
+          DEFAULT_PARALLEL_CODEC_DISCOVERY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gobject_class->dispose = fs_rtp_session_dispose;
   gobject_class->finalize = fs_rtp_session_finalize;
 
@@ -397,10 +569,12 @@ fs_rtp_session_init (FsRtpSession *self)
   self->priv->media_type = FS_MEDIA_TYPE_LAST + 1;
 
   self->priv->no_rtcp_timeout = DEFAULT_NO_RTCP_TIMEOUT;
+  self->priv->recv_codecbin_cache_size = DEFAULT_RECV_CODEC_BIN_CACHE_SIZE;
 
   self->priv->ssrc_streams = g_hash_table_new (g_direct_hash, g_direct_equal);
   self->priv->ssrc_streams_manual = g_hash_table_new (g_direct_hash,
       g_direct_equal);
+  self->priv->ssrc_index = fs_rtp_ssrc_index_new ();
 }
 
 static gboolean
@@ -472,6 +646,43 @@ stop_and_remove (GstBin *conf, GstElement **element, gboolean unref)
   *element = NULL;
 }
 
+#define RECV_CODEC_DATA "fs-recv-codec"
+
+static void
+_destroy_cached_recv_codec_bins (GList *codecbins)
+{
+  while (codecbins)
+  {
+    GstElement *codecbin = codecbins->data;
+
+    gst_element_set_state (codecbin, GST_STATE_NULL);
+    gst_object_unref (codecbin);
+    codecbins = g_list_delete_link (codecbins, codecbins);
+  }
+}
+
+/*
+ * Removes the least recently used bins that do not fit in the cache anymore,
+ * the caller must destroy them after releasing the lock
+ */
+
+static GList *
+fs_rtp_session_trim_recv_codec_bin_cache_locked (FsRtpSession *self)
+{
+  GList *excess = NULL;
+
+  while (g_list_length (self->priv->recv_codecbin_cache) >
+      self->priv->recv_codecbin_cache_size)
+  {
+    GList *last = g_list_last (self->priv->recv_codecbin_cache);
+
+    excess = g_list_prepend (excess, last->data);
+    self->priv->recv_codecbin_cache = g_list_delete_link (
+        self->priv->recv_codecbin_cache, last);
+  }
+
+  return excess;
+}
 
 static gpointer
 trigger_dispose (gpointer data)
@@ -485,6 +696,7 @@ fs_rtp_session_real_dispose (FsRtpSession *self)
 {
   GList *item = NULL;
   GstBin *conferencebin = NULL;
+  FsRtpTimer *timer;
 
   conferencebin = GST_BIN (self->priv->conference);
 
@@ -572,6 +784,25 @@ fs_rtp_session_real_dispose (FsRtpSession *self)
   }
 
   stop_and_remove (conferencebin, &self->priv->send_codecbin, FALSE);
+
+  FS_RTP_SESSION_LOCK (self);
+  timer = self->priv->send_codecbin_pool_timer;
+  self->priv->send_codecbin_pool_timer = NULL;
+  FS_RTP_SESSION_UNLOCK (self);
+
+  /* This waits for the pool to be filled if it is being filled */
+  if (timer)
+    fs_rtp_timer_wheel_remove (
+        fs_rtp_conference_get_timer_wheel (self->priv->conference), timer);
+
+  while (self->priv->send_codecbin_pool)
+  {
+    GstElement *codecbin = self->priv->send_codecbin_pool->data;
+
+    stop_and_remove (conferencebin, &codecbin, FALSE);
+    self->priv->send_codecbin_pool = g_list_delete_link (
+        self->priv->send_codecbin_pool, self->priv->send_codecbin_pool);
+  }
   stop_and_remove (conferencebin, &self->priv->send_tee, TRUE);
   stop_and_remove (conferencebin, &self->priv->media_sink_valve, TRUE);
 
@@ -580,6 +811,13 @@ fs_rtp_session_real_dispose (FsRtpSession *self)
 
 
   /* Now the recv pipeline */
+  FS_RTP_SESSION_LOCK (self);
+  self->priv->recv_codecbin_cache_size = 0;
+  item = self->priv->recv_codecbin_cache;
+  self->priv->recv_codecbin_cache = NULL;
+  FS_RTP_SESSION_UNLOCK (self);
+  _destroy_cached_recv_codec_bins (item);
+
   if (self->priv->free_substreams)
     g_list_foreach (self->priv->free_substreams, (GFunc) fs_rtp_sub_stream_stop,
       NULL);
@@ -683,6 +921,7 @@ fs_rtp_session_real_dispose (FsRtpSession *self)
   self->priv->streams_cookie++;
   g_hash_table_remove_all (self->priv->ssrc_streams);
   g_hash_table_remove_all (self->priv->ssrc_streams_manual);
+  fs_rtp_ssrc_index_clear (self->priv->ssrc_index);
 
   G_OBJECT_CLASS (fs_rtp_session_parent_class)->dispose (G_OBJECT (self));
 }
@@ -731,7 +970,10 @@ fs_rtp_session_finalize (GObject *object)
   }
 
   fs_codec_list_destroy (self->priv->codec_preferences);
+  codec_association_table_free (self->priv->codec_association_table);
   codec_association_list_destroy (self->priv->codec_associations);
+  fs_rtp_session_clear_negotiation_steps (self, NULL);
+  codec_association_list_destroy (self->priv->negotiation_base);
 
   if (self->priv->current_send_codec)
     fs_codec_destroy (self->priv->current_send_codec);
@@ -745,6 +987,9 @@ fs_rtp_session_finalize (GObject *object)
   if (self->priv->ssrc_streams_manual)
     g_hash_table_destroy (self->priv->ssrc_streams_manual);
 
+  if (self->priv->ssrc_index)
+    fs_rtp_ssrc_index_free (self->priv->ssrc_index);
+
   g_mutex_free (self->priv->send_pad_blocked_mutex);
   g_mutex_free (self->priv->discovery_pad_blocked_mutex);
 
@@ -864,6 +1109,31 @@ fs_rtp_session_get_property (GObject *object,
       g_value_set_uint (value, self->priv->tos);
       FS_RTP_SESSION_UNLOCK (self);
       break;
+    case PROP_SEND_CODEC_BIN_POOL_SIZE:
+      FS_RTP_SESSION_LOCK (self);
+      g_value_set_uint (value, self->priv->send_codecbin_pool_size);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
+    case PROP_RECV_CODEC_BIN_CACHE_SIZE:
+      FS_RTP_SESSION_LOCK (self);
+      g_value_set_uint (value, self->priv->recv_codecbin_cache_size);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
+    case PROP_RECV_CODEC_BIN_CACHE_HITS:
+      FS_RTP_SESSION_LOCK (self);
+      g_value_set_uint (value, self->priv->recv_codecbin_cache_hits);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
+    case PROP_RECV_CODEC_BIN_CACHE_MISSES:
+      FS_RTP_SESSION_LOCK (self);
+      g_value_set_uint (value, self->priv->recv_codecbin_cache_misses);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
+    case PROP_PARALLEL_CODEC_DISCOVERY:
+      FS_RTP_SESSION_LOCK (self);
+      g_value_set_boolean (value, self->priv->parallel_discovery);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -919,6 +1189,28 @@ fs_rtp_session_set_property (GObject *object,
           GUINT_TO_POINTER (self->priv->tos));
       FS_RTP_SESSION_UNLOCK (self);
       break;
+    case PROP_SEND_CODEC_BIN_POOL_SIZE:
+      FS_RTP_SESSION_LOCK (self);
+      self->priv->send_codecbin_pool_size = g_value_get_uint (value);
+      fs_rtp_session_schedule_send_codec_bin_pool_fill_locked (self);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
+    case PROP_RECV_CODEC_BIN_CACHE_SIZE:
+      {
+        GList *excess;
+
+        FS_RTP_SESSION_LOCK (self);
+        self->priv->recv_codecbin_cache_size = g_value_get_uint (value);
+        excess = fs_rtp_session_trim_recv_codec_bin_cache_locked (self);
+        FS_RTP_SESSION_UNLOCK (self);
+        _destroy_cached_recv_codec_bins (excess);
+      }
+      break;
+    case PROP_PARALLEL_CODEC_DISCOVERY:
+      FS_RTP_SESSION_LOCK (self);
+      self->priv->parallel_discovery = g_value_get_boolean (value);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -951,6 +1243,8 @@ fs_rtp_session_constructed (GObject *object)
   GstPad *pad;
   GstPadLinkReturn ret;
   gchar *tmp;
+  GstClockTime start, wait_time, discovery_time;
+  gboolean from_cache;
 
   if (self->id == 0)
   {
@@ -959,8 +1253,10 @@ fs_rtp_session_constructed (GObject *object)
     return;
   }
 
+  start = gst_util_get_timestamp ();
   self->priv->blueprints = fs_rtp_blueprints_get (self->priv->media_type,
     &self->priv->construction_error);
+  wait_time = gst_util_get_timestamp () - start;
 
   if (!self->priv->blueprints)
   {
@@ -971,6 +1267,18 @@ fs_rtp_session_constructed (GObject *object)
     return;
   }
 
+  fs_rtp_blueprints_get_discovery_info (self->priv->media_type,
+      &discovery_time, &from_cache);
+  gst_element_post_message (GST_ELEMENT (self->priv->conference),
+      gst_message_new_element (GST_OBJECT (self->priv->conference),
+          gst_structure_new ("farsight-codec-discovery",
+              "session", FS_TYPE_SESSION, self,
+              "media-type", FS_TYPE_MEDIA_TYPE, self->priv->media_type,
+              "discovery-time", G_TYPE_UINT64, discovery_time,
+              "wait-time", G_TYPE_UINT64, wait_time,
+              "from-cache", G_TYPE_BOOLEAN, from_cache,
+              NULL)));
+
   /* Create an initial list of local codec associations */
   self->priv->codec_associations = create_local_codec_associations (
       self->priv->blueprints, NULL, NULL);
@@ -983,6 +1291,9 @@ fs_rtp_session_constructed (GObject *object)
     return;
   }
 
+  self->priv->codec_association_table = codec_association_table_new (
+      self->priv->codec_associations);
+
   tmp = g_strdup_printf ("send_tee_%u", self->id);
   tee = gst_element_factory_make ("tee", tmp);
   g_free (tmp);
@@ -1462,6 +1773,13 @@ _stream_known_source_packet_received (FsRtpStream *stream, guint component,
 
  ok:
 
+  /* This is the common case, don't take the session lock for it */
+  if (fs_rtp_ssrc_index_contains (self->priv->ssrc_index, ssrc))
+  {
+    fs_rtp_session_has_disposed_exit (self);
+    return;
+  }
+
   FS_RTP_SESSION_LOCK (self);
 
   if (!g_hash_table_lookup (self->priv->ssrc_streams,  GUINT_TO_POINTER (ssrc)))
@@ -1469,6 +1787,7 @@ _stream_known_source_packet_received (FsRtpStream *stream, guint component,
     GST_DEBUG ("Associating SSRC %x in session %d", ssrc, self->id);
     g_hash_table_insert (self->priv->ssrc_streams, GUINT_TO_POINTER (ssrc),
         stream);
+    fs_rtp_ssrc_index_insert (self->priv->ssrc_index, ssrc);
 
     FS_RTP_SESSION_UNLOCK (self);
 
@@ -1510,6 +1829,7 @@ _stream_ssrc_added_cb (FsRtpStream *stream, guint32 ssrc, gpointer user_data)
       stream);
   g_hash_table_insert (self->priv->ssrc_streams_manual, GUINT_TO_POINTER (ssrc),
       stream);
+  fs_rtp_ssrc_index_insert (self->priv->ssrc_index, ssrc);
   FS_RTP_SESSION_UNLOCK (self);
 
   fs_rtp_session_associate_free_substreams (self, stream, ssrc);
@@ -1522,11 +1842,90 @@ _remove_stream_from_ht (gpointer key, gpointer value, gpointer user_data)
   return (value == user_data);
 }
 
+struct remove_stream_data {
+  FsRtpSession *session;
+  gpointer stream;
+};
+
+static gboolean
+_remove_stream_from_ssrc_streams (gpointer key, gpointer value,
+    gpointer user_data)
+{
+  struct remove_stream_data *data = user_data;
+
+  if (value != data->stream)
+    return FALSE;
+
+  fs_rtp_ssrc_index_remove (data->session->priv->ssrc_index,
+      GPOINTER_TO_UINT (key));
+  return TRUE;
+}
+
+/*
+ * The result of folding the remote codecs of one stream into the
+ * negotiation, each step is computed from the previous one (or from the
+ * negotiation base for the first one), so it stays valid as long as the
+ * steps before it and the remote codecs it was computed from are unchanged.
+ */
+typedef struct {
+  FsRtpStream *stream;
+  GList *remote_codecs;
+  GList *codec_associations;
+} NegotiationStep;
+
+static void
+negotiation_step_free (NegotiationStep *step)
+{
+  fs_codec_list_destroy (step->remote_codecs);
+  codec_association_list_destroy (step->codec_associations);
+  g_slice_free (NegotiationStep, step);
+}
+
+static gint
+_negotiation_step_has_stream (gconstpointer step, gconstpointer stream)
+{
+  const NegotiationStep *negotiation_step = step;
+
+  if (negotiation_step->stream == stream)
+    return 0;
+  else
+    return 1;
+}
+
+/*
+ * Frees the cached negotiation steps starting with @from, all of them
+ * if @from is %NULL.
+ *
+ * MUST be called with the FsRtpSession lock held
+ */
+static void
+fs_rtp_session_clear_negotiation_steps (FsRtpSession *self, GList *from)
+{
+  GList *item;
+
+  if (!from)
+    from = self->priv->negotiation_steps;
+  if (!from)
+    return;
+
+  if (from->prev)
+    from->prev->next = NULL;
+  else
+    self->priv->negotiation_steps = NULL;
+  from->prev = NULL;
+
+  for (item = from; item; item = g_list_next (item))
+    negotiation_step_free (item->data);
+  g_list_free (from);
+}
+
 static void
 _remove_stream (gpointer user_data,
     GObject *where_the_object_was)
 {
   FsRtpSession *self = FS_RTP_SESSION (user_data);
+  struct remove_stream_data data;
+  GList *step_item;
 
   if (fs_rtp_session_has_disposed_enter (self, NULL))
     return;
@@ -1535,9 +1934,15 @@ _remove_stream (gpointer user_data,
   self->priv->streams =
     g_list_remove_all (self->priv->streams, where_the_object_was);
   self->priv->streams_cookie++;
-
-  g_hash_table_foreach_remove (self->priv->ssrc_streams, _remove_stream_from_ht,
-      where_the_object_was);
+  step_item = g_list_find_custom (self->priv->negotiation_steps,
+      where_the_object_was, _negotiation_step_has_stream);
+  if (step_item)
+    fs_rtp_session_clear_negotiation_steps (self, step_item);
+
+  data.session = self;
+  data.stream = where_the_object_was;
+  g_hash_table_foreach_remove (self->priv->ssrc_streams,
+      _remove_stream_from_ssrc_streams, &data);
   g_hash_table_foreach_remove (self->priv->ssrc_streams_manual,
       _remove_stream_from_ht, where_the_object_was);
   FS_RTP_SESSION_UNLOCK (self);
@@ -1710,8 +2115,8 @@ fs_rtp_session_set_send_codec (FsSession *session, FsCodec *send_codec,
 
   FS_RTP_SESSION_LOCK (self);
 
-  if (lookup_codec_association_by_codec_for_sending (
-          self->priv->codec_associations, send_codec))
+  if (codec_association_table_lookup_by_codec_for_sending (
+          self->priv->codec_association_table, send_codec))
   {
     if (self->priv->requested_send_codec)
       fs_codec_destroy (self->priv->requested_send_codec);
@@ -1815,28 +2220,24 @@ fs_rtp_session_new (FsMediaType media_type, FsRtpConference *conference,
 }
 
 
+/*
+ * This is called from the streaming threads of rtpbin, so it does not take
+ * the session lock, the table is only freed once no reader can still be
+ * looking at it.
+ */
 GstCaps *
 fs_rtp_session_request_pt_map (FsRtpSession *session, guint pt)
 {
   GstCaps *caps = NULL;
-  CodecAssociation *ca = NULL;
+  CodecAssociationTable *table;
 
   if (fs_rtp_session_has_disposed_enter (session, NULL))
     return NULL;
 
-  FS_RTP_SESSION_LOCK (session);
-
-  ca = lookup_codec_association_by_pt (
-      session->priv->codec_associations, pt);
-
-  if (ca)
-  {
-    FsCodec *tmpcodec = codec_copy_filtered (ca->codec, FS_PARAM_TYPE_CONFIG);
-    caps = fs_codec_to_gst_caps (tmpcodec);
-    fs_codec_destroy (tmpcodec);
-  }
-
-  FS_RTP_SESSION_UNLOCK (session);
+  g_atomic_int_inc (&session->priv->codec_association_table_readers);
+  table = g_atomic_pointer_get (&session->priv->codec_association_table);
+  caps = codec_association_table_get_pt_caps (table, pt);
+  g_atomic_int_add (&session->priv->codec_association_table_readers, -1);
 
   if (!caps)
     GST_WARNING ("Could not get caps for payload type %u in session %d",
@@ -2261,6 +2662,45 @@ fs_rtp_session_distribute_recv_codecs_locked (FsRtpSession *session,
 }
 
 
+/*
+ * Returns the caps of the raw media fed to the encoders, or %NULL if no
+ * media has been received yet
+ */
+static GstCaps *
+fs_rtp_session_get_encoder_input_caps (FsRtpSession *session)
+{
+  if (!session->priv->media_sink_pad)
+    return NULL;
+
+  return gst_pad_get_negotiated_caps (session->priv->media_sink_pad);
+}
+
+/*
+ * Takes the config of the codecs that need it from the config cache, if
+ * they were discovered earlier with the same encoder setup
+ */
+static void
+fill_codec_config_from_cache (FsRtpSession *session, GList *codec_associations)
+{
+  GList *item;
+  GstCaps *input_caps = fs_rtp_session_get_encoder_input_caps (session);
+
+  for (item = codec_associations; item; item = g_list_next (item))
+  {
+    CodecAssociation *ca = item->data;
+
+    if (!ca->need_config || !ca->send_codec)
+      continue;
+
+    if (lookup_codec_config_cache (ca->blueprint, ca->send_profile,
+            ca->send_codec, input_caps, ca->codec))
+      ca->need_config = FALSE;
+  }
+
+  if (input_caps)
+    gst_caps_unref (input_caps);
+}
+
 /**
  * fs_rtp_session_negotiate_codecs_locked:
  * @session: a #FsRtpSession
@@ -2274,6 +2714,9 @@ fs_rtp_session_distribute_recv_codecs_locked (FsRtpSession *session,
  * If a stream is specified, it will use the specified remote codecs
  * instead of the ones currently in the stream
  *
+ * The intermediate result after each stream is cached, so only the streams
+ * from the first one whose remote codecs changed are negotiated again.
+ *
  * Returns: the newly negotiated codec associations or %NULL on error
  */
 
@@ -2287,6 +2730,10 @@ fs_rtp_session_negotiate_codecs_locked (FsRtpSession *session,
   gint streams_with_codecs = 0;
   gboolean has_many_streams = FALSE;
   GList *new_negotiated_codec_associations = NULL;
+  GList *base;
+  GList *current;
+  GList *tmp_codec_associations;
+  GList *step_item;
   GList *item;
 
   *has_remotes = FALSE;
@@ -2310,58 +2757,105 @@ fs_rtp_session_negotiate_codecs_locked (FsRtpSession *session,
   if (streams_with_codecs >= 2)
     has_many_streams = TRUE;
 
-  new_negotiated_codec_associations = create_local_codec_associations (
+  base = create_local_codec_associations (
       session->priv->blueprints, session->priv->codec_preferences,
       session->priv->codec_associations);
 
-  if (!new_negotiated_codec_associations)
+  if (!base)
   {
     g_set_error (error, FS_ERROR, FS_ERROR_NO_CODECS_LEFT,
         "Codec config would leave no valid local codecs");
     goto error;
   }
 
+  /* The cached steps were all computed from the previous base, so if it
+   * changed (local codecs, preferences..) none of them can be re-used */
+  if (has_many_streams == session->priv->negotiation_multi_stream &&
+      codec_associations_list_are_identical (base,
+          session->priv->negotiation_base))
+  {
+    codec_association_list_destroy (base);
+  }
+  else
+  {
+    fs_rtp_session_clear_negotiation_steps (session, NULL);
+    codec_association_list_destroy (session->priv->negotiation_base);
+    session->priv->negotiation_base = base;
+    session->priv->negotiation_multi_stream = has_many_streams;
+  }
+
+  current = session->priv->negotiation_base;
+  step_item = session->priv->negotiation_steps;
+
   for (item = g_list_first (session->priv->streams);
        item;
        item = g_list_next (item))
   {
     FsRtpStream *mystream = item->data;
     GList *codecs = NULL;
+    NegotiationStep *step;
 
     if (mystream == stream)
       codecs = remote_codecs;
     else
       codecs = mystream->remote_codecs;
 
-    if (codecs)
+    if (!codecs)
+      continue;
+
+    *has_remotes = TRUE;
+
+    /* Only the streams from the first one whose remote codecs changed
+     * have to be folded in again */
+    if (step_item)
     {
-      GList *tmp_codec_associations = NULL;
+      step = step_item->data;
 
-      *has_remotes = TRUE;
+      if (step->stream == mystream &&
+          fs_codec_list_are_equal (step->remote_codecs, codecs))
+      {
+        current = step->codec_associations;
+        step_item = g_list_next (step_item);
+        continue;
+      }
 
-      tmp_codec_associations = negotiate_stream_codecs (codecs,
-          new_negotiated_codec_associations, has_many_streams);
+      fs_rtp_session_clear_negotiation_steps (session, step_item);
+      step_item = NULL;
+    }
 
-      codec_association_list_destroy (new_negotiated_codec_associations);
-      new_negotiated_codec_associations = tmp_codec_associations;
+    tmp_codec_associations = negotiate_stream_codecs (codecs, current,
+        has_many_streams);
 
-      if (!new_negotiated_codec_associations)
-        break;
+    if (!tmp_codec_associations)
+    {
+      g_set_error (error, FS_ERROR, FS_ERROR_NEGOTIATION_FAILED,
+          "There was no intersection between the remote codecs"
+          " and the local ones");
+      goto error;
     }
-  }
 
-  if (!new_negotiated_codec_associations)
-  {
-    g_set_error (error, FS_ERROR, FS_ERROR_NEGOTIATION_FAILED,
-        "There was no intersection between the remote codecs"
-        " and the local ones");
-    goto error;
+    step = g_slice_new (NegotiationStep);
+    step->stream = mystream;
+    step->remote_codecs = fs_codec_list_copy (codecs);
+    step->codec_associations = tmp_codec_associations;
+    session->priv->negotiation_steps =
+      g_list_append (session->priv->negotiation_steps, step);
+
+    current = tmp_codec_associations;
   }
 
+  /* Streams that had remote codecs may have lost them */
+  if (step_item)
+    fs_rtp_session_clear_negotiation_steps (session, step_item);
+
+  new_negotiated_codec_associations = codec_association_list_copy (current);
+
   new_negotiated_codec_associations = finish_codec_negotiation (
       session->priv->codec_associations,
       new_negotiated_codec_associations);
 
+  fill_codec_config_from_cache (session, new_negotiated_codec_associations);
+
   new_negotiated_codec_associations =
     fs_rtp_special_sources_negotiation_filter (
         new_negotiated_codec_associations);
@@ -2375,6 +2869,37 @@ fs_rtp_session_negotiate_codecs_locked (FsRtpSession *session,
 
 
 
+/**
+ * fs_rtp_session_update_codec_association_table_locked:
+ * @session: a #FsRtpSession
+ *
+ * Rebuilds the index of the current codec associations. The new table is
+ * swapped in atomically and the old one is freed once the readers that may
+ * have seen it are gone, they only hold it for a few instructions.
+ *
+ * MUST be called with the FsRtpSession lock held
+ */
+
+static void
+fs_rtp_session_update_codec_association_table_locked (FsRtpSession *session)
+{
+  CodecAssociationTable *old_table = session->priv->codec_association_table;
+  CodecAssociationTable *table = codec_association_table_new (
+      session->priv->codec_associations);
+
+  /* Writers are serialized by the session lock, so this always succeeds */
+  g_atomic_pointer_compare_and_exchange (
+      &session->priv->codec_association_table, old_table, table);
+
+  while (g_atomic_int_get (&session->priv->codec_association_table_readers))
+    g_thread_yield ();
+
+  codec_association_table_free (old_table);
+
+  /* The pooled send codec bins may have to be replaced */
+  fs_rtp_session_schedule_send_codec_bin_pool_fill_locked (session);
+}
+
 /**
  * fs_rtp_session_update_codecs:
  * @session: a #FsRtpSession
@@ -2401,6 +2926,7 @@ fs_rtp_session_update_codecs (FsRtpSession *session,
   gboolean is_new = TRUE;
   GList *old_negotiated_codec_associations;
   gboolean has_remotes = FALSE;
+  guint64 fingerprint;
 
   FS_RTP_SESSION_LOCK (session);
 
@@ -2417,15 +2943,22 @@ fs_rtp_session_update_codecs (FsRtpSession *session,
   }
 
   session->priv->codec_associations = new_negotiated_codec_associations;
+  fs_rtp_session_update_codec_association_table_locked (session);
+
+  fingerprint = codec_associations_list_fingerprint (
+      new_negotiated_codec_associations);
 
   if (old_negotiated_codec_associations)
   {
-    is_new = ! codec_associations_list_are_equal (
-        old_negotiated_codec_associations,
-        new_negotiated_codec_associations);
+    if (!session->priv->codec_associations_fingerprint)
+      session->priv->codec_associations_fingerprint =
+        codec_associations_list_fingerprint (
+            old_negotiated_codec_associations);
+    is_new = (fingerprint != session->priv->codec_associations_fingerprint);
 
     codec_association_list_destroy (old_negotiated_codec_associations);
   }
+  session->priv->codec_associations_fingerprint = fingerprint;
 
   fs_rtp_session_distribute_recv_codecs_locked (session, stream, remote_codecs);
 
@@ -2791,7 +3324,8 @@ fs_rtp_session_get_recv_codec_locked (FsRtpSession *session,
     return NULL;
   }
 
-  ca = lookup_codec_association_by_pt (session->priv->codec_associations, pt);
+  ca = codec_association_table_lookup_by_pt (
+      session->priv->codec_association_table, pt);
 
   if (!ca)
   {
@@ -2863,8 +3397,8 @@ fs_rtp_session_select_send_codec_locked (FsRtpSession *session, GError **error)
 
   if (session->priv->requested_send_codec)
   {
-    ca = lookup_codec_association_by_codec_for_sending (
-        session->priv->codec_associations,
+    ca = codec_association_table_lookup_by_codec_for_sending (
+        session->priv->codec_association_table,
         session->priv->requested_send_codec);
     if (ca)
       return ca;
@@ -3088,53 +3622,512 @@ link_other_pads (gpointer item, GValue *ret, gpointer user_data)
 }
 
 
+/*
+ * The send codec bins in the pool have the send codec they were built for
+ * attached to them, a bin can only be reused for the exact same send codec
+ */
+#define SEND_CODEC_DATA "fs-send-codec"
+
+static void
+_set_send_codec_bin_codec (GstElement *codecbin, const FsCodec *send_codec)
+{
+  g_object_set_data_full (G_OBJECT (codecbin), SEND_CODEC_DATA,
+      fs_codec_copy (send_codec), (GDestroyNotify) fs_codec_destroy);
+}
+
 static gboolean
-fs_rtp_session_remove_send_codec_bin (FsRtpSession *self,
-    FsCodec *send_codec,
-    GstElement *send_codecbin,
-    gboolean error_emit)
+_send_codec_is_negotiated_locked (FsRtpSession *self, FsCodec *send_codec)
 {
-  FS_RTP_SESSION_LOCK (self);
+  GList *item;
 
-  if (self->priv->send_codecbin || send_codecbin)
+  for (item = self->priv->codec_associations; item; item = g_list_next (item))
   {
-    GstElement *codecbin = self->priv->send_codecbin;
-    self->priv->send_codecbin = NULL;
-
-    FS_RTP_SESSION_UNLOCK (self);
+    CodecAssociation *ca = item->data;
 
-    if (!codecbin)
-      codecbin = send_codecbin;
+    if (codec_association_is_valid_for_sending (ca, TRUE) &&
+        fs_codec_are_equal (ca->send_codec, send_codec))
+      return TRUE;
+  }
 
-    gst_element_set_locked_state (codecbin, TRUE);
-    if (gst_element_set_state (codecbin, GST_STATE_NULL) !=
-        GST_STATE_CHANGE_SUCCESS)
-    {
-      gst_element_set_locked_state (codecbin, FALSE);
-      GST_ERROR ("Could not stop the codec bin, setting it to NULL did not"
-          " succeed");
-      if (error_emit)
-        fs_session_emit_error (FS_SESSION (self), FS_ERROR_INTERNAL,
-            "Could not stop the codec bin",
-            "Setting the codec bin to NULL did not succeed" );
-      return FALSE;
-    }
+  return FALSE;
+}
 
-    gst_bin_remove (GST_BIN (self->priv->conference), codecbin);
-    FS_RTP_SESSION_LOCK (self);
-  }
+/*
+ * This is a  GstIteratorFoldFunction
+ * It returns FALSE when it wants to stop the iteration
+ */
 
-  fs_codec_destroy (self->priv->current_send_codec);
-  self->priv->current_send_codec = NULL;
-  FS_RTP_SESSION_UNLOCK (self);
+static gboolean
+unlink_pad (gpointer item, GValue *ret, gpointer user_data)
+{
+  GstPad *pad = item;
+  GstPad *peer = gst_pad_get_peer (pad);
 
-  while (self->priv->extra_send_capsfilters)
+  if (peer)
   {
-    GstElement *cf = self->priv->extra_send_capsfilters->data;
-    GstPad *ourpad = gst_element_get_static_pad (cf, "src");
-    GstPad *pad = NULL;
+    if (GST_PAD_IS_SRC (pad))
+      gst_pad_unlink (pad, peer);
+    else
+      gst_pad_unlink (peer, pad);
+    gst_object_unref (peer);
+  }
 
-    if (ourpad)
+  gst_object_unref (pad);
+
+  return TRUE;
+}
+
+static void
+_destroy_pooled_send_codec_bin (FsRtpSession *self, GstElement *codecbin)
+{
+  gst_element_set_locked_state (codecbin, TRUE);
+  gst_element_set_state (codecbin, GST_STATE_NULL);
+  gst_bin_remove (GST_BIN (self->priv->conference), codecbin);
+}
+
+/*
+ * Removes the bins that do not fit in the pool anymore, the caller must
+ * destroy them after releasing the lock
+ */
+
+static GList *
+fs_rtp_session_trim_send_codec_bin_pool_locked (FsRtpSession *self)
+{
+  GList *excess = NULL;
+
+  while (g_list_length (self->priv->send_codecbin_pool) >
+      self->priv->send_codecbin_pool_size)
+  {
+    GList *last = g_list_last (self->priv->send_codecbin_pool);
+
+    excess = g_list_prepend (excess, last->data);
+    self->priv->send_codecbin_pool = g_list_delete_link (
+        self->priv->send_codecbin_pool, last);
+  }
+
+  return excess;
+}
+
+static void
+_destroy_pooled_send_codec_bins (FsRtpSession *self, GList *codecbins)
+{
+  while (codecbins)
+  {
+    _destroy_pooled_send_codec_bin (self, codecbins->data);
+    codecbins = g_list_delete_link (codecbins, codecbins);
+  }
+}
+
+/**
+ * fs_rtp_session_take_pooled_send_codec_bin_locked:
+ * @self: a #FsRtpSession
+ * @send_codec: the send codec that the bin must have been built for
+ *
+ * Removes a ready send codec bin from the pool, it is still inside the
+ * conference and has its state locked.
+ *
+ * Returns: the codec bin or %NULL if there is none for this codec
+ */
+
+static GstElement *
+fs_rtp_session_take_pooled_send_codec_bin_locked (FsRtpSession *self,
+    FsCodec *send_codec)
+{
+  GList *item;
+
+  for (item = self->priv->send_codecbin_pool; item; item = g_list_next (item))
+  {
+    GstElement *codecbin = item->data;
+
+    if (fs_codec_are_equal (g_object_get_data (G_OBJECT (codecbin),
+                SEND_CODEC_DATA), send_codec))
+    {
+      self->priv->send_codecbin_pool = g_list_delete_link (
+          self->priv->send_codecbin_pool, item);
+      return codecbin;
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * Removes from the pool the bins built for another codec with the same
+ * payload type, they have the same name as the bin that is about to be
+ * built and could not be in the conference at the same time. The caller
+ * must destroy them after releasing the lock
+ */
+
+static GList *
+fs_rtp_session_evict_pooled_send_codec_bins_locked (FsRtpSession *self,
+    gint pt)
+{
+  GList *item, *next;
+  GList *evicted = NULL;
+
+  for (item = self->priv->send_codecbin_pool; item; item = next)
+  {
+    FsCodec *pooled_codec = g_object_get_data (G_OBJECT (item->data),
+        SEND_CODEC_DATA);
+
+    next = g_list_next (item);
+
+    if (pooled_codec->id == pt)
+    {
+      evicted = g_list_prepend (evicted, item->data);
+      self->priv->send_codecbin_pool = g_list_delete_link (
+          self->priv->send_codecbin_pool, item);
+    }
+  }
+
+  return evicted;
+}
+
+/**
+ * fs_rtp_session_pool_send_codec_bin:
+ * @self: a #FsRtpSession
+ * @codecbin: the send codec bin that is being replaced
+ *
+ * Unlinks the send codec bin and puts it back in the READY state in the pool
+ * instead of destroying it.
+ *
+ * Returns: %TRUE if the codec bin has been put in the pool, %FALSE if the
+ * caller must destroy it
+ */
+
+static gboolean
+fs_rtp_session_pool_send_codec_bin (FsRtpSession *self, GstElement *codecbin)
+{
+  GstIterator *iter;
+  GValue unused = {0};
+  GList *excess;
+  guint pool_size;
+
+  FS_RTP_SESSION_LOCK (self);
+  pool_size = self->priv->send_codecbin_pool_size;
+  FS_RTP_SESSION_UNLOCK (self);
+
+  if (pool_size == 0 ||
+      !g_object_get_data (G_OBJECT (codecbin), SEND_CODEC_DATA))
+    return FALSE;
+
+  gst_element_set_locked_state (codecbin, TRUE);
+  if (gst_element_set_state (codecbin, GST_STATE_READY) ==
+      GST_STATE_CHANGE_FAILURE)
+    return FALSE;
+
+  iter = gst_element_iterate_pads (codecbin);
+  g_value_init (&unused, G_TYPE_BOOLEAN);
+  gst_iterator_fold (iter, unlink_pad, &unused, NULL);
+  gst_iterator_free (iter);
+  g_value_unset (&unused);
+
+  FS_RTP_SESSION_LOCK (self);
+  self->priv->send_codecbin_pool = g_list_prepend (
+      self->priv->send_codecbin_pool, codecbin);
+  excess = fs_rtp_session_trim_send_codec_bin_pool_locked (self);
+  FS_RTP_SESSION_UNLOCK (self);
+
+  _destroy_pooled_send_codec_bins (self, excess);
+
+  return TRUE;
+}
+
+/**
+ * fs_rtp_session_fill_send_codec_bin_pool:
+ * @self: a #FsRtpSession
+ *
+ * Drops the pooled bins whose codec is no longer negotiated and pre-builds
+ * the bins of the most preferred send codecs until the pool is full.
+ *
+ * The bins are built from a copy of the codec associations without any
+ * lock held, the send_pad_blocked_mutex is only taken to add them to the
+ * conference, so that they can not clash with the bin being built when
+ * switching codecs.
+ *
+ * Must be called without the session lock or the send_pad_blocked_mutex,
+ * from the timer wheel, see
+ * fs_rtp_session_schedule_send_codec_bin_pool_fill_locked()
+ */
+
+static void
+fs_rtp_session_fill_send_codec_bin_pool (FsRtpSession *self)
+{
+  GList *item, *next;
+  GList *codecs = NULL;
+  GList *cas = NULL;
+  GList *to_build = NULL;
+  GList *new_codecbins = NULL;
+  GList *excess = NULL;
+  FsCodec *current_send_codec = NULL;
+  gint current_pt = -1;
+  guint count;
+
+  FS_RTP_SESSION_LOCK (self);
+
+  /* The pool is keyed on the send codec, so is the bin in use */
+  if (self->priv->send_codecbin)
+    current_send_codec = g_object_get_data (
+        G_OBJECT (self->priv->send_codecbin), SEND_CODEC_DATA);
+  if (current_send_codec)
+    current_pt = current_send_codec->id;
+
+  for (item = self->priv->send_codecbin_pool; item; item = next)
+  {
+    next = g_list_next (item);
+
+    if (!_send_codec_is_negotiated_locked (self,
+            g_object_get_data (G_OBJECT (item->data), SEND_CODEC_DATA)))
+    {
+      excess = g_list_prepend (excess, item->data);
+      self->priv->send_codecbin_pool = g_list_delete_link (
+          self->priv->send_codecbin_pool, item);
+    }
+  }
+
+  excess = g_list_concat (excess,
+      fs_rtp_session_trim_send_codec_bin_pool_locked (self));
+
+  count = g_list_length (self->priv->send_codecbin_pool);
+  if (count < self->priv->send_codecbin_pool_size)
+  {
+    codecs = codec_associations_to_send_codecs (
+        self->priv->codec_associations);
+    cas = codec_association_list_copy (self->priv->codec_associations);
+  }
+
+  for (item = cas;
+       item && count < self->priv->send_codecbin_pool_size;
+       item = g_list_next (item))
+  {
+    CodecAssociation *ca = item->data;
+    GList *item2;
+
+    if (!codec_association_is_valid_for_sending (ca, TRUE))
+      continue;
+
+    /* Also skips other codecs with the same payload type as the bin in use,
+     * both bins would have the same name */
+    if (ca->send_codec->id == current_pt)
+      continue;
+
+    for (item2 = self->priv->send_codecbin_pool;
+         item2;
+         item2 = g_list_next (item2))
+      if (fs_codec_are_equal (g_object_get_data (G_OBJECT (item2->data),
+                  SEND_CODEC_DATA), ca->send_codec))
+        break;
+    if (item2)
+      continue;
+
+    to_build = g_list_append (to_build, ca);
+    count++;
+  }
+
+  FS_RTP_SESSION_UNLOCK (self);
+
+  _destroy_pooled_send_codec_bins (self, excess);
+
+  for (item = to_build; item; item = g_list_next (item))
+  {
+    CodecAssociation *ca = item->data;
+    GstElement *codecbin;
+    gchar *name;
+
+    name = g_strdup_printf ("send_%d_%d", self->id, ca->send_codec->id);
+    codecbin = _create_codec_bin (ca, ca->send_codec, name, TRUE, codecs,
+        NULL);
+    g_free (name);
+
+    if (!codecbin)
+      continue;
+
+    _set_send_codec_bin_codec (codecbin, ca->send_codec);
+
+    /* Opening the elements can be slow, so do it before they are in the
+     * conference */
+    gst_element_set_locked_state (codecbin, TRUE);
+    if (gst_element_set_state (codecbin, GST_STATE_READY) ==
+        GST_STATE_CHANGE_FAILURE)
+    {
+      GST_WARNING ("Could not set pre-built send codec bin to READY");
+      gst_element_set_state (codecbin, GST_STATE_NULL);
+      gst_object_unref (codecbin);
+      continue;
+    }
+
+    new_codecbins = g_list_append (new_codecbins, codecbin);
+  }
+
+  g_list_free (to_build);
+  codec_association_list_destroy (cas);
+  fs_codec_list_destroy (codecs);
+
+  if (!new_codecbins)
+    return;
+
+  g_mutex_lock (self->priv->send_pad_blocked_mutex);
+
+  while (new_codecbins)
+  {
+    GstElement *codecbin = new_codecbins->data;
+    FsCodec *send_codec = g_object_get_data (G_OBJECT (codecbin),
+        SEND_CODEC_DATA);
+    gboolean wanted;
+
+    new_codecbins = g_list_delete_link (new_codecbins, new_codecbins);
+
+    /* The codecs may have been renegotiated or switched while building */
+    FS_RTP_SESSION_LOCK (self);
+    current_send_codec = NULL;
+    if (self->priv->send_codecbin)
+      current_send_codec = g_object_get_data (
+          G_OBJECT (self->priv->send_codecbin), SEND_CODEC_DATA);
+    wanted = _send_codec_is_negotiated_locked (self, send_codec) &&
+      (!current_send_codec || current_send_codec->id != send_codec->id) &&
+      g_list_length (self->priv->send_codecbin_pool) <
+      self->priv->send_codecbin_pool_size;
+    for (item = self->priv->send_codecbin_pool;
+         wanted && item;
+         item = g_list_next (item))
+      if (((FsCodec *) g_object_get_data (G_OBJECT (item->data),
+                  SEND_CODEC_DATA))->id == send_codec->id)
+        wanted = FALSE;
+    FS_RTP_SESSION_UNLOCK (self);
+
+    if (!wanted ||
+        !gst_bin_add (GST_BIN (self->priv->conference), codecbin))
+    {
+      if (wanted)
+        GST_WARNING ("Could not add pre-built send codec bin to the"
+            " conference");
+      gst_element_set_state (codecbin, GST_STATE_NULL);
+      gst_object_unref (codecbin);
+      continue;
+    }
+
+    FS_RTP_SESSION_LOCK (self);
+    self->priv->send_codecbin_pool = g_list_append (
+        self->priv->send_codecbin_pool, codecbin);
+    FS_RTP_SESSION_UNLOCK (self);
+  }
+
+  g_mutex_unlock (self->priv->send_pad_blocked_mutex);
+}
+
+static void
+fs_rtp_session_fill_send_codec_bin_pool_timeout (gpointer user_data)
+{
+  FsRtpSession *self = FS_RTP_SESSION (user_data);
+
+  if (fs_rtp_session_has_disposed_enter (self, NULL))
+    return;
+
+  fs_rtp_session_fill_send_codec_bin_pool (self);
+
+  fs_rtp_session_has_disposed_exit (self);
+}
+
+/**
+ * fs_rtp_session_schedule_send_codec_bin_pool_fill_locked:
+ * @self: a #FsRtpSession
+ *
+ * Asks the timer wheel of the conference to (re)fill the send codec bin pool
+ * from one of its threads as soon as possible. Called whenever the codec
+ * associations, the send codec or the size of the pool change, never from
+ * the streaming thread directly, building the bins would stall the media.
+ *
+ * MUST be called with the FsRtpSession lock held
+ */
+
+static void
+fs_rtp_session_schedule_send_codec_bin_pool_fill_locked (FsRtpSession *self)
+{
+  FsRtpTimerWheel *wheel;
+  GError *error = NULL;
+
+  /* Before construction, there are no codec associations yet */
+  if (!self->priv->codec_associations || !self->priv->conference)
+    return;
+
+  if (self->priv->send_codecbin_pool_size == 0 &&
+      !self->priv->send_codecbin_pool)
+    return;
+
+  wheel = fs_rtp_conference_get_timer_wheel (self->priv->conference);
+
+  if (self->priv->send_codecbin_pool_timer)
+  {
+    fs_rtp_timer_wheel_reschedule (wheel, self->priv->send_codecbin_pool_timer,
+        fs_rtp_timer_wheel_get_time (wheel));
+    return;
+  }
+
+  self->priv->send_codecbin_pool_timer = fs_rtp_timer_wheel_add (wheel,
+      fs_rtp_timer_wheel_get_time (wheel),
+      fs_rtp_session_fill_send_codec_bin_pool_timeout, self, &error);
+  if (!self->priv->send_codecbin_pool_timer)
+    GST_WARNING ("Could not schedule the filling of the send codec bin"
+        " pool: %s", error ? error->message : "unknown error");
+  g_clear_error (&error);
+}
+
+static gboolean
+fs_rtp_session_remove_send_codec_bin (FsRtpSession *self,
+    FsCodec *send_codec,
+    GstElement *send_codecbin,
+    gboolean error_emit)
+{
+  FS_RTP_SESSION_LOCK (self);
+
+  if (self->priv->send_codecbin || send_codecbin)
+  {
+    GstElement *codecbin = self->priv->send_codecbin;
+    self->priv->send_codecbin = NULL;
+
+    FS_RTP_SESSION_UNLOCK (self);
+
+    if (!codecbin)
+      codecbin = send_codecbin;
+
+    /* Only keep the bins that worked, not the ones we are removing because
+     * of an error */
+    if (error_emit && fs_rtp_session_pool_send_codec_bin (self, codecbin))
+    {
+      GST_DEBUG ("Put the old send codec bin in the pool");
+    }
+    else
+    {
+      gst_element_set_locked_state (codecbin, TRUE);
+      if (gst_element_set_state (codecbin, GST_STATE_NULL) !=
+          GST_STATE_CHANGE_SUCCESS)
+      {
+        gst_element_set_locked_state (codecbin, FALSE);
+        GST_ERROR ("Could not stop the codec bin, setting it to NULL did not"
+            " succeed");
+        if (error_emit)
+          fs_session_emit_error (FS_SESSION (self), FS_ERROR_INTERNAL,
+              "Could not stop the codec bin",
+              "Setting the codec bin to NULL did not succeed" );
+        return FALSE;
+      }
+
+      gst_bin_remove (GST_BIN (self->priv->conference), codecbin);
+    }
+    FS_RTP_SESSION_LOCK (self);
+  }
+
+  fs_codec_destroy (self->priv->current_send_codec);
+  self->priv->current_send_codec = NULL;
+  FS_RTP_SESSION_UNLOCK (self);
+
+  while (self->priv->extra_send_capsfilters)
+  {
+    GstElement *cf = self->priv->extra_send_capsfilters->data;
+    GstPad *ourpad = gst_element_get_static_pad (cf, "src");
+    GstPad *pad = NULL;
+
+    if (ourpad)
     {
       pad = gst_pad_get_peer (ourpad);
       if (pad)
@@ -3170,9 +4163,12 @@ fs_rtp_session_remove_send_codec_bin (FsRtpSession *self,
  * fs_rtp_session_add_send_codec_bin_unlock:
  * @session: a #FsRtpSession
  * @ca: the #CodecAssociation to use
+ * @other_codecs: location for the list of secondary codecs
+ * @from_pool: set to %TRUE if the codec bin came from the pool of ready bins
+ * @error: location of a #GError, or NULL if no error occured
  *
  * This function creates, adds and links a codec bin for the current send remote
- * codec
+ * codec, if a bin for the same codec is ready in the pool, it is used instead
  *
  * Needs the Session lock to be held. and releases it
  *
@@ -3183,6 +4179,7 @@ static GstElement *
 fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
     const CodecAssociation *ca,
     GList **other_codecs,
+    gboolean *from_pool,
     GError **error)
 {
   GstElement *codecbin = NULL;
@@ -3193,22 +4190,46 @@ fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
   GValue link_rv = {0};
   struct link_data data;
   GList *item;
+  GList *evicted = NULL;
   FsCodec *send_codec_copy = fs_codec_copy (ca->send_codec);
   FsCodec *codec_copy = fs_codec_copy (ca->codec);
 
   GST_DEBUG ("Trying to add send codecbin for " FS_CODEC_FORMAT,
       FS_CODEC_ARGS (ca->send_codec));
 
-  name = g_strdup_printf ("send_%d_%d", session->id, ca->send_codec->id);
   codecs = codec_associations_to_send_codecs (
       session->priv->codec_associations);
-  codecbin = _create_codec_bin (ca, ca->send_codec, name, TRUE, codecs, error);
-  g_free (name);
+
+  codecbin = fs_rtp_session_take_pooled_send_codec_bin_locked (session,
+      ca->send_codec);
+  *from_pool = (codecbin != NULL);
+
+  if (!codecbin)
+  {
+    evicted = fs_rtp_session_evict_pooled_send_codec_bins_locked (session,
+        ca->send_codec->id);
+
+    name = g_strdup_printf ("send_%d_%d", session->id, ca->send_codec->id);
+    codecbin = _create_codec_bin (ca, ca->send_codec, name, TRUE, codecs,
+        error);
+    g_free (name);
+
+    if (codecbin)
+      _set_send_codec_bin_codec (codecbin, ca->send_codec);
+  }
+  else
+  {
+    GST_DEBUG ("Using send codec bin from the pool");
+  }
 
   sendcaps = fs_codec_to_gst_caps (ca->send_codec);
 
   FS_RTP_SESSION_UNLOCK (session);
 
+  /* Must be out of the conference before the new bin with their name is
+   * added */
+  _destroy_pooled_send_codec_bins (session, evicted);
+
   if (!codecbin)
   {
     fs_codec_destroy (send_codec_copy);
@@ -3219,7 +4240,9 @@ fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
 
   gst_element_set_locked_state (codecbin, TRUE);
 
-  if (!gst_bin_add (GST_BIN (session->priv->conference), codecbin))
+  /* The pooled bins are already in the conference */
+  if (!*from_pool && !gst_bin_add (GST_BIN (session->priv->conference),
+          codecbin))
   {
     g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
         "Could not add the send codec bin for: " FS_CODEC_FORMAT,
@@ -3342,7 +4365,8 @@ fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
 
     data.other_codecs = g_list_remove (data.other_codecs, other_send_codec);
 
-    ca = lookup_codec_association_by_pt (session->priv->codec_associations,
+    ca = codec_association_table_lookup_by_pt (
+        session->priv->codec_association_table,
         other_send_codec->id);
 
     if (ca)
@@ -3397,6 +4421,9 @@ _send_src_pad_blocked_callback (GstPad *pad, gboolean blocked,
   GError *error = NULL;
   gboolean changed = FALSE;
   GList *other_codecs = NULL;
+  GstClockTime switch_start;
+  GstClockTime switch_latency = GST_CLOCK_TIME_NONE;
+  gboolean from_pool = FALSE;
 
   if (fs_rtp_session_has_disposed_enter (self, NULL))
   {
@@ -3406,6 +4433,8 @@ _send_src_pad_blocked_callback (GstPad *pad, gboolean blocked,
 
   g_mutex_lock (self->priv->send_pad_blocked_mutex);
 
+  switch_start = gst_util_get_timestamp ();
+
   FS_RTP_SESSION_LOCK (self);
   ca = fs_rtp_session_select_send_codec_locked (self, &error);
 
@@ -3463,8 +4492,12 @@ _send_src_pad_blocked_callback (GstPad *pad, gboolean blocked,
   send_codec_copy = fs_codec_copy (ca->send_codec);
   codec_copy = fs_codec_copy (ca->codec);
 
-  if (!fs_rtp_session_add_send_codec_bin_unlock (self, ca, &other_codecs,
-          &error))
+  if (fs_rtp_session_add_send_codec_bin_unlock (self, ca, &other_codecs,
+          &from_pool, &error))
+  {
+    switch_latency = gst_util_get_timestamp () - switch_start;
+  }
+  else
   {
     fs_session_emit_error (FS_SESSION (self), error->code,
         "Could not build a new send codec bin", error->message);
@@ -3506,6 +4539,16 @@ _send_src_pad_blocked_callback (GstPad *pad, gboolean blocked,
     fs_codec_list_destroy (secondary_codecs);
   }
 
+  if (GST_CLOCK_TIME_IS_VALID (switch_latency))
+    gst_element_post_message (GST_ELEMENT (self->priv->conference),
+        gst_message_new_element (GST_OBJECT (self->priv->conference),
+            gst_structure_new ("farsight-send-codec-switch-latency",
+                "session", FS_TYPE_SESSION, self,
+                "codec", FS_TYPE_CODEC, codec_copy,
+                "latency", G_TYPE_UINT64, switch_latency,
+                "from-pool", G_TYPE_BOOLEAN, from_pool,
+                NULL)));
+
  done:
   g_clear_error (&error);
   fs_codec_destroy (send_codec_copy);
@@ -3518,6 +4561,11 @@ _send_src_pad_blocked_callback (GstPad *pad, gboolean blocked,
 
   gst_pad_set_blocked_async (pad, FALSE, pad_block_do_nothing, NULL);
 
+  /* The bin in use has changed, the pool is refilled from another thread */
+  FS_RTP_SESSION_LOCK (self);
+  fs_rtp_session_schedule_send_codec_bin_pool_fill_locked (self);
+  FS_RTP_SESSION_UNLOCK (self);
+
   g_mutex_unlock (self->priv->send_pad_blocked_mutex);
   fs_rtp_session_has_disposed_exit (self);
   return;
@@ -3544,6 +4592,97 @@ fs_rtp_session_verify_send_codec_bin (FsRtpSession *self)
       _send_src_pad_blocked_callback, self);
 }
 
+static GstElement *
+fs_rtp_session_take_cached_recv_codec_bin_locked (FsRtpSession *session,
+    FsCodec *codec)
+{
+  GList *item;
+
+  for (item = session->priv->recv_codecbin_cache;
+       item;
+       item = g_list_next (item))
+  {
+    GstElement *codecbin = item->data;
+
+    if (fs_codec_are_equal (g_object_get_data (G_OBJECT (codecbin),
+                RECV_CODEC_DATA), codec))
+    {
+      session->priv->recv_codecbin_cache = g_list_delete_link (
+          session->priv->recv_codecbin_cache, item);
+
+      gst_element_set_locked_state (codecbin, FALSE);
+
+      /* Our ref is given to the substream */
+      return codecbin;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * fs_rtp_session_recycle_recv_codec_bin:
+ * @session: a #FsRtpSession
+ * @codec: the #FsCodec that the bin decodes
+ * @codecbin: the receive codec bin of a stopped substream
+ *
+ * Offers the codec bin of a substream that is going away to the cache of
+ * idle receive codec bins. It must already be unlinked or be unlinkable by
+ * removing it from the conference.
+ *
+ * Returns: %TRUE if the session took the codec bin, in that case it has been
+ * removed from the conference and the caller must forget about it
+ */
+
+gboolean
+fs_rtp_session_recycle_recv_codec_bin (FsRtpSession *session,
+    FsCodec *codec,
+    GstElement *codecbin)
+{
+  FsRtpConference *conference;
+  GList *excess;
+
+  FS_RTP_SESSION_LOCK (session);
+  if (session->priv->recv_codecbin_cache_size == 0 ||
+      !session->priv->conference)
+  {
+    FS_RTP_SESSION_UNLOCK (session);
+    return FALSE;
+  }
+  conference = gst_object_ref (session->priv->conference);
+  FS_RTP_SESSION_UNLOCK (session);
+
+  gst_element_set_locked_state (codecbin, TRUE);
+  if (gst_element_set_state (codecbin, GST_STATE_READY) ==
+      GST_STATE_CHANGE_FAILURE)
+  {
+    gst_object_unref (conference);
+    return FALSE;
+  }
+
+  gst_object_ref (codecbin);
+  if (!gst_bin_remove (GST_BIN (conference), codecbin))
+  {
+    gst_object_unref (codecbin);
+    gst_object_unref (conference);
+    return FALSE;
+  }
+  gst_object_unref (conference);
+
+  g_object_set_data_full (G_OBJECT (codecbin), RECV_CODEC_DATA,
+      fs_codec_copy (codec), (GDestroyNotify) fs_codec_destroy);
+
+  FS_RTP_SESSION_LOCK (session);
+  session->priv->recv_codecbin_cache = g_list_prepend (
+      session->priv->recv_codecbin_cache, codecbin);
+  excess = fs_rtp_session_trim_recv_codec_bin_cache_locked (session);
+  FS_RTP_SESSION_UNLOCK (session);
+
+  _destroy_cached_recv_codec_bins (excess);
+
+  return TRUE;
+}
+
 /*
  * This callback is called when the pad of a substream has been locked because
  * the codec needs to be changed.
@@ -3580,7 +4719,22 @@ _substream_get_codec_bin (FsRtpSubStream *substream,
 
   name = g_strdup_printf ("recv_%d_%u_%d", session->id, substream->ssrc,
       substream->pt);
-  codecbin = _create_codec_bin (ca, *new_codec, name, FALSE, NULL, error);
+
+  codecbin = fs_rtp_session_take_cached_recv_codec_bin_locked (session,
+      *new_codec);
+
+  if (codecbin)
+  {
+    GST_DEBUG ("Reusing cached receive codec bin for " FS_CODEC_FORMAT,
+        FS_CODEC_ARGS (*new_codec));
+    session->priv->recv_codecbin_cache_hits++;
+    gst_element_set_name (codecbin, name);
+  }
+  else
+  {
+    session->priv->recv_codecbin_cache_misses++;
+    codecbin = _create_codec_bin (ca, *new_codec, name, FALSE, NULL, error);
+  }
   g_free (name);
 
  out:
@@ -3705,8 +4859,11 @@ fs_rtp_session_associate_ssrc_cname (FsRtpSession *session,
 
   if (!g_hash_table_lookup (session->priv->ssrc_streams,
           GUINT_TO_POINTER (ssrc)))
+  {
     g_hash_table_insert (session->priv->ssrc_streams, GUINT_TO_POINTER (ssrc),
         stream);
+    fs_rtp_ssrc_index_insert (session->priv->ssrc_index, ssrc);
+  }
 
   g_object_ref (stream);
   FS_RTP_SESSION_UNLOCK (session);
@@ -3791,7 +4948,10 @@ fs_rtp_session_bye_ssrc (FsRtpSession *session,
   FS_RTP_SESSION_LOCK (session);
   if (!g_hash_table_lookup (session->priv->ssrc_streams_manual,
           GUINT_TO_POINTER (ssrc)))
+  {
     g_hash_table_remove (session->priv->ssrc_streams, GUINT_TO_POINTER (ssrc));
+    fs_rtp_ssrc_index_remove (session->priv->ssrc_index, ssrc);
+  }
   FS_RTP_SESSION_UNLOCK (session);
 
   /*
@@ -3805,13 +4965,24 @@ fs_rtp_session_bye_ssrc (FsRtpSession *session,
 }
 
 
+/*
+ * Takes the config parameters from the caps produced by the encoder,
+ * @changed is set to %TRUE if they were different from the ones the codec
+ * already had (for example because they came from the config cache)
+ *
+ * Returns: %TRUE if the codec was still waiting for its config
+ */
 static gboolean
-gather_caps_parameters (CodecAssociation *ca, GstCaps *caps)
+gather_caps_parameters (FsRtpSession *session, CodecAssociation *ca,
+    GstCaps *caps, gboolean *changed)
 {
   GstStructure *s = NULL;
   int i;
   gboolean old_need_config = FALSE;
 
+  if (changed)
+    *changed = FALSE;
+
   s = gst_caps_get_structure (caps, 0);
 
   for (i = 0; i < gst_structure_n_fields (s); i++)
@@ -3841,6 +5012,8 @@ gather_caps_parameters (CodecAssociation *ca, GstCaps *caps)
               /* replace the value if its different */
               fs_codec_remove_optional_parameter (ca->codec, param);
               fs_codec_add_optional_parameter (ca->codec, name, value);
+              if (changed)
+                *changed = TRUE;
               break;
             }
           }
@@ -3852,23 +5025,304 @@ gather_caps_parameters (CodecAssociation *ca, GstCaps *caps)
                 ca->codec->id, ca->codec->encoding_name, name, value);
 
             fs_codec_add_optional_parameter (ca->codec, name, value);
+            if (changed)
+              *changed = TRUE;
           }
         }
       }
     }
   }
 
-  old_need_config = ca->need_config;
-  ca->need_config = FALSE;
+  /* The codec may have been modified in place */
+  session->priv->codec_associations_fingerprint = 0;
+
+  old_need_config = ca->need_config;
+  ca->need_config = FALSE;
+
+  return old_need_config;
+}
+
+static void
+_send_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session)
+{
+  GstCaps *caps = NULL;
+  GstCaps *input_caps = NULL;
+  CodecAssociation *ca = NULL;
+  gboolean was_needed;
+  gboolean changed;
+
+  g_object_get (pad, "caps", &caps, NULL);
+
+  if (!caps)
+    return;
+
+  g_return_if_fail (GST_CAPS_IS_SIMPLE(caps));
+
+  if (fs_rtp_session_has_disposed_enter (session, NULL))
+  {
+    gst_caps_unref (caps);
+    return;
+  }
+
+  input_caps = fs_rtp_session_get_encoder_input_caps (session);
+
+  FS_RTP_SESSION_LOCK (session);
+
+  if (!session->priv->current_send_codec)
+    goto out;
+
+  ca = codec_association_table_lookup_by_codec (
+      session->priv->codec_association_table,
+      session->priv->current_send_codec);
+
+  if (!ca)
+    goto out;
+
+  /*
+   * Emit farsight-codecs-changed if the sending thread finds the config
+   * for the last codec that needed it, or if the encoder produced another
+   * config than the one that came from the config cache
+   */
+  was_needed = gather_caps_parameters (session, ca, caps, &changed);
+  if (was_needed || changed)
+  {
+    GList *item = NULL;
+
+    store_codec_config_cache (ca->blueprint, ca->send_profile, ca->send_codec,
+        input_caps, ca->codec);
+
+    for (item = g_list_first (session->priv->codec_associations);
+         item;
+         item = g_list_next (item))
+    {
+      ca = item->data;
+      if (ca->need_config)
+        break;
+    }
+    if (!item)
+    {
+      FS_RTP_SESSION_UNLOCK (session);
+      save_codec_config_cache_async (session->priv->media_type);
+      if (was_needed)
+        g_object_notify (G_OBJECT (session), "codecs-ready");
+      g_object_notify (G_OBJECT (session), "codecs");
+      gst_element_post_message (GST_ELEMENT (session->priv->conference),
+          gst_message_new_element (GST_OBJECT (session->priv->conference),
+              gst_structure_new ("farsight-codecs-changed",
+                  "session", FS_TYPE_SESSION, session,
+                  NULL)));
+
+      goto out_unlocked;
+    }
+
+  }
+
+ out:
+
+  FS_RTP_SESSION_UNLOCK (session);
+
+ out_unlocked:
+
+  gst_caps_unref (caps);
+  if (input_caps)
+    gst_caps_unref (input_caps);
+
+  fs_rtp_session_has_disposed_exit (session);
+}
+
+static void
+fs_rtp_session_post_codec_config_discovered (FsRtpSession *session,
+    FsCodec *codec)
+{
+  gst_element_post_message (GST_ELEMENT (session->priv->conference),
+      gst_message_new_element (GST_OBJECT (session->priv->conference),
+          gst_structure_new ("farsight-codec-config-discovered",
+              "session", FS_TYPE_SESSION, session,
+              "codec", FS_TYPE_CODEC, codec,
+              NULL)));
+}
+
+static void
+_discovery_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session)
+{
+  CodecAssociation *ca = NULL;
+  GstCaps *caps = NULL;
+  GstCaps *input_caps = NULL;
+  gboolean block = TRUE;
+  FsCodec *discovered_codec = NULL;
+
+  g_object_get (pad, "caps", &caps, NULL);
+
+  if (!caps)
+    return;
+
+  g_return_if_fail (GST_CAPS_IS_SIMPLE(caps));
+
+  if (fs_rtp_session_has_disposed_enter (session, NULL))
+  {
+    gst_caps_unref (caps);
+    return;
+  }
+
+  input_caps = fs_rtp_session_get_encoder_input_caps (session);
+
+  FS_RTP_SESSION_LOCK (session);
+
+  /* If there is no codec, its because we're shutting down */
+  if (!session->priv->discovery_codec)
+  {
+    GST_DEBUG ("Got caps while discovery is stopping");
+    goto out;
+  }
+
+  ca = codec_association_table_lookup_by_codec_for_sending (
+      session->priv->codec_association_table,
+      session->priv->discovery_codec);
+
+  if (ca && ca->need_config)
+  {
+    gather_caps_parameters (session, ca, caps, NULL);
+    fs_codec_destroy (session->priv->discovery_codec);
+    session->priv->discovery_codec = fs_codec_copy (ca->codec);
+    block = !ca->need_config;
+    if (block)
+    {
+      store_codec_config_cache (ca->blueprint, ca->send_profile,
+          ca->send_codec, input_caps, ca->codec);
+      discovered_codec = fs_codec_copy (ca->codec);
+    }
+  }
+
+ out:
+
+  FS_RTP_SESSION_UNLOCK (session);
+
+  gst_caps_unref (caps);
+  if (input_caps)
+    gst_caps_unref (input_caps);
+
+  if (discovered_codec)
+  {
+    fs_rtp_session_post_codec_config_discovered (session, discovered_codec);
+    fs_codec_destroy (discovered_codec);
+  }
+
+  if (block)
+    gst_pad_set_blocked_async (session->priv->send_tee_discovery_pad, TRUE,
+        _discovery_pad_blocked_callback, session);
+  fs_rtp_session_has_disposed_exit (session);
+}
+
+/*
+ * Removes the elements of the one codec at a time discovery, must be called
+ * from the streaming thread with the discovery pad blocked or from dispose
+ */
+static void
+fs_rtp_session_remove_discovery_elements (FsRtpSession *session)
+{
+  GstBin *conf = GST_BIN (session->priv->conference);
+
+  stop_and_remove (conf, &session->priv->discovery_fakesink, FALSE);
+  stop_and_remove (conf, &session->priv->discovery_capsfilter, FALSE);
+  stop_and_remove (conf, &session->priv->discovery_codecbin, FALSE);
+}
+
+/*
+ * In parallel discovery, each codec gets its own
+ * tee ! queue ! codecbin ! capsfilter ! fakesink branch, the queue gives
+ * every encoder its own thread.
+ */
+typedef struct {
+  /* Protected by the session lock */
+  FsCodec *codec;
+
+  GstCaps *caps;
+  GstPad *tee_pad;
+  /* The src pad of the capsfilter, not reffed, only used for comparisons */
+  GstPad *caps_pad;
+
+  GstElement *queue;
+  GstElement *codecbin;
+  GstElement *capsfilter;
+  GstElement *fakesink;
+} DiscoveryBranch;
+
+static void
+_remove_discovery_branch_element (GstBin *conf, GstElement **element)
+{
+  if (*element == NULL)
+    return;
+
+  if (GST_OBJECT_PARENT (*element))
+  {
+    stop_and_remove (conf, element, FALSE);
+  }
+  else
+  {
+    gst_object_unref (*element);
+    *element = NULL;
+  }
+}
+
+static void
+discovery_branch_destroy (FsRtpSession *session, DiscoveryBranch *branch)
+{
+  GstBin *conf = GST_BIN (session->priv->conference);
+
+  if (branch->tee_pad)
+  {
+    gst_element_release_request_pad (session->priv->discovery_tee,
+        branch->tee_pad);
+    gst_object_unref (branch->tee_pad);
+  }
+
+  _remove_discovery_branch_element (conf, &branch->queue);
+  _remove_discovery_branch_element (conf, &branch->codecbin);
+  _remove_discovery_branch_element (conf, &branch->capsfilter);
+  _remove_discovery_branch_element (conf, &branch->fakesink);
+
+  if (branch->caps)
+    gst_caps_unref (branch->caps);
+  fs_codec_destroy (branch->codec);
+  g_slice_free (DiscoveryBranch, branch);
+}
+
+/*
+ * Removes the branches of the parallel discovery, and the tee too if
+ * @remove_tee is %TRUE. It must be called from the streaming thread with the
+ * discovery pad blocked or from dispose, without the session lock.
+ */
+static void
+fs_rtp_session_remove_discovery_branches (FsRtpSession *session,
+    gboolean remove_tee)
+{
+  GList *branches;
+  GList *item;
+
+  FS_RTP_SESSION_LOCK (session);
+  branches = session->priv->discovery_branches;
+  session->priv->discovery_branches = NULL;
+  FS_RTP_SESSION_UNLOCK (session);
 
-  return old_need_config;
+  for (item = branches; item; item = g_list_next (item))
+    discovery_branch_destroy (session, item->data);
+  g_list_free (branches);
+
+  if (remove_tee)
+    stop_and_remove (GST_BIN (session->priv->conference),
+        &session->priv->discovery_tee, FALSE);
 }
 
 static void
-_send_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session)
+_discovery_branch_caps_changed (GstPad *pad, GParamSpec *pspec,
+    FsRtpSession *session)
 {
-  GstCaps *caps = NULL;
   CodecAssociation *ca = NULL;
+  GstCaps *caps = NULL;
+  GstCaps *input_caps = NULL;
+  FsCodec *discovered_codec = NULL;
+  gboolean block = FALSE;
+  GList *item;
 
   g_object_get (pad, "caps", &caps, NULL);
 
@@ -3883,111 +5337,312 @@ _send_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session)
     return;
   }
 
+  input_caps = fs_rtp_session_get_encoder_input_caps (session);
+
   FS_RTP_SESSION_LOCK (session);
 
-  if (!session->priv->current_send_codec)
-    goto out;
+  for (item = session->priv->discovery_branches;
+       item;
+       item = g_list_next (item))
+  {
+    DiscoveryBranch *branch = item->data;
 
-  ca = lookup_codec_association_by_codec (session->priv->codec_associations,
-      session->priv->current_send_codec);
+    if (branch->caps_pad == pad)
+    {
+      ca = codec_association_table_lookup_by_codec_for_sending (
+          session->priv->codec_association_table, branch->codec);
 
-  if (!ca)
-    goto out;
+      if (ca && ca->need_config)
+      {
+        gather_caps_parameters (session, ca, caps, NULL);
+        fs_codec_destroy (branch->codec);
+        branch->codec = fs_codec_copy (ca->codec);
+        if (!ca->need_config)
+        {
+          store_codec_config_cache (ca->blueprint, ca->send_profile,
+              ca->send_codec, input_caps, ca->codec);
+          discovered_codec = fs_codec_copy (ca->codec);
+        }
+      }
+      break;
+    }
+  }
 
-  /*
-   * Emit farsight-codecs-changed if the sending thread finds the config
-   * for the last codec that needed it
-   */
-  if (gather_caps_parameters (ca, caps))
-  {
-    GList *item = NULL;
+  if (!item)
+    GST_DEBUG ("Got caps while discovery is stopping");
 
-    for (item = g_list_first (session->priv->codec_associations);
+  /* The branches of the codecs that are already done keep running until
+   * the last one is done, then they are all removed at once */
+  if (discovered_codec)
+  {
+    block = TRUE;
+    for (item = session->priv->codec_associations;
          item;
          item = g_list_next (item))
     {
-      ca = item->data;
-      if (ca->need_config)
+      CodecAssociation *tmpca = item->data;
+
+      if (tmpca->need_config)
+      {
+        block = FALSE;
         break;
+      }
     }
-    if (!item)
-    {
-      FS_RTP_SESSION_UNLOCK (session);
-      g_object_notify (G_OBJECT (session), "codecs-ready");
-      g_object_notify (G_OBJECT (session), "codecs");
-      gst_element_post_message (GST_ELEMENT (session->priv->conference),
-          gst_message_new_element (GST_OBJECT (session->priv->conference),
-              gst_structure_new ("farsight-codecs-changed",
-                  "session", FS_TYPE_SESSION, session,
-                  NULL)));
+  }
 
-      goto out_unlocked;
-    }
+  FS_RTP_SESSION_UNLOCK (session);
+
+  gst_caps_unref (caps);
+  if (input_caps)
+    gst_caps_unref (input_caps);
 
+  if (discovered_codec)
+  {
+    GST_DEBUG ("Discovered config of codec " FS_CODEC_FORMAT,
+        FS_CODEC_ARGS (discovered_codec));
+    fs_rtp_session_post_codec_config_discovered (session, discovered_codec);
+    fs_codec_destroy (discovered_codec);
   }
 
- out:
+  if (block)
+    gst_pad_set_blocked_async (session->priv->send_tee_discovery_pad, TRUE,
+        _discovery_pad_blocked_callback, session);
 
-  FS_RTP_SESSION_UNLOCK (session);
+  fs_rtp_session_has_disposed_exit (session);
+}
 
- out_unlocked:
+static gboolean
+fs_rtp_session_add_discovery_branch_element (FsRtpSession *session,
+    GstElement **element, GstElement *newelem, const gchar *name,
+    GError **error)
+{
+  if (!newelem)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not make discovery %s element", name);
+    return FALSE;
+  }
 
-  gst_caps_unref (caps);
+  if (!gst_bin_add (GST_BIN (session->priv->conference), newelem))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not add the discovery %s to the bin", name);
+    gst_object_unref (newelem);
+    return FALSE;
+  }
 
-  fs_rtp_session_has_disposed_exit (session);
+  *element = newelem;
+
+  if (!gst_element_sync_state_with_parent (newelem))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not sync the discovery %s's state with its parent", name);
+    return FALSE;
+  }
+
+  return TRUE;
 }
 
-static void
-_discovery_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session)
+/*
+ * Builds the branch from the sink to the source, so that data only flows
+ * once the whole branch is ready
+ */
+static gboolean
+fs_rtp_session_link_discovery_branch (FsRtpSession *session,
+    DiscoveryBranch *branch, GError **error)
 {
-  CodecAssociation *ca = NULL;
-  GstCaps *caps = NULL;
-  gboolean block = TRUE;
+  GstElement *codecbin = branch->codecbin;
+  GstPad *pad;
 
-  g_object_get (pad, "caps", &caps, NULL);
+  branch->codecbin = NULL;
 
-  if (!caps)
-    return;
+  if (!fs_rtp_session_add_discovery_branch_element (session,
+          &branch->fakesink, gst_element_factory_make ("fakesink", NULL),
+          "fakesink", error))
+    goto error;
 
-  g_return_if_fail (GST_CAPS_IS_SIMPLE(caps));
+  g_object_set (branch->fakesink,
+      "sync", FALSE,
+      "async", FALSE,
+      NULL);
 
-  if (fs_rtp_session_has_disposed_enter (session, NULL))
+  if (!fs_rtp_session_add_discovery_branch_element (session,
+          &branch->capsfilter, gst_element_factory_make ("capsfilter", NULL),
+          "capsfilter", error))
+    goto error;
+
+  g_object_set (branch->capsfilter, "caps", branch->caps, NULL);
+
+  if (!gst_element_link_pads (branch->capsfilter, "src",
+          branch->fakesink, "sink"))
   {
-    gst_caps_unref (caps);
-    return;
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not link discovery capsfilter and fakesink");
+    goto error;
   }
 
-  FS_RTP_SESSION_LOCK (session);
+  pad = gst_element_get_static_pad (branch->capsfilter, "src");
+  branch->caps_pad = pad;
+  g_signal_connect_object (pad, "notify::caps",
+      G_CALLBACK (_discovery_branch_caps_changed), session, 0);
+  gst_object_unref (pad);
 
-  /* If there is no codec, its because we're shutting down */
-  if (!session->priv->discovery_codec)
+  if (!fs_rtp_session_add_discovery_branch_element (session,
+          &branch->codecbin, codecbin, "codecbin", error))
   {
-    GST_DEBUG ("Got caps while discovery is stopping");
-    goto out;
+    codecbin = NULL;
+    goto error;
   }
+  codecbin = NULL;
 
-  ca = lookup_codec_association_by_codec_for_sending (
-      session->priv->codec_associations,
-      session->priv->discovery_codec);
+  if (!gst_element_link_pads (branch->codecbin, "src",
+          branch->capsfilter, "sink"))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not link discovery codecbin and capsfilter");
+    goto error;
+  }
 
-  if (ca && ca->need_config)
+  if (!fs_rtp_session_add_discovery_branch_element (session,
+          &branch->queue, gst_element_factory_make ("queue", NULL),
+          "queue", error))
+    goto error;
+
+  if (!gst_element_link_pads (branch->queue, "src", branch->codecbin, "sink"))
   {
-    gather_caps_parameters (ca, caps);
-    fs_codec_destroy (session->priv->discovery_codec);
-    session->priv->discovery_codec = fs_codec_copy (ca->codec);
-    block = !ca->need_config;
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not link discovery queue and codecbin");
+    goto error;
   }
 
- out:
+  branch->tee_pad = gst_element_get_request_pad (session->priv->discovery_tee,
+      "src%d");
+  if (!branch->tee_pad)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not get a request pad from the discovery tee");
+    goto error;
+  }
+
+  pad = gst_element_get_static_pad (branch->queue, "sink");
+  if (GST_PAD_LINK_FAILED (gst_pad_link (branch->tee_pad, pad)))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not link the discovery tee and queue");
+    gst_object_unref (pad);
+    goto error;
+  }
+  gst_object_unref (pad);
+
+  return TRUE;
+
+ error:
+  if (codecbin)
+    branch->codecbin = codecbin;
+  return FALSE;
+}
+
+/**
+ * fs_rtp_session_start_parallel_discovery_unlock:
+ * @session: a #FsRtpSession
+ * @error: location of a #GError, or NULL if no error occured
+ *
+ * Replaces the current discovery elements by one branch for each codec
+ * that still needs its config. It must be called from the streaming thread
+ * with the discovery pad blocked.
+ *
+ * Returns: %TRUE on success, %FALSE on error
+ */
+
+static gboolean
+fs_rtp_session_start_parallel_discovery_unlock (FsRtpSession *session,
+    GError **error)
+{
+  GList *branches = NULL;
+  GList *item;
+
+  for (item = session->priv->codec_associations;
+       item;
+       item = g_list_next (item))
+  {
+    CodecAssociation *ca = item->data;
+    DiscoveryBranch *branch;
+    gchar *tmp;
+
+    if (!ca->need_config)
+      continue;
+
+    GST_LOG ("Gathering params for codec " FS_CODEC_FORMAT " in parallel",
+        FS_CODEC_ARGS (ca->send_codec));
+
+    branch = g_slice_new0 (DiscoveryBranch);
+    branches = g_list_append (branches, branch);
+
+    branch->codec = fs_codec_copy (ca->codec);
+    branch->caps = fs_codec_to_gst_caps (ca->send_codec);
+
+    tmp = g_strdup_printf ("discover_%d_%d", session->id, ca->send_codec->id);
+    branch->codecbin = _create_codec_bin (ca, ca->send_codec, tmp, TRUE, NULL,
+        error);
+    g_free (tmp);
+
+    if (!branch->codecbin)
+    {
+      FS_RTP_SESSION_UNLOCK (session);
+      goto error;
+    }
+  }
 
   FS_RTP_SESSION_UNLOCK (session);
 
-  gst_caps_unref (caps);
+  fs_rtp_session_remove_discovery_elements (session);
+  fs_rtp_session_remove_discovery_branches (session, FALSE);
 
-  if (block)
-    gst_pad_set_blocked_async (session->priv->send_tee_discovery_pad, TRUE,
-        _discovery_pad_blocked_callback, session);
-  fs_rtp_session_has_disposed_exit (session);
+  if (!session->priv->discovery_tee)
+  {
+    GstPad *pad;
+    gchar *tmp;
+
+    tmp = g_strdup_printf ("discovery_tee_%d", session->id);
+    if (!fs_rtp_session_add_discovery_branch_element (session,
+            &session->priv->discovery_tee,
+            gst_element_factory_make ("tee", tmp), "tee", error))
+    {
+      g_free (tmp);
+      goto error;
+    }
+    g_free (tmp);
+
+    pad = gst_element_get_static_pad (session->priv->discovery_tee, "sink");
+    if (GST_PAD_LINK_FAILED (gst_pad_link (
+                session->priv->send_tee_discovery_pad, pad)))
+    {
+      g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+          "Could not link the send tee and the discovery tee");
+      gst_object_unref (pad);
+      goto error;
+    }
+    gst_object_unref (pad);
+  }
+
+  for (item = branches; item; item = g_list_next (item))
+    if (!fs_rtp_session_link_discovery_branch (session, item->data, error))
+      goto error;
+
+  FS_RTP_SESSION_LOCK (session);
+  session->priv->discovery_branches = branches;
+  FS_RTP_SESSION_UNLOCK (session);
+
+  return TRUE;
+
+ error:
+
+  /* The tee and the previous branches are removed when stopping */
+  for (item = branches; item; item = g_list_next (item))
+    discovery_branch_destroy (session, item->data);
+  g_list_free (branches);
+
+  return FALSE;
 }
 
 /**
@@ -4025,6 +5680,9 @@ fs_rtp_session_get_codec_params_unlock (FsRtpSession *session,
   /* Invalidate CA because we've just unlocked */
   ca = NULL;
 
+  /* In case parallel discovery was used until now */
+  fs_rtp_session_remove_discovery_branches (session, TRUE);
+
   if (session->priv->discovery_codecbin)
   {
     gst_element_set_locked_state (session->priv->discovery_codecbin, TRUE);
@@ -4184,32 +5842,7 @@ fs_rtp_session_get_codec_params_unlock (FsRtpSession *session,
   if (codecbin)
     gst_object_unref (codecbin);
 
-  if (session->priv->discovery_fakesink)
-  {
-    gst_element_set_locked_state (session->priv->discovery_fakesink, TRUE);
-    gst_element_set_state (session->priv->discovery_fakesink, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (session->priv->conference),
-        session->priv->discovery_fakesink);
-    session->priv->discovery_fakesink = NULL;
-  }
-
-  if (session->priv->discovery_capsfilter)
-  {
-    gst_element_set_locked_state (session->priv->discovery_capsfilter, TRUE);
-    gst_element_set_state (session->priv->discovery_capsfilter, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (session->priv->conference),
-        session->priv->discovery_capsfilter);
-    session->priv->discovery_capsfilter = NULL;
-  }
-
-  if (session->priv->discovery_codecbin)
-  {
-    gst_element_set_locked_state (session->priv->discovery_codecbin, TRUE);
-    gst_element_set_state (session->priv->discovery_codecbin, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (session->priv->conference),
-        session->priv->discovery_codecbin);
-    session->priv->discovery_codecbin = NULL;
-  }
+  fs_rtp_session_remove_discovery_elements (session);
 
   return FALSE;
 }
@@ -4217,7 +5850,8 @@ fs_rtp_session_get_codec_params_unlock (FsRtpSession *session,
 /**
  * _discovery_pad_blocked_callback:
  *
- * This is the callback to change the discovery codecbin
+ * This is the callback to change the discovery codecbin, or the branches
+ * of the parallel discovery
  */
 
 static void
@@ -4252,6 +5886,8 @@ _discovery_pad_blocked_callback (GstPad *pad, gboolean blocked,
   {
     fs_rtp_session_stop_codec_param_gathering_unlock (session);
 
+    save_codec_config_cache_async (session->priv->media_type);
+
     g_object_notify (G_OBJECT (session), "codecs-ready");
     gst_element_post_message (GST_ELEMENT (session->priv->conference),
         gst_message_new_element (GST_OBJECT (session->priv->conference),
@@ -4262,6 +5898,20 @@ _discovery_pad_blocked_callback (GstPad *pad, gboolean blocked,
     goto out_unlocked;
   }
 
+  if (session->priv->parallel_discovery)
+  {
+    if (!fs_rtp_session_start_parallel_discovery_unlock (session, &error))
+    {
+      FS_RTP_SESSION_LOCK (session);
+      fs_rtp_session_stop_codec_param_gathering_unlock (session);
+      fs_session_emit_error (FS_SESSION (session), error->code,
+          "Error while discovering codec data, discovery cancelled",
+          error->message);
+    }
+    g_clear_error (&error);
+    goto out_unlocked;
+  }
+
   if (fs_codec_are_equal (ca->codec, session->priv->discovery_codec))
     goto out_locked;
 
@@ -4341,32 +5991,8 @@ fs_rtp_session_stop_codec_param_gathering_unlock (FsRtpSession *session)
 
   FS_RTP_SESSION_UNLOCK (session);
 
-  if (session->priv->discovery_fakesink)
-  {
-    gst_element_set_locked_state (session->priv->discovery_fakesink, TRUE);
-    gst_element_set_state (session->priv->discovery_fakesink, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (session->priv->conference),
-        session->priv->discovery_fakesink);
-    session->priv->discovery_fakesink = NULL;
-  }
-
-  if (session->priv->discovery_capsfilter)
-  {
-    gst_element_set_locked_state (session->priv->discovery_capsfilter, TRUE);
-    gst_element_set_state (session->priv->discovery_capsfilter, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (session->priv->conference),
-        session->priv->discovery_capsfilter);
-    session->priv->discovery_capsfilter = NULL;
-  }
-
-  if (session->priv->discovery_codecbin)
-  {
-    gst_element_set_locked_state (session->priv->discovery_codecbin, TRUE);
-    gst_element_set_state (session->priv->discovery_codecbin, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (session->priv->conference),
-        session->priv->discovery_codecbin);
-    session->priv->discovery_codecbin = NULL;
-  }
+  fs_rtp_session_remove_discovery_elements (session);
+  fs_rtp_session_remove_discovery_branches (session, TRUE);
 }
 
 static gchar **
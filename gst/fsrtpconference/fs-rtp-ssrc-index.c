@@ -0,0 +1,288 @@
+/*
+ * Farsight2 - Farsight RTP SSRC index
+ *
+ * Copyright 2007 Collabora Ltd.
+ *  @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ * Copyright 2007 Nokia Corp.
+ *
+ * fs-rtp-ssrc-index.c - A read-mostly set of known SSRCs
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * This is an open-addressing hash set of SSRCs protected by a sequence
+ * counter. Writers are serialized by the caller (the session mutex) and bump
+ * the counter before and after every modification, readers never block,
+ * they just retry if the counter moved while they were probing.
+ *
+ * When the table grows, the old one is kept around until the index is freed
+ * because a reader may still be probing it. Since it only ever doubles, the
+ * retired tables never take more memory than the current one.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fs-rtp-ssrc-index.h"
+
+#include <string.h>
+
+#define INITIAL_SIZE (16)
+
+enum {
+  SLOT_EMPTY = 0,
+  SLOT_USED,
+  SLOT_DELETED
+};
+
+typedef struct {
+  guint32 ssrc;
+  guint state;
+} SsrcSlot;
+
+typedef struct {
+  guint size; /* Always a power of 2 */
+  SsrcSlot *slots;
+} SsrcTable;
+
+struct _FsRtpSsrcIndex {
+  volatile gint seq;
+  volatile gpointer table;
+
+  /* Only touched by writers */
+  guint count;   /* used slots */
+  guint filled;  /* used + deleted slots */
+  GList *retired_tables;
+};
+
+static SsrcTable *
+ssrc_table_new (guint size)
+{
+  SsrcTable *table = g_slice_new (SsrcTable);
+
+  table->size = size;
+  table->slots = g_new0 (SsrcSlot, size);
+
+  return table;
+}
+
+static void
+ssrc_table_free (SsrcTable *table)
+{
+  g_free (table->slots);
+  g_slice_free (SsrcTable, table);
+}
+
+static inline guint
+ssrc_hash (guint32 ssrc)
+{
+  /* Knuth's multiplicative hash, SSRCs are random but may be chosen
+   * badly by some implementations */
+  return ssrc * 2654435761U;
+}
+
+/*
+ * Returns the slot containing @ssrc or %NULL, the number of probes
+ * is bounded by the size of the table so that a reader seeing a half
+ * written table can never loop forever.
+ */
+static SsrcSlot *
+ssrc_table_lookup (SsrcTable *table, guint32 ssrc)
+{
+  guint mask = table->size - 1;
+  guint i = ssrc_hash (ssrc) & mask;
+  guint n;
+
+  for (n = 0; n < table->size; n++)
+  {
+    SsrcSlot *slot = &table->slots[i];
+
+    if (slot->state == SLOT_EMPTY)
+      return NULL;
+    if (slot->state == SLOT_USED && slot->ssrc == ssrc)
+      return slot;
+
+    i = (i + 1) & mask;
+  }
+
+  return NULL;
+}
+
+static SsrcSlot *
+ssrc_table_find_free (SsrcTable *table, guint32 ssrc)
+{
+  guint mask = table->size - 1;
+  guint i = ssrc_hash (ssrc) & mask;
+
+  while (table->slots[i].state == SLOT_USED)
+    i = (i + 1) & mask;
+
+  return &table->slots[i];
+}
+
+FsRtpSsrcIndex *
+fs_rtp_ssrc_index_new (void)
+{
+  FsRtpSsrcIndex *index = g_slice_new0 (FsRtpSsrcIndex);
+
+  index->table = ssrc_table_new (INITIAL_SIZE);
+
+  return index;
+}
+
+void
+fs_rtp_ssrc_index_free (FsRtpSsrcIndex *index)
+{
+  g_list_foreach (index->retired_tables, (GFunc) ssrc_table_free, NULL);
+  g_list_free (index->retired_tables);
+  ssrc_table_free (index->table);
+  g_slice_free (FsRtpSsrcIndex, index);
+}
+
+gboolean
+fs_rtp_ssrc_index_contains (FsRtpSsrcIndex *index, guint32 ssrc)
+{
+  for (;;)
+  {
+    gint seq = g_atomic_int_get (&index->seq);
+    SsrcTable *table;
+    gboolean found;
+
+    /* A writer is in progress */
+    if (seq & 1)
+      continue;
+
+    table = g_atomic_pointer_get (&index->table);
+    found = (ssrc_table_lookup (table, ssrc) != NULL);
+
+    if (g_atomic_int_get (&index->seq) == seq)
+      return found;
+  }
+}
+
+static inline void
+write_begin (FsRtpSsrcIndex *index)
+{
+  g_atomic_int_inc (&index->seq);
+}
+
+static inline void
+write_end (FsRtpSsrcIndex *index)
+{
+  g_atomic_int_inc (&index->seq);
+}
+
+static void
+fs_rtp_ssrc_index_rehash (FsRtpSsrcIndex *index)
+{
+  SsrcTable *old_table = index->table;
+  SsrcTable *table;
+  guint size = old_table->size;
+  guint i;
+
+  /* Only grow if we are really full, otherwise we're just cleaning up the
+   * deleted slots */
+  if (index->count * 2 >= size)
+    size *= 2;
+
+  table = ssrc_table_new (size);
+
+  for (i = 0; i < old_table->size; i++)
+  {
+    if (old_table->slots[i].state == SLOT_USED)
+    {
+      SsrcSlot *slot = ssrc_table_find_free (table,
+          old_table->slots[i].ssrc);
+      slot->ssrc = old_table->slots[i].ssrc;
+      slot->state = SLOT_USED;
+    }
+  }
+
+  if (size == old_table->size)
+  {
+    /* Same size, copy it back in place so we don't have to retire anything */
+    write_begin (index);
+    memcpy (old_table->slots, table->slots, sizeof (SsrcSlot) * size);
+    write_end (index);
+    ssrc_table_free (table);
+  }
+  else
+  {
+    write_begin (index);
+    g_atomic_pointer_set (&index->table, table);
+    write_end (index);
+    index->retired_tables = g_list_prepend (index->retired_tables, old_table);
+  }
+
+  index->filled = index->count;
+}
+
+void
+fs_rtp_ssrc_index_insert (FsRtpSsrcIndex *index, guint32 ssrc)
+{
+  SsrcTable *table = index->table;
+  SsrcSlot *slot;
+
+  if (ssrc_table_lookup (table, ssrc))
+    return;
+
+  /* Keep the load (including deleted slots) under 3/4 */
+  if ((index->filled + 1) * 4 > table->size * 3)
+  {
+    fs_rtp_ssrc_index_rehash (index);
+    table = index->table;
+  }
+
+  slot = ssrc_table_find_free (table, ssrc);
+
+  write_begin (index);
+  if (slot->state == SLOT_EMPTY)
+    index->filled++;
+  slot->ssrc = ssrc;
+  slot->state = SLOT_USED;
+  write_end (index);
+
+  index->count++;
+}
+
+void
+fs_rtp_ssrc_index_remove (FsRtpSsrcIndex *index, guint32 ssrc)
+{
+  SsrcSlot *slot = ssrc_table_lookup (index->table, ssrc);
+
+  if (!slot)
+    return;
+
+  write_begin (index);
+  slot->state = SLOT_DELETED;
+  write_end (index);
+
+  index->count--;
+}
+
+void
+fs_rtp_ssrc_index_clear (FsRtpSsrcIndex *index)
+{
+  SsrcTable *table = index->table;
+
+  write_begin (index);
+  memset (table->slots, 0, sizeof (SsrcSlot) * table->size);
+  write_end (index);
+
+  index->count = 0;
+  index->filled = 0;
+}
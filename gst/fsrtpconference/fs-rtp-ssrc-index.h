@@ -0,0 +1,48 @@
+/*
+ * Farsight2 - Farsight RTP SSRC index
+ *
+ * Copyright 2007 Collabora Ltd.
+ *  @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ * Copyright 2007 Nokia Corp.
+ *
+ * fs-rtp-ssrc-index.h - A read-mostly set of known SSRCs
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#ifndef __FS_RTP_SSRC_INDEX_H__
+#define __FS_RTP_SSRC_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _FsRtpSsrcIndex FsRtpSsrcIndex;
+
+FsRtpSsrcIndex *fs_rtp_ssrc_index_new (void);
+void fs_rtp_ssrc_index_free (FsRtpSsrcIndex *index);
+
+/* Can be called from any thread without holding any lock */
+gboolean fs_rtp_ssrc_index_contains (FsRtpSsrcIndex *index, guint32 ssrc);
+
+/* These must be called with the lock that serializes writers held */
+void fs_rtp_ssrc_index_insert (FsRtpSsrcIndex *index, guint32 ssrc);
+void fs_rtp_ssrc_index_remove (FsRtpSsrcIndex *index, guint32 ssrc);
+void fs_rtp_ssrc_index_clear (FsRtpSsrcIndex *index);
+
+G_END_DECLS
+
+#endif /* __FS_RTP_SSRC_INDEX_H__ */
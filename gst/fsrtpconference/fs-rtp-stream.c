@@ -39,6 +39,7 @@
 
 #include <gst/gst.h>
 
+#include "fs-rtp-codec-negotiation.h"
 #include "fs-rtp-marshal.h"
 
 /* Signals */
@@ -86,6 +87,11 @@ struct _FsRtpStreamPrivate
   gulong known_source_packet_received_handler_id;
   gulong state_changed_handler_id;
 
+  /* Fingerprints of the remote-codecs and negotiated-codecs lists, 0 if not
+   * computed yet, protected by the session lock */
+  guint64 remote_codecs_fingerprint;
+  guint64 negotiated_codecs_fingerprint;
+
   GMutex *mutex;
 };
 
@@ -675,14 +681,19 @@ fs_rtp_stream_set_remote_codecs (FsStream *stream,
           self->priv->user_data_for_cb))
   {
     gboolean is_new = TRUE;
+    guint64 fingerprint = codec_list_fingerprint (remote_codecs_copy);
 
     FS_RTP_SESSION_LOCK (session);
     if (self->remote_codecs)
     {
-      is_new = !fs_codec_list_are_equal (self->remote_codecs, remote_codecs);
+      if (!self->priv->remote_codecs_fingerprint)
+        self->priv->remote_codecs_fingerprint =
+          codec_list_fingerprint (self->remote_codecs);
+      is_new = (fingerprint != self->priv->remote_codecs_fingerprint);
       fs_codec_list_destroy (self->remote_codecs);
     }
     self->remote_codecs = remote_codecs_copy;
+    self->priv->remote_codecs_fingerprint = fingerprint;
     FS_RTP_SESSION_UNLOCK (session);
 
     if (is_new)
@@ -1092,11 +1103,18 @@ fs_rtp_stream_set_negotiated_codecs_unlock (FsRtpStream *stream,
     GList *codecs)
 {
   FsRtpSession *session = fs_rtp_stream_get_session (stream, NULL);
+  guint64 fingerprint;
 
   if (!session)
     return;
 
-  if (fs_codec_list_are_equal (stream->negotiated_codecs, codecs))
+  fingerprint = codec_list_fingerprint (codecs);
+
+  if (!stream->priv->negotiated_codecs_fingerprint)
+    stream->priv->negotiated_codecs_fingerprint =
+      codec_list_fingerprint (stream->negotiated_codecs);
+
+  if (fingerprint == stream->priv->negotiated_codecs_fingerprint)
   {
     fs_codec_list_destroy (codecs);
     FS_RTP_SESSION_UNLOCK (session);
@@ -1107,6 +1125,7 @@ fs_rtp_stream_set_negotiated_codecs_unlock (FsRtpStream *stream,
     fs_codec_list_destroy (stream->negotiated_codecs);
 
   stream->negotiated_codecs = codecs;
+  stream->priv->negotiated_codecs_fingerprint = fingerprint;
 
   FS_RTP_SESSION_UNLOCK (session);
 
@@ -120,9 +120,9 @@ struct _FsRtpSubStreamPrivate {
 
   /* Protected by the this mutex */
   GMutex *mutex;
-  GstClockID no_rtcp_timeout_id;
   GstClockTime next_no_rtcp_timeout;
-  GThread *no_rtcp_timeout_thread;
+  /* Lives on the conference's timer wheel */
+  FsRtpTimer *no_rtcp_timer;
 
   /* Can only be used while using the lock */
   GStaticRWLock stopped_lock;
@@ -425,85 +425,47 @@ fs_rtp_sub_stream_init (FsRtpSubStream *self)
 }
 
 
-static gpointer
+static void
 no_rtcp_timeout_func (gpointer user_data)
 {
   FsRtpSubStream *self = FS_RTP_SUB_STREAM (user_data);
-  GstClock *sysclock = NULL;
-  GstClockID id;
   gboolean emit = TRUE;
 
-  sysclock = gst_system_clock_obtain ();
-  if (sysclock == NULL)
-    goto no_sysclock;
-
-  FS_RTP_SUB_STREAM_LOCK(self);
-  id = self->priv->no_rtcp_timeout_id = gst_clock_new_single_shot_id (sysclock,
-      self->priv->next_no_rtcp_timeout);
-
-  FS_RTP_SUB_STREAM_UNLOCK(self);
-  gst_clock_id_wait (id, NULL);
   FS_RTP_SUB_STREAM_LOCK(self);
-
-  gst_clock_id_unref (id);
-  self->priv->no_rtcp_timeout_id = NULL;
-
   if (self->priv->next_no_rtcp_timeout == 0)
     emit = FALSE;
-
   FS_RTP_SUB_STREAM_UNLOCK(self);
 
-  gst_object_unref (sysclock);
-
   if (emit)
     g_signal_emit (self, signals[NO_RTCP_TIMEDOUT], 0);
-
-  return NULL;
-
- no_sysclock:
-  {
-    fs_rtp_sub_stream_emit_error (self, FS_ERROR_INTERNAL,
-        "Could not get system clock",
-        "Could not get system clock");
-    return NULL;
-  }
 }
 
 static gboolean
-fs_rtp_sub_stream_start_no_rtcp_timeout_thread (FsRtpSubStream *self,
+fs_rtp_sub_stream_start_no_rtcp_timeout (FsRtpSubStream *self,
     GError **error)
 {
+  FsRtpTimerWheel *wheel =
+    fs_rtp_conference_get_timer_wheel (self->priv->conference);
   gboolean res = TRUE;
-  GstClock *sysclock = NULL;
-
-  sysclock = gst_system_clock_obtain ();
-  if (sysclock == NULL)
-  {
-    g_set_error (error, FS_ERROR, FS_ERROR_INTERNAL,
-        "Could not obtain gst system clock");
-    return FALSE;
-  }
 
   FS_RTP_SESSION_LOCK (self->priv->session);
   FS_RTP_SUB_STREAM_LOCK(self);
 
-  self->priv->next_no_rtcp_timeout = gst_clock_get_time (sysclock) +
+  self->priv->next_no_rtcp_timeout = fs_rtp_timer_wheel_get_time (wheel) +
     (self->no_rtcp_timeout * GST_MSECOND);
 
-  gst_object_unref (sysclock);
-
-  if (self->priv->no_rtcp_timeout_thread == NULL) {
-    /* only create a new thread if the old one was stopped. Otherwise we can
-     * just reuse the currently running one. */
-    self->priv->no_rtcp_timeout_thread =
-      g_thread_create (no_rtcp_timeout_func, self, TRUE, error);
+  if (self->priv->no_rtcp_timer == NULL)
+  {
+    self->priv->no_rtcp_timer = fs_rtp_timer_wheel_add (wheel,
+        self->priv->next_no_rtcp_timeout, no_rtcp_timeout_func, self, error);
+    res = (self->priv->no_rtcp_timer != NULL);
+  }
+  else
+  {
+    /* Just move the deadline of the existing timer */
+    fs_rtp_timer_wheel_reschedule (wheel, self->priv->no_rtcp_timer,
+        self->priv->next_no_rtcp_timeout);
   }
-
-  res = (self->priv->no_rtcp_timeout_thread != NULL);
-
-  if (res == FALSE && error && *error == NULL)
-    g_set_error (error, FS_ERROR, FS_ERROR_INTERNAL, "Unknown error creating"
-        " thread");
 
   FS_RTP_SUB_STREAM_UNLOCK(self);
   FS_RTP_SESSION_UNLOCK (self->priv->session);
@@ -512,28 +474,20 @@ fs_rtp_sub_stream_start_no_rtcp_timeout_thread (FsRtpSubStream *self,
 }
 
 static void
-fs_rtp_sub_stream_stop_no_rtcp_timeout_thread (FsRtpSubStream *self)
+fs_rtp_sub_stream_stop_no_rtcp_timeout (FsRtpSubStream *self)
 {
-  FS_RTP_SUB_STREAM_LOCK(self);
-  self->priv->next_no_rtcp_timeout = 0;
-  if (self->priv->no_rtcp_timeout_id)
-    gst_clock_id_unschedule (self->priv->no_rtcp_timeout_id);
-
-  if (self->priv->no_rtcp_timeout_thread == NULL)
-  {
-    FS_RTP_SUB_STREAM_UNLOCK(self);
-    return;
-  }
-  else
-  {
-    FS_RTP_SUB_STREAM_UNLOCK(self);
-  }
-
-  g_thread_join (self->priv->no_rtcp_timeout_thread);
+  FsRtpTimer *timer;
 
   FS_RTP_SUB_STREAM_LOCK(self);
-  self->priv->no_rtcp_timeout_thread = NULL;
+  self->priv->next_no_rtcp_timeout = 0;
+  timer = self->priv->no_rtcp_timer;
+  self->priv->no_rtcp_timer = NULL;
   FS_RTP_SUB_STREAM_UNLOCK(self);
+
+  /* This waits for the callback if it is running */
+  if (timer)
+    fs_rtp_timer_wheel_remove (
+        fs_rtp_conference_get_timer_wheel (self->priv->conference), timer);
 }
 
 static void
@@ -691,7 +645,7 @@ fs_rtp_sub_stream_constructed (GObject *object)
   }
 
   if (self->no_rtcp_timeout > 0)
-    if (!fs_rtp_sub_stream_start_no_rtcp_timeout_thread (self,
+    if (!fs_rtp_sub_stream_start_no_rtcp_timeout (self,
             &self->priv->construction_error))
       return;
 
@@ -706,7 +660,7 @@ fs_rtp_sub_stream_dispose (GObject *object)
 
   fs_rtp_sub_stream_stop (self);
 
-  fs_rtp_sub_stream_stop_no_rtcp_timeout_thread (self);
+  fs_rtp_sub_stream_stop_no_rtcp_timeout (self);
 
   if (self->priv->output_ghostpad) {
     gst_element_remove_pad (GST_ELEMENT (self->priv->conference),
@@ -883,7 +837,8 @@ fs_rtp_sub_stream_get_property (GObject *object,
  * Add and links the rtpbin for a given substream.
  * Removes any codecbin that was previously there.
  *
- * This function will swallow one ref to the codecbin and the codec.
+ * This function will swallow one ref to the codecbin and the codec. The ref
+ * to the codecbin can be floating (a new bin) or not (a bin that was reused).
  *
  * Returns: TRUE on success
  */
@@ -899,6 +854,14 @@ fs_rtp_sub_stream_set_codecbin (FsRtpSubStream *substream,
   gboolean ret = FALSE;
   GstPad *pad;
 
+  /* Make the floating ref of a new bin a normal one, so that we own exactly
+   * one ref in both cases */
+  if (GST_OBJECT_IS_FLOATING (codecbin))
+  {
+    gst_object_ref (codecbin);
+    gst_object_sink (codecbin);
+  }
+
   if (substream->priv->codecbin)
   {
     gst_element_set_locked_state (substream->priv->codecbin, TRUE);
@@ -942,6 +905,9 @@ fs_rtp_sub_stream_set_codecbin (FsRtpSubStream *substream,
     return FALSE;
   }
 
+  /* The conference holds its own ref now */
+  gst_object_unref (codecbin);
+
   if (gst_element_set_state (codecbin, GST_STATE_PLAYING) ==
       GST_STATE_CHANGE_FAILURE)
   {
@@ -1065,6 +1031,46 @@ do_nothing_blocked_callback (GstPad *pad, gboolean blocked, gpointer user_data)
 {
 }
 
+/*
+ * Hands the codec bin over to the session so that another substream
+ * with the same codec can reuse it.
+ *
+ * Returns: %TRUE if the session took it
+ */
+
+static gboolean
+fs_rtp_sub_stream_recycle_codecbin (FsRtpSubStream *substream)
+{
+  GstElement *codecbin;
+  FsCodec *codec = NULL;
+  gboolean recycled;
+
+  FS_RTP_SESSION_LOCK (substream->priv->session);
+  codecbin = substream->priv->codecbin;
+  if (substream->codec)
+    codec = fs_codec_copy (substream->codec);
+  FS_RTP_SESSION_UNLOCK (substream->priv->session);
+
+  if (!codecbin || !codec)
+  {
+    fs_codec_destroy (codec);
+    return FALSE;
+  }
+
+  recycled = fs_rtp_session_recycle_recv_codec_bin (substream->priv->session,
+      codec, codecbin);
+  fs_codec_destroy (codec);
+
+  if (recycled)
+  {
+    FS_RTP_SESSION_LOCK (substream->priv->session);
+    substream->priv->codecbin = NULL;
+    FS_RTP_SESSION_UNLOCK (substream->priv->session);
+  }
+
+  return recycled;
+}
+
 
 /**
  * fs_rtp_sub_stream_stop:
@@ -1101,7 +1107,8 @@ fs_rtp_sub_stream_stop (FsRtpSubStream *substream)
   if (substream->priv->codecbin)
   {
     gst_element_set_locked_state (substream->priv->codecbin, TRUE);
-    gst_element_set_state (substream->priv->codecbin, GST_STATE_NULL);
+    if (!fs_rtp_sub_stream_recycle_codecbin (substream))
+      gst_element_set_state (substream->priv->codecbin, GST_STATE_NULL);
   }
 
   if (substream->priv->capsfilter)
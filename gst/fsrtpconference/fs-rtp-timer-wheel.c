@@ -0,0 +1,427 @@
+/*
+ * Farsight2 - Farsight RTP Timer Wheel
+ *
+ * Copyright 2007 Collabora Ltd.
+ *  @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ * Copyright 2007 Nokia Corp.
+ *
+ * fs-rtp-timer-wheel.c - A timer wheel shared by a whole conference
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * This is a hashed timer wheel: timers are put in the slot of the tick
+ * at which they expire, modulo the number of slots. A single thread wakes
+ * up on every tick of the system clock (but only while there are timers
+ * armed) and fires the timers of the slot whose time has come, timers that
+ * are more than one revolution away just stay in the slot.
+ *
+ * The callbacks of the expired timers are not called from the thread of
+ * the wheel, they are pushed to a small thread pool, so that a callback
+ * that blocks (for example on the lock of a session) does not delay the
+ * other timers of the conference.
+ *
+ * Adding, rescheduling and removing a timer are all O(1).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fs-rtp-timer-wheel.h"
+
+#include <gst/farsight/fs-conference-iface.h>
+
+#include "fs-rtp-conference.h"
+
+#define GST_CAT_DEFAULT fsrtpconference_debug
+
+#define WHEEL_SLOTS (256)
+#define WHEEL_TICK (50 * GST_MSECOND)
+#define WHEEL_MAX_DISPATCH_THREADS (4)
+
+struct _FsRtpTimer {
+  /* All protected by the wheel mutex */
+  GList *link; /* Non-NULL if the timer is armed */
+  guint64 expires_tick;
+  gboolean removed;
+  /* Pushed to the thread pool, stays set until the callback has returned */
+  gboolean queued;
+  /* Expired again while queued, to be pushed again once the callback
+   * has returned */
+  gboolean expired_again;
+  /* The thread in which the callback is currently running, if any */
+  GThread *running_thread;
+
+  FsRtpTimerFunc func;
+  gpointer user_data;
+};
+
+struct _FsRtpTimerWheel {
+  GstClock *clock;
+
+  GMutex *mutex;
+  GCond *cond;
+
+  GThread *thread;
+  gboolean stop;
+
+  GThreadPool *pool;
+
+  GstClockID clock_id;
+
+  GQueue slots[WHEEL_SLOTS];
+  guint64 current_tick;
+  guint count;
+};
+
+FsRtpTimerWheel *
+fs_rtp_timer_wheel_new (void)
+{
+  FsRtpTimerWheel *wheel = g_slice_new0 (FsRtpTimerWheel);
+  guint i;
+
+  wheel->clock = gst_system_clock_obtain ();
+  wheel->mutex = g_mutex_new ();
+  wheel->cond = g_cond_new ();
+
+  for (i = 0; i < WHEEL_SLOTS; i++)
+    g_queue_init (&wheel->slots[i]);
+
+  wheel->current_tick = gst_clock_get_time (wheel->clock) / WHEEL_TICK;
+
+  return wheel;
+}
+
+void
+fs_rtp_timer_wheel_free (FsRtpTimerWheel *wheel)
+{
+  guint i;
+
+  g_mutex_lock (wheel->mutex);
+  wheel->stop = TRUE;
+  if (wheel->clock_id)
+    gst_clock_id_unschedule (wheel->clock_id);
+  g_cond_broadcast (wheel->cond);
+  g_mutex_unlock (wheel->mutex);
+
+  if (wheel->thread)
+    g_thread_join (wheel->thread);
+
+  /* Lets the callbacks already dispatched run (or free themselves if
+   * their timer has been removed) */
+  if (wheel->pool)
+    g_thread_pool_free (wheel->pool, FALSE, TRUE);
+
+  for (i = 0; i < WHEEL_SLOTS; i++)
+  {
+    if (!g_queue_is_empty (&wheel->slots[i]))
+      GST_WARNING ("Freeing timer wheel with timers still armed");
+    while (!g_queue_is_empty (&wheel->slots[i]))
+      g_slice_free (FsRtpTimer, g_queue_pop_head (&wheel->slots[i]));
+  }
+
+  gst_object_unref (wheel->clock);
+  g_cond_free (wheel->cond);
+  g_mutex_free (wheel->mutex);
+  g_slice_free (FsRtpTimerWheel, wheel);
+}
+
+GstClockTime
+fs_rtp_timer_wheel_get_time (FsRtpTimerWheel *wheel)
+{
+  return gst_clock_get_time (wheel->clock);
+}
+
+static void
+fs_rtp_timer_wheel_arm_locked (FsRtpTimerWheel *wheel, FsRtpTimer *timer,
+    GstClockTime deadline)
+{
+  GQueue *slot;
+
+  /* Round up, a timer must never fire early */
+  timer->expires_tick = (deadline + WHEEL_TICK - 1) / WHEEL_TICK;
+
+  /* If the wheel was idle, the current tick is stale */
+  if (wheel->count == 0)
+    wheel->current_tick = gst_clock_get_time (wheel->clock) / WHEEL_TICK;
+
+  if (timer->expires_tick <= wheel->current_tick)
+    timer->expires_tick = wheel->current_tick + 1;
+
+  slot = &wheel->slots[timer->expires_tick % WHEEL_SLOTS];
+  g_queue_push_tail (slot, timer);
+  timer->link = g_queue_peek_tail_link (slot);
+
+  if (wheel->count++ == 0)
+    g_cond_broadcast (wheel->cond);
+}
+
+static void
+fs_rtp_timer_wheel_disarm_locked (FsRtpTimerWheel *wheel, FsRtpTimer *timer)
+{
+  if (!timer->link)
+    return;
+
+  g_queue_delete_link (&wheel->slots[timer->expires_tick % WHEEL_SLOTS],
+      timer->link);
+  timer->link = NULL;
+  wheel->count--;
+}
+
+/* Returns the first timer that has expired in the current slot */
+static FsRtpTimer *
+fs_rtp_timer_wheel_pop_expired_locked (FsRtpTimerWheel *wheel)
+{
+  GQueue *slot = &wheel->slots[wheel->current_tick % WHEEL_SLOTS];
+  GList *item;
+
+  for (item = slot->head; item; item = g_list_next (item))
+  {
+    FsRtpTimer *timer = item->data;
+
+    if (timer->expires_tick <= wheel->current_tick)
+    {
+      fs_rtp_timer_wheel_disarm_locked (wheel, timer);
+      return timer;
+    }
+  }
+
+  return NULL;
+}
+
+static void
+fs_rtp_timer_wheel_dispatch (gpointer data, gpointer user_data)
+{
+  FsRtpTimer *timer = data;
+  FsRtpTimerWheel *wheel = user_data;
+
+  g_mutex_lock (wheel->mutex);
+
+  /* Was removed before its callback could be called */
+  if (timer->removed)
+  {
+    g_slice_free (FsRtpTimer, timer);
+    g_mutex_unlock (wheel->mutex);
+    return;
+  }
+
+  timer->running_thread = g_thread_self ();
+  g_mutex_unlock (wheel->mutex);
+  timer->func (timer->user_data);
+  g_mutex_lock (wheel->mutex);
+  timer->running_thread = NULL;
+
+  /* Was removed from inside its own callback */
+  if (timer->removed)
+  {
+    fs_rtp_timer_wheel_disarm_locked (wheel, timer);
+    g_slice_free (FsRtpTimer, timer);
+  }
+  else if (timer->expired_again && !wheel->stop)
+  {
+    /* Only pushed again now, so that the same callback never runs
+     * in two threads at once */
+    timer->expired_again = FALSE;
+    g_thread_pool_push (wheel->pool, timer, NULL);
+  }
+  else
+  {
+    timer->expired_again = FALSE;
+    timer->queued = FALSE;
+  }
+
+  g_cond_broadcast (wheel->cond);
+  g_mutex_unlock (wheel->mutex);
+}
+
+static gpointer
+fs_rtp_timer_wheel_thread (gpointer user_data)
+{
+  FsRtpTimerWheel *wheel = user_data;
+
+  g_mutex_lock (wheel->mutex);
+  while (!wheel->stop)
+  {
+    GstClockID id;
+    guint64 now_tick;
+
+    if (wheel->count == 0)
+    {
+      g_cond_wait (wheel->cond, wheel->mutex);
+      continue;
+    }
+
+    id = wheel->clock_id = gst_clock_new_single_shot_id (wheel->clock,
+        (wheel->current_tick + 1) * WHEEL_TICK);
+    g_mutex_unlock (wheel->mutex);
+    gst_clock_id_wait (id, NULL);
+    g_mutex_lock (wheel->mutex);
+    wheel->clock_id = NULL;
+    gst_clock_id_unref (id);
+
+    now_tick = gst_clock_get_time (wheel->clock) / WHEEL_TICK;
+
+    while (!wheel->stop && wheel->current_tick < now_tick)
+    {
+      FsRtpTimer *timer;
+
+      wheel->current_tick++;
+
+      while (!wheel->stop &&
+          (timer = fs_rtp_timer_wheel_pop_expired_locked (wheel)))
+      {
+        /* Its previous expiration has not been dispatched yet, or its
+         * callback is still running, it is pushed again when it returns */
+        if (timer->queued)
+        {
+          timer->expired_again = TRUE;
+          continue;
+        }
+
+        timer->queued = TRUE;
+        g_thread_pool_push (wheel->pool, timer, NULL);
+      }
+    }
+  }
+  g_mutex_unlock (wheel->mutex);
+
+  return NULL;
+}
+
+/**
+ * fs_rtp_timer_wheel_add:
+ * @wheel: a #FsRtpTimerWheel
+ * @deadline: the time of the system clock at which the timer should fire,
+ *  or %GST_CLOCK_TIME_NONE to create it disarmed
+ * @func: the function to call when the timer fires
+ * @user_data: the data to pass to @func
+ * @error: location of a #GError, or NULL if no error occured
+ *
+ * Creates a new timer, the thread of the wheel and its dispatch thread pool
+ * are only started when the first timer is added.
+ *
+ * Returns: a #FsRtpTimer to be removed with fs_rtp_timer_wheel_remove() or
+ * %NULL on error
+ */
+FsRtpTimer *
+fs_rtp_timer_wheel_add (FsRtpTimerWheel *wheel, GstClockTime deadline,
+    FsRtpTimerFunc func, gpointer user_data, GError **error)
+{
+  FsRtpTimer *timer;
+
+  g_mutex_lock (wheel->mutex);
+
+  if (!wheel->pool)
+  {
+    wheel->pool = g_thread_pool_new (fs_rtp_timer_wheel_dispatch, wheel,
+        WHEEL_MAX_DISPATCH_THREADS, FALSE, error);
+    if (!wheel->pool)
+    {
+      if (error && *error == NULL)
+        g_set_error (error, FS_ERROR, FS_ERROR_INTERNAL,
+            "Unknown error creating thread pool");
+      g_mutex_unlock (wheel->mutex);
+      return NULL;
+    }
+  }
+
+  if (!wheel->thread)
+  {
+    wheel->thread = g_thread_create (fs_rtp_timer_wheel_thread, wheel, TRUE,
+        error);
+    if (!wheel->thread)
+    {
+      if (error && *error == NULL)
+        g_set_error (error, FS_ERROR, FS_ERROR_INTERNAL,
+            "Unknown error creating thread");
+      g_mutex_unlock (wheel->mutex);
+      return NULL;
+    }
+  }
+
+  timer = g_slice_new0 (FsRtpTimer);
+  timer->func = func;
+  timer->user_data = user_data;
+
+  if (GST_CLOCK_TIME_IS_VALID (deadline))
+    fs_rtp_timer_wheel_arm_locked (wheel, timer, deadline);
+
+  g_mutex_unlock (wheel->mutex);
+
+  return timer;
+}
+
+/**
+ * fs_rtp_timer_wheel_reschedule:
+ * @wheel: a #FsRtpTimerWheel
+ * @timer: a #FsRtpTimer from this wheel
+ * @deadline: the new time of the system clock at which the timer should fire
+ *  or %GST_CLOCK_TIME_NONE to disarm it
+ *
+ * Moves the deadline of an armed or already fired timer.
+ */
+void
+fs_rtp_timer_wheel_reschedule (FsRtpTimerWheel *wheel, FsRtpTimer *timer,
+    GstClockTime deadline)
+{
+  g_mutex_lock (wheel->mutex);
+  fs_rtp_timer_wheel_disarm_locked (wheel, timer);
+  if (GST_CLOCK_TIME_IS_VALID (deadline) && !timer->removed)
+    fs_rtp_timer_wheel_arm_locked (wheel, timer, deadline);
+  g_mutex_unlock (wheel->mutex);
+}
+
+/**
+ * fs_rtp_timer_wheel_remove:
+ * @wheel: a #FsRtpTimerWheel
+ * @timer: a #FsRtpTimer from this wheel
+ *
+ * Disarms and frees the timer. If its callback is currently running in
+ * another thread, this waits for it to return, so that the user_data can
+ * be safely freed afterwards. If its callback has been dispatched but has
+ * not started yet, it will never be called.
+ */
+void
+fs_rtp_timer_wheel_remove (FsRtpTimerWheel *wheel, FsRtpTimer *timer)
+{
+  g_mutex_lock (wheel->mutex);
+
+  fs_rtp_timer_wheel_disarm_locked (wheel, timer);
+
+  if (timer->running_thread == g_thread_self ())
+  {
+    /* The dispatch thread will free it when the callback returns */
+    timer->removed = TRUE;
+    g_mutex_unlock (wheel->mutex);
+    return;
+  }
+
+  /* A timer is only ever pushed to the pool once at a time, so this is
+   * the only run that can be in progress */
+  while (timer->running_thread)
+    g_cond_wait (wheel->cond, wheel->mutex);
+
+  if (timer->queued)
+    /* Pushed to the pool but not started, possibly again by the run that
+     * just returned, the dispatch thread will free it instead of calling
+     * the callback */
+    timer->removed = TRUE;
+  else
+    g_slice_free (FsRtpTimer, timer);
+
+  g_mutex_unlock (wheel->mutex);
+}
@@ -0,0 +1,68 @@
+/*
+ * Farsight2 - Farsight RTP Timer Wheel
+ *
+ * Copyright 2007 Collabora Ltd.
+ *  @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ * Copyright 2007 Nokia Corp.
+ *
+ * fs-rtp-timer-wheel.h - A timer wheel shared by a whole conference
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+
+#ifndef __FS_RTP_TIMER_WHEEL_H__
+#define __FS_RTP_TIMER_WHEEL_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _FsRtpTimerWheel FsRtpTimerWheel;
+typedef struct _FsRtpTimer FsRtpTimer;
+
+/**
+ * FsRtpTimerFunc:
+ * @user_data: the data passed to fs_rtp_timer_wheel_add()
+ *
+ * Called from a thread of the dispatch pool of the timer wheel when a timer
+ * expires, so the callbacks of different timers may run concurrently, but
+ * those of the same timer never do. The callback may block, take locks and
+ * remove its own timer. The timer is not freed, it must still be removed
+ * with fs_rtp_timer_wheel_remove(), it can also be re-armed with
+ * fs_rtp_timer_wheel_reschedule().
+ */
+typedef void (*FsRtpTimerFunc) (gpointer user_data);
+
+FsRtpTimerWheel *fs_rtp_timer_wheel_new (void);
+void fs_rtp_timer_wheel_free (FsRtpTimerWheel *wheel);
+
+GstClockTime fs_rtp_timer_wheel_get_time (FsRtpTimerWheel *wheel);
+
+FsRtpTimer *fs_rtp_timer_wheel_add (FsRtpTimerWheel *wheel,
+    GstClockTime deadline,
+    FsRtpTimerFunc func,
+    gpointer user_data,
+    GError **error);
+
+void fs_rtp_timer_wheel_reschedule (FsRtpTimerWheel *wheel,
+    FsRtpTimer *timer,
+    GstClockTime deadline);
+
+void fs_rtp_timer_wheel_remove (FsRtpTimerWheel *wheel, FsRtpTimer *timer);
+
+G_END_DECLS
+
+#endif /* __FS_RTP_TIMER_WHEEL_H__ */
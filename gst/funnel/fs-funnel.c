@@ -80,11 +80,16 @@ static void fs_funnel_release_pad (GstElement * element, GstPad * pad);
 static GstFlowReturn fs_funnel_buffer_alloc (GstPad * pad, guint64 offset,
     guint size, GstCaps * caps, GstBuffer ** buf);
 static GstFlowReturn fs_funnel_chain (GstPad * pad, GstBuffer * buffer);
+static GstFlowReturn fs_funnel_chain_list (GstPad * pad, GstBufferList * list);
 static gboolean fs_funnel_event (GstPad * pad, GstEvent * event);
 static gboolean fs_funnel_src_event (GstPad * pad, GstEvent * event);
 static GstCaps* fs_funnel_getcaps (GstPad * pad);
 
 
+/*
+ * The segment of each sink pad is protected by the object lock of that pad,
+ * so the streaming threads of different sink pads never contend.
+ */
 typedef struct {
   GstSegment segment;
 } FsFunnelPadPrivate;
@@ -174,6 +179,8 @@ fs_funnel_request_new_pad (GstElement * element, GstPadTemplate * templ,
   sinkpad = gst_pad_new_from_template (templ, name);
 
   gst_pad_set_chain_function (sinkpad, GST_DEBUG_FUNCPTR (fs_funnel_chain));
+  gst_pad_set_chain_list_function (sinkpad,
+      GST_DEBUG_FUNCPTR (fs_funnel_chain_list));
   gst_pad_set_event_function (sinkpad, GST_DEBUG_FUNCPTR (fs_funnel_event));
   gst_pad_set_getcaps_function (sinkpad, GST_DEBUG_FUNCPTR (fs_funnel_getcaps));
   gst_pad_set_bufferalloc_function (sinkpad,
@@ -220,65 +227,178 @@ fs_funnel_getcaps (GstPad * pad)
   return caps;
 }
 
-static GstFlowReturn
-fs_funnel_chain (GstPad * pad, GstBuffer * buffer)
+/*
+ * Makes sure the pad has a segment
+ *
+ * Must be called with the pad object lock held
+ */
+static void
+fs_funnel_check_segment_locked (FsFunnel *funnel, FsFunnelPadPrivate *priv)
 {
-  GstFlowReturn res;
-  FsFunnel *funnel = FS_FUNNEL (gst_pad_get_parent (pad));
-  FsFunnelPadPrivate *priv = gst_pad_get_element_private (pad);
-  GstEvent *event = NULL;
-  GstClockTime newts;
-  GstCaps *padcaps;
-
-  GST_DEBUG_OBJECT (funnel, "received buffer %p", buffer);
-
-  GST_OBJECT_LOCK (funnel);
   if (priv->segment.format == GST_FORMAT_UNDEFINED) {
     GST_WARNING_OBJECT (funnel, "Got buffer without segment,"
         " setting segment [0,inf[");
      gst_segment_set_newsegment_full (&priv->segment, FALSE, 1.0, 1.0,
          GST_FORMAT_TIME, 0, -1, 0);
   }
+}
 
+/*
+ * Returns the running time of the buffer in the segment of its pad
+ *
+ * Must be called with the pad object lock held
+ */
+static GstClockTime
+fs_funnel_running_time_locked (FsFunnelPadPrivate *priv, GstBuffer *buffer)
+{
   if (GST_CLOCK_TIME_IS_VALID (GST_BUFFER_TIMESTAMP (buffer)))
     gst_segment_set_last_stop (&priv->segment, priv->segment.format,
         GST_BUFFER_TIMESTAMP (buffer));
 
-  newts = gst_segment_to_running_time (&priv->segment,
+  return gst_segment_to_running_time (&priv->segment,
       priv->segment.format, GST_BUFFER_TIMESTAMP (buffer));
+}
+
+/*
+ * Pushes the newsegment event downstream if no other thread has done it
+ * since the last flush
+ */
+static void
+fs_funnel_push_segment (FsFunnel *funnel)
+{
+  GstEvent *event;
+
+  if (g_atomic_int_get (&funnel->has_segment) ||
+      !g_atomic_int_compare_and_exchange (&funnel->has_segment, FALSE, TRUE))
+    return;
+
+  event = gst_event_new_new_segment_full (FALSE, 1.0, 1.0, GST_FORMAT_TIME,
+      0, -1, 0);
+
+  if (!gst_pad_push_event (funnel->srcpad, event))
+    GST_WARNING_OBJECT (funnel, "Could not push out newsegment event");
+}
+
+/*
+ * Sets the caps on the source pad, unless they are already the same caps
+ * object. gst_pad_set_caps() replaces the pad caps with the buffer caps even
+ * if they are only equal, so once a stream is flowing, this is a single
+ * pointer comparison.
+ */
+static gboolean
+fs_funnel_set_src_caps (FsFunnel *funnel, GstCaps *caps)
+{
+  GstCaps *padcaps;
+
+  if (!caps)
+    return TRUE;
+
+  GST_OBJECT_LOCK (funnel->srcpad);
+  padcaps = GST_PAD_CAPS (funnel->srcpad);
+  GST_OBJECT_UNLOCK (funnel->srcpad);
+
+  if (caps == padcaps)
+    return TRUE;
+
+  return gst_pad_set_caps (funnel->srcpad, caps);
+}
+
+static GstFlowReturn
+fs_funnel_chain (GstPad * pad, GstBuffer * buffer)
+{
+  GstFlowReturn res;
+  FsFunnel *funnel = FS_FUNNEL (gst_pad_get_parent (pad));
+  FsFunnelPadPrivate *priv = gst_pad_get_element_private (pad);
+  GstClockTime newts;
+
+  GST_DEBUG_OBJECT (funnel, "received buffer %p", buffer);
+
+  GST_OBJECT_LOCK (pad);
+  fs_funnel_check_segment_locked (funnel, priv);
+  newts = fs_funnel_running_time_locked (priv, buffer);
+  GST_OBJECT_UNLOCK (pad);
+
   if (newts != GST_BUFFER_TIMESTAMP (buffer)) {
     buffer = gst_buffer_make_metadata_writable (buffer);
     GST_BUFFER_TIMESTAMP (buffer) = newts;
   }
 
-  if (!funnel->has_segment)
-  {
-    event = gst_event_new_new_segment_full (FALSE, 1.0, 1.0, GST_FORMAT_TIME,
-        0, -1, 0);
-    funnel->has_segment = TRUE;
-  }
-  GST_OBJECT_UNLOCK (funnel);
+  fs_funnel_push_segment (funnel);
 
-  if (event) {
-    if (!gst_pad_push_event (funnel->srcpad, event))
-      GST_WARNING_OBJECT (funnel, "Could not push out newsegment event");
+  if (!fs_funnel_set_src_caps (funnel, GST_BUFFER_CAPS (buffer))) {
+    gst_buffer_unref (buffer);
+    res = GST_FLOW_NOT_NEGOTIATED;
+    goto out;
   }
 
+  res = gst_pad_push (funnel->srcpad, buffer);
+
+  GST_LOG_OBJECT (funnel, "handled buffer %s", gst_flow_get_name (res));
+
+ out:
+  gst_object_unref (funnel);
+
+  return res;
+}
+
+/*
+ * Handles a whole list at once: the segment is checked and the pad lock
+ * taken once, the caps of the first buffer are used for the whole list like
+ * gst_pad_push_list() does and the list is forwarded as is, only the
+ * buffers whose timestamp changes are touched.
+ */
+static GstFlowReturn
+fs_funnel_chain_list (GstPad * pad, GstBufferList * list)
+{
+  GstFlowReturn res;
+  FsFunnel *funnel = FS_FUNNEL (gst_pad_get_parent (pad));
+  FsFunnelPadPrivate *priv = gst_pad_get_element_private (pad);
+  GstBufferListIterator *it;
+  GstCaps *caps = NULL;
+
+  GST_DEBUG_OBJECT (funnel, "received buffer list %p", list);
+
+  list = gst_buffer_list_make_writable (list);
 
   GST_OBJECT_LOCK (pad);
-  padcaps = GST_PAD_CAPS (funnel->srcpad);
-  GST_OBJECT_UNLOCK (pad);
+  fs_funnel_check_segment_locked (funnel, priv);
 
-  if (GST_BUFFER_CAPS (buffer) && GST_BUFFER_CAPS (buffer) != padcaps) {
-    if (!gst_pad_set_caps (funnel->srcpad, GST_BUFFER_CAPS (buffer))) {
-      res = GST_FLOW_NOT_NEGOTIATED;
-      goto out;
+  it = gst_buffer_list_iterate (list);
+  while (gst_buffer_list_iterator_next_group (it))
+  {
+    /* Only the first buffer of a group carries the timestamp and caps */
+    GstBuffer *buffer = gst_buffer_list_iterator_next (it);
+    GstClockTime newts;
+
+    if (!buffer)
+      continue;
+
+    if (!caps)
+      caps = GST_BUFFER_CAPS (buffer);
+
+    newts = fs_funnel_running_time_locked (priv, buffer);
+    if (newts != GST_BUFFER_TIMESTAMP (buffer)) {
+      if (!gst_buffer_is_metadata_writable (buffer)) {
+        buffer = gst_buffer_make_metadata_writable (gst_buffer_ref (buffer));
+        gst_buffer_list_iterator_take (it, buffer);
+      }
+      GST_BUFFER_TIMESTAMP (buffer) = newts;
     }
   }
+  gst_buffer_list_iterator_free (it);
+  GST_OBJECT_UNLOCK (pad);
 
-  res = gst_pad_push (funnel->srcpad, buffer);
+  fs_funnel_push_segment (funnel);
 
-  GST_LOG_OBJECT (funnel, "handled buffer %s", gst_flow_get_name (res));
+  if (!fs_funnel_set_src_caps (funnel, caps)) {
+    gst_buffer_list_unref (list);
+    res = GST_FLOW_NOT_NEGOTIATED;
+    goto out;
+  }
+
+  res = gst_pad_push_list (funnel->srcpad, list);
+
+  GST_LOG_OBJECT (funnel, "handled buffer list %s", gst_flow_get_name (res));
 
  out:
   gst_object_unref (funnel);
@@ -308,7 +428,7 @@ fs_funnel_event (GstPad * pad, GstEvent * event)
             &format, &start, &stop, &time);
 
 
-        GST_OBJECT_LOCK (funnel);
+        GST_OBJECT_LOCK (pad);
         gst_segment_set_newsegment_full (&priv->segment, update, rate, arate,
             format, start, stop, time);
         GST_DEBUG_OBJECT (funnel, "got new segment : start %" GST_TIME_FORMAT
@@ -316,7 +436,7 @@ fs_funnel_event (GstPad * pad, GstEvent * event)
             ", accum %" GST_TIME_FORMAT,
             GST_TIME_ARGS (start), GST_TIME_ARGS (start), GST_TIME_ARGS (time),
             GST_TIME_ARGS (priv->segment.accum));
-        GST_OBJECT_UNLOCK (funnel);
+        GST_OBJECT_UNLOCK (pad);
 
         forward = FALSE;
         gst_event_unref (event);
@@ -324,11 +444,11 @@ fs_funnel_event (GstPad * pad, GstEvent * event)
       break;
     case GST_EVENT_FLUSH_STOP:
       {
-        GST_OBJECT_LOCK (funnel);
         GST_DEBUG_OBJECT (funnel, "Received flush stop.");
+        GST_OBJECT_LOCK (pad);
         gst_segment_init (&priv->segment, GST_FORMAT_UNDEFINED);
-        funnel->has_segment = FALSE;
-        GST_OBJECT_UNLOCK (funnel);
+        GST_OBJECT_UNLOCK (pad);
+        g_atomic_int_set (&funnel->has_segment, FALSE);
       }
       break;
     default:
@@ -416,9 +536,7 @@ fs_funnel_change_state (GstElement *element, GstStateChange transition)
         if (res == GST_ITERATOR_ERROR)
           return GST_STATE_CHANGE_FAILURE;
 
-        GST_OBJECT_LOCK (funnel);
-        funnel->has_segment = FALSE;
-        GST_OBJECT_UNLOCK (funnel);
+        g_atomic_int_set (&funnel->has_segment, FALSE);
       }
       break;
     default:
@@ -55,7 +55,8 @@ struct _FsFunnel {
   /*< private >*/
   GstPad         *srcpad;
 
-  gboolean has_segment;
+  /* Set atomically by the first thread that pushes a newsegment */
+  volatile gint has_segment;
 };
 
 struct _FsFunnelClass {
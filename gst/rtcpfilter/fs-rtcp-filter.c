@@ -72,9 +72,14 @@ enum
 enum
 {
   PROP_0,
-  PROP_SENDING
+  PROP_SENDING,
+  PROP_REDUCED_SIZE
 };
 
+/* In reduced-size mode, an unchanged SDES is still sent at least once every
+ * this many RTCP packets so that new participants learn the CNAME */
+#define SDES_INTERVAL 5
+
 static void fs_rtcp_filter_get_property (GObject *object,
     guint prop_id,
     GValue *value,
@@ -83,6 +88,7 @@ static void fs_rtcp_filter_set_property (GObject *object,
     guint prop_id,
     const GValue *value,
     GParamSpec *pspec);
+static void fs_rtcp_filter_finalize (GObject *object);
 
 static GstFlowReturn
 fs_rtcp_filter_transform_ip (GstBaseTransform *transform, GstBuffer *buf);
@@ -121,6 +127,7 @@ fs_rtcp_filter_class_init (FsRtcpFilterClass *klass)
 
   gobject_class->set_property = GST_DEBUG_FUNCPTR (fs_rtcp_filter_set_property);
   gobject_class->get_property = GST_DEBUG_FUNCPTR (fs_rtcp_filter_get_property);
+  gobject_class->finalize = GST_DEBUG_FUNCPTR (fs_rtcp_filter_finalize);
 
   gstbasetransform_class->transform_ip = fs_rtcp_filter_transform_ip;
 
@@ -131,6 +138,15 @@ fs_rtcp_filter_class_init (FsRtcpFilterClass *klass)
           "If set to FALSE, it assumes that all RTP has been dropped",
           FALSE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_REDUCED_SIZE,
+      g_param_spec_boolean ("reduced-size",
+          "Send reduced-size RTCP",
+          "If set to TRUE, SDES packets identical to the previous one are"
+          " removed from most RTCP packets as allowed by RFC 5506",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -138,6 +154,17 @@ fs_rtcp_filter_init (FsRtcpFilter *rtcpfilter,
     FsRtcpFilterClass *klass)
 {
   rtcpfilter->sending = FALSE;
+  rtcpfilter->reduced_size = FALSE;
+}
+
+static void
+fs_rtcp_filter_finalize (GObject *object)
+{
+  FsRtcpFilter *filter = FS_RTCP_FILTER (object);
+
+  g_free (filter->last_sdes);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -151,9 +178,10 @@ fs_rtcp_filter_get_property (GObject *object,
   switch (prop_id)
   {
     case PROP_SENDING:
-      GST_OBJECT_LOCK (filter);
-      g_value_set_boolean (value, filter->sending);
-      GST_OBJECT_UNLOCK (filter);
+      g_value_set_boolean (value, g_atomic_int_get (&filter->sending));
+      break;
+    case PROP_REDUCED_SIZE:
+      g_value_set_boolean (value, g_atomic_int_get (&filter->reduced_size));
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -171,9 +199,10 @@ fs_rtcp_filter_set_property (GObject *object,
   switch (prop_id)
   {
     case PROP_SENDING:
-      GST_OBJECT_LOCK (filter);
-      filter->sending = g_value_get_boolean (value);
-      GST_OBJECT_UNLOCK (filter);
+      g_atomic_int_set (&filter->sending, g_value_get_boolean (value));
+      break;
+    case PROP_REDUCED_SIZE:
+      g_atomic_int_set (&filter->reduced_size, g_value_get_boolean (value));
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -181,71 +210,187 @@ fs_rtcp_filter_set_property (GObject *object,
   }
 }
 
-static GstFlowReturn
-fs_rtcp_filter_transform_ip (GstBaseTransform *transform, GstBuffer *buf)
+/*
+ * Walks the headers of the compound packet without validating it, the
+ * lengths are only used to find the next header
+ */
+static gboolean
+has_sr (GstBuffer *buf)
 {
-  FsRtcpFilter *filter = FS_RTCP_FILTER (transform);
+  const guint8 *data = GST_BUFFER_DATA (buf);
+  guint size = GST_BUFFER_SIZE (buf);
+  guint offset = 0;
 
-  if (!gst_rtcp_buffer_validate (buf))
+  while (offset + 4 <= size)
   {
-    GST_ERROR_OBJECT (transform, "Invalid RTCP buffer");
-    return GST_FLOW_ERROR;
+    if (data[offset + 1] == GST_RTCP_TYPE_SR)
+      return TRUE;
+    offset += (GST_READ_UINT16_BE (data + offset + 2) + 1) * 4;
   }
 
-  GST_OBJECT_LOCK (filter);
+  return FALSE;
+}
 
-  if (!filter->sending)
+/*
+ * Removes len bytes at offset, the SR or RR is always the first packet of a
+ * compound packet, so usually only the start of the buffer data is moved
+ */
+static void
+cut_buffer (GstBuffer *buf, guint offset, guint len)
+{
+  if (offset == 0)
+    GST_BUFFER_DATA (buf) += len;
+  else
+    memmove (GST_BUFFER_DATA (buf) + offset,
+        GST_BUFFER_DATA (buf) + offset + len,
+        GST_BUFFER_SIZE (buf) - offset - len);
+  GST_BUFFER_SIZE (buf) -= len;
+}
+
+/*
+ * Turns the SRs into RRs, an SR without report blocks that is followed
+ * by an RR is dropped, otherwise the header and SSRC are written over the
+ * end of the sender info and the sender info is cut out
+ */
+static void
+strip_sr (GstBuffer *buf)
+{
+  GstRTCPPacket packet;
+
+  if (!gst_rtcp_buffer_get_first_packet (buf, &packet))
+    return;
+
+  for (;;)
   {
-    GstRTCPPacket packet;
-    gboolean modified = FALSE;
+    if (gst_rtcp_packet_get_type (&packet) == GST_RTCP_TYPE_SR)
+    {
+      GstRTCPPacket nextpacket = packet;
+
+      if (gst_rtcp_packet_move_to_next (&nextpacket) &&
+          gst_rtcp_packet_get_type (&nextpacket) == GST_RTCP_TYPE_RR &&
+          gst_rtcp_packet_get_rb_count (&packet) == 0)
+      {
+        cut_buffer (buf, packet.offset, nextpacket.offset - packet.offset);
+      }
+      else
+      {
+        guint8 *data = GST_BUFFER_DATA (buf) + packet.offset;
 
-    if (gst_rtcp_buffer_get_first_packet (buf, &packet))
+        data[20] = data[0];
+        data[21] = GST_RTCP_TYPE_RR;
+        GST_WRITE_UINT16_BE (data + 22, GST_READ_UINT16_BE (data + 2) - 5);
+        memcpy (data + 24, data + 4, 4);
+        cut_buffer (buf, packet.offset, 20);
+      }
+
+      if (!gst_rtcp_buffer_get_first_packet (buf, &packet))
+        break;
+    }
+    else
     {
-      for (;;)
+      if (!gst_rtcp_packet_move_to_next (&packet))
+        break;
+    }
+  }
+}
+
+/*
+ * Removes the SDES packets that are identical to the last one that was let
+ * through (RFC 5506), except from packets with a BYE and from one packet
+ * every SDES_INTERVAL
+ */
+static void
+strip_sdes (FsRtcpFilter *filter, GstBuffer *buf)
+{
+  GstRTCPPacket packet;
+  gboolean keep = FALSE;
+
+  if (++filter->packets_since_sdes >= SDES_INTERVAL)
+    keep = TRUE;
+
+  if (!gst_rtcp_buffer_get_first_packet (buf, &packet))
+    return;
+
+  if (!keep)
+  {
+    GstRTCPPacket byepacket = packet;
+
+    do {
+      if (gst_rtcp_packet_get_type (&byepacket) == GST_RTCP_TYPE_BYE)
+      {
+        keep = TRUE;
+        break;
+      }
+    } while (gst_rtcp_packet_move_to_next (&byepacket));
+  }
+
+  for (;;)
+  {
+    if (gst_rtcp_packet_get_type (&packet) == GST_RTCP_TYPE_SDES)
+    {
+      guint8 *data = GST_BUFFER_DATA (buf) + packet.offset;
+      guint len = (gst_rtcp_packet_get_length (&packet) + 1) * 4;
+
+      if (!keep && len == filter->last_sdes_len &&
+          !memcmp (data, filter->last_sdes, len))
       {
-        if (gst_rtcp_packet_get_type (&packet) == GST_RTCP_TYPE_SR)
-        {
-          GstRTCPPacket nextpacket = packet;
-
-          modified = TRUE;
-          if (gst_rtcp_packet_move_to_next (&nextpacket) &&
-              gst_rtcp_packet_get_type (&nextpacket) == GST_RTCP_TYPE_RR)
-          {
-            if (!gst_rtcp_packet_remove (&packet))
-              break;
-          }
-          else
-          {
-            guchar *data = GST_BUFFER_DATA (buf) + packet.offset;
-
-            /* If there is no RR, lets add an empty one */
-            data[0] = (GST_RTCP_VERSION << 6);
-            data[1] = GST_RTCP_TYPE_RR;
-            data[2] = 0;
-            data[3] = 1;
-            memmove (GST_BUFFER_DATA (buf) + packet.offset + 8,
-                GST_BUFFER_DATA (buf) + nextpacket.offset,
-                GST_BUFFER_SIZE (buf) - nextpacket.offset);
-            GST_BUFFER_SIZE (buf) -= nextpacket.offset - packet.offset - 8;
-
-            if (!gst_rtcp_buffer_get_first_packet (buf, &packet))
-              break;
-          }
-
-        }
-        else
-        {
+        guint offset = packet.offset;
+
+        GST_LOG_OBJECT (filter, "Removing redundant SDES");
+        cut_buffer (buf, offset, len);
+
+        /* Look for the next packet from the start, it may have moved */
+        if (!gst_rtcp_buffer_get_first_packet (buf, &packet))
+          break;
+        while (packet.offset < offset)
           if (!gst_rtcp_packet_move_to_next (&packet))
-            break;
-        }
+            return;
+        continue;
       }
+
+      g_free (filter->last_sdes);
+      filter->last_sdes = g_memdup (data, len);
+      filter->last_sdes_len = len;
+      filter->packets_since_sdes = 0;
     }
 
-    if (modified)
-      gst_rtcp_buffer_end (buf);
+    if (!gst_rtcp_packet_move_to_next (&packet))
+      break;
   }
+}
+
+static GstFlowReturn
+fs_rtcp_filter_transform_ip (GstBaseTransform *transform, GstBuffer *buf)
+{
+  FsRtcpFilter *filter = FS_RTCP_FILTER (transform);
+  gboolean sending = g_atomic_int_get (&filter->sending);
+  gboolean reduced_size = g_atomic_int_get (&filter->reduced_size);
+
+  if (!reduced_size)
+  {
+    g_free (filter->last_sdes);
+    filter->last_sdes = NULL;
+    filter->last_sdes_len = 0;
+
+    /* Nothing to do, don't even look at the packet */
+    if (sending || !has_sr (buf))
+      return GST_FLOW_OK;
+  }
+
+  if (!gst_rtcp_buffer_validate (buf))
+  {
+    GST_ERROR_OBJECT (transform, "Invalid RTCP buffer");
+    return GST_FLOW_ERROR;
+  }
+
+  if (!sending)
+    strip_sr (buf);
+
+  if (reduced_size)
+    strip_sdes (filter, buf);
 
-  GST_OBJECT_UNLOCK (filter);
+  if (GST_BUFFER_SIZE (buf) == 0)
+    return GST_BASE_TRANSFORM_FLOW_DROPPED;
 
   return GST_FLOW_OK;
 }
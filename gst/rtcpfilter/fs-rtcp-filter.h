@@ -52,7 +52,14 @@ struct _FsRtcpFilter
 {
   GstBaseTransform parent;
 
-  gboolean sending;
+  /* Read and written atomically */
+  volatile gint sending;
+  volatile gint reduced_size;
+
+  /* Only touched from the streaming thread */
+  guint8 *last_sdes;
+  guint last_sdes_len;
+  guint packets_since_sdes;
 };
 
 struct _FsRtcpFilterClass
@@ -0,0 +1,698 @@
+/*
+ * Farsight Voice+Video library
+ *
+ *  Copyright 2008 Collabora Ltd,
+ *  Copyright 2008 Nokia Corporation
+ *   @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+/**
+ * SECTION:element-fsudpportsink
+ * @short_description: Sends UDP packets to many destinations in batches
+ *
+ * This element sends through a socket that has already been bound, like
+ * multiudpsink with a sockfd, and has the same "add", "remove" and "clear"
+ * action signals. All the packets of a buffer list, each one of them
+ * repeated for every destination, are given to the kernel with a single
+ * sendmmsg() call. The buffers are never copied: each group of a buffer
+ * list is sent as one datagram gathered from the buffers of the group.
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fs-udpport-sink.h"
+
+#include "fs-udpport-marshal.h"
+
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netdb.h>
+#include <netinet/in.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC (udpport_sink_debug);
+#define GST_CAT_DEFAULT (udpport_sink_debug)
+
+/* elementfactory information */
+static const GstElementDetails fs_udpport_sink_details =
+GST_ELEMENT_DETAILS (
+  "UDP port sink",
+  "Sink/Network",
+  "Sends batches of UDP packets to many destinations",
+  "Olivier Crete <olivier.crete@collabora.co.uk>");
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+/* signals and args */
+enum
+{
+  SIGNAL_ADD,
+  SIGNAL_REMOVE,
+  SIGNAL_CLEAR,
+  LAST_SIGNAL
+};
+
+enum
+{
+  PROP_0,
+  PROP_SOCKFD,
+  PROP_CLOSEFD
+};
+
+/* The kernel does not take more messages at once (UIO_MAXIOV) */
+#define MAX_MESSAGES 1024
+
+struct Destination {
+  gchar *host;
+  gint port;
+  /* Number of times it was added, the packets are sent only once */
+  guint refcount;
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+};
+
+struct Datagram {
+  guint first_iov;
+  guint n_iovs;
+};
+
+struct _FsUdpPortSinkPrivate
+{
+  /* Protected by the object lock */
+  gint sockfd;
+  gboolean closefd;
+  /* Each destination is only present once, refcounted like
+   * in multiudpsink */
+  GArray *dests;
+  guint dests_cookie;
+
+  /* Everything below is only touched from the streaming thread */
+  gint fd;
+  gboolean close_on_stop;
+
+  /* Copy of the destinations, updated when the cookie changes */
+  GArray *send_dests;
+  guint send_dests_cookie;
+
+  GArray *iovs;
+  GArray *datagrams;
+#ifdef HAVE_SENDMMSG
+  GArray *msgs;
+#endif
+};
+
+#define FS_UDPPORT_SINK_GET_PRIVATE(o)                                  \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((o), FS_TYPE_UDPPORT_SINK,              \
+      FsUdpPortSinkPrivate))
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+static void fs_udpport_sink_finalize (GObject *object);
+static void fs_udpport_sink_get_property (GObject *object,
+    guint prop_id,
+    GValue *value,
+    GParamSpec *pspec);
+static void fs_udpport_sink_set_property (GObject *object,
+    guint prop_id,
+    const GValue *value,
+    GParamSpec *pspec);
+
+static void fs_udpport_sink_add (FsUdpPortSink *self, const gchar *host,
+    gint port);
+static void fs_udpport_sink_remove (FsUdpPortSink *self, const gchar *host,
+    gint port);
+static void fs_udpport_sink_clear (FsUdpPortSink *self);
+
+static gboolean fs_udpport_sink_start (GstBaseSink *sink);
+static gboolean fs_udpport_sink_stop (GstBaseSink *sink);
+static GstFlowReturn fs_udpport_sink_render (GstBaseSink *sink,
+    GstBuffer *buffer);
+static GstFlowReturn fs_udpport_sink_render_list (GstBaseSink *sink,
+    GstBufferList *list);
+
+static void
+_do_init (GType type)
+{
+  GST_DEBUG_CATEGORY_INIT
+    (udpport_sink_debug, "fsudpportsink", 0, "fsudpportsink");
+}
+
+GST_BOILERPLATE_FULL (FsUdpPortSink, fs_udpport_sink, GstBaseSink,
+    GST_TYPE_BASE_SINK, _do_init);
+
+static void
+fs_udpport_sink_base_init (gpointer klass)
+{
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&sinktemplate));
+
+  gst_element_class_set_details (element_class, &fs_udpport_sink_details);
+}
+
+static void
+fs_udpport_sink_class_init (FsUdpPortSinkClass *klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+  GstBaseSinkClass *gstbasesink_class = (GstBaseSinkClass *) klass;
+
+  g_type_class_add_private (klass, sizeof (FsUdpPortSinkPrivate));
+
+  gobject_class->set_property =
+    GST_DEBUG_FUNCPTR (fs_udpport_sink_set_property);
+  gobject_class->get_property =
+    GST_DEBUG_FUNCPTR (fs_udpport_sink_get_property);
+  gobject_class->finalize = GST_DEBUG_FUNCPTR (fs_udpport_sink_finalize);
+
+  gstbasesink_class->start = GST_DEBUG_FUNCPTR (fs_udpport_sink_start);
+  gstbasesink_class->stop = GST_DEBUG_FUNCPTR (fs_udpport_sink_stop);
+  gstbasesink_class->render = GST_DEBUG_FUNCPTR (fs_udpport_sink_render);
+  gstbasesink_class->render_list =
+    GST_DEBUG_FUNCPTR (fs_udpport_sink_render_list);
+
+  klass->add = fs_udpport_sink_add;
+  klass->remove = fs_udpport_sink_remove;
+  klass->clear = fs_udpport_sink_clear;
+
+  g_object_class_install_property (gobject_class,
+      PROP_SOCKFD,
+      g_param_spec_int ("sockfd",
+          "Socket file descriptor",
+          "The socket to send through",
+          -1, G_MAXINT, -1,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_CLOSEFD,
+      g_param_spec_boolean ("closefd",
+          "Close the socket",
+          "Close the socket when the element is stopped",
+          TRUE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsUdpPortSink::add:
+   * @self: #FsUdpPortSink that the signal is emitted on
+   * @host: the host name or IP address of the destination
+   * @port: the port of the destination
+   *
+   * Starts sending the packets to this destination. Adding a destination
+   * that is already present only increments its reference count.
+   */
+  signals[SIGNAL_ADD] = g_signal_new ("add",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_STRUCT_OFFSET (FsUdpPortSinkClass, add),
+      NULL,
+      NULL,
+      _fs_udpport_marshal_VOID__STRING_INT,
+      G_TYPE_NONE, 2, G_TYPE_STRING, G_TYPE_INT);
+
+  /**
+   * FsUdpPortSink::remove:
+   * @self: #FsUdpPortSink that the signal is emitted on
+   * @host: the host name or IP address of the destination
+   * @port: the port of the destination
+   *
+   * Decrements the reference count of this destination, the packets stop
+   * being sent to it when it reaches 0
+   */
+  signals[SIGNAL_REMOVE] = g_signal_new ("remove",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_STRUCT_OFFSET (FsUdpPortSinkClass, remove),
+      NULL,
+      NULL,
+      _fs_udpport_marshal_VOID__STRING_INT,
+      G_TYPE_NONE, 2, G_TYPE_STRING, G_TYPE_INT);
+
+  /**
+   * FsUdpPortSink::clear:
+   * @self: #FsUdpPortSink that the signal is emitted on
+   *
+   * Removes all the destinations
+   */
+  signals[SIGNAL_CLEAR] = g_signal_new ("clear",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_STRUCT_OFFSET (FsUdpPortSinkClass, clear),
+      NULL,
+      NULL,
+      g_cclosure_marshal_VOID__VOID,
+      G_TYPE_NONE, 0);
+}
+
+static void
+fs_udpport_sink_init (FsUdpPortSink *self, FsUdpPortSinkClass *klass)
+{
+  self->priv = FS_UDPPORT_SINK_GET_PRIVATE (self);
+
+  self->priv->sockfd = -1;
+  self->priv->closefd = TRUE;
+  self->priv->fd = -1;
+
+  self->priv->dests = g_array_new (FALSE, FALSE, sizeof (struct Destination));
+  self->priv->send_dests = g_array_new (FALSE, FALSE,
+      sizeof (struct Destination));
+  self->priv->iovs = g_array_new (FALSE, FALSE, sizeof (struct iovec));
+  self->priv->datagrams = g_array_new (FALSE, FALSE, sizeof (struct Datagram));
+#ifdef HAVE_SENDMMSG
+  self->priv->msgs = g_array_new (FALSE, TRUE, sizeof (struct mmsghdr));
+#endif
+}
+
+static void
+fs_udpport_sink_finalize (GObject *object)
+{
+  FsUdpPortSink *self = FS_UDPPORT_SINK (object);
+
+  fs_udpport_sink_clear (self);
+  g_array_free (self->priv->dests, TRUE);
+  /* The copy shares the host strings, they are never used from it */
+  g_array_free (self->priv->send_dests, TRUE);
+  g_array_free (self->priv->iovs, TRUE);
+  g_array_free (self->priv->datagrams, TRUE);
+#ifdef HAVE_SENDMMSG
+  g_array_free (self->priv->msgs, TRUE);
+#endif
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+fs_udpport_sink_get_property (GObject *object,
+    guint prop_id,
+    GValue *value,
+    GParamSpec *pspec)
+{
+  FsUdpPortSink *self = FS_UDPPORT_SINK (object);
+
+  GST_OBJECT_LOCK (self);
+  switch (prop_id)
+  {
+    case PROP_SOCKFD:
+      g_value_set_int (value, self->priv->sockfd);
+      break;
+    case PROP_CLOSEFD:
+      g_value_set_boolean (value, self->priv->closefd);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+fs_udpport_sink_set_property (GObject *object,
+    guint prop_id,
+    const GValue *value,
+    GParamSpec *pspec)
+{
+  FsUdpPortSink *self = FS_UDPPORT_SINK (object);
+
+  GST_OBJECT_LOCK (self);
+  switch (prop_id)
+  {
+    case PROP_SOCKFD:
+      self->priv->sockfd = g_value_get_int (value);
+      break;
+    case PROP_CLOSEFD:
+      self->priv->closefd = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static struct Destination *
+find_destination_locked (FsUdpPortSink *self, const gchar *host, gint port,
+    guint *index)
+{
+  guint i;
+
+  for (i = 0; i < self->priv->dests->len; i++)
+  {
+    struct Destination *dest = &g_array_index (self->priv->dests,
+        struct Destination, i);
+
+    if (dest->port == port && !strcmp (dest->host, host))
+    {
+      if (index)
+        *index = i;
+      return dest;
+    }
+  }
+
+  return NULL;
+}
+
+static void
+fs_udpport_sink_add (FsUdpPortSink *self, const gchar *host, gint port)
+{
+  struct Destination dest;
+  struct Destination *existing;
+  struct addrinfo hints;
+  struct addrinfo *result = NULL;
+  gchar portstr[8];
+  gint ret;
+
+  GST_OBJECT_LOCK (self);
+  existing = find_destination_locked (self, host, port, NULL);
+  if (existing)
+  {
+    existing->refcount++;
+    GST_DEBUG_OBJECT (self, "Destination %s:%d added again, refcount %u",
+        host, port, existing->refcount);
+    GST_OBJECT_UNLOCK (self);
+    return;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  memset (&hints, 0, sizeof (struct addrinfo));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+  g_snprintf (portstr, sizeof (portstr), "%d", port);
+
+  ret = getaddrinfo (host, portstr, &hints, &result);
+  if (ret != 0)
+  {
+    GST_WARNING_OBJECT (self, "Could not resolve %s: %s", host,
+        gai_strerror (ret));
+    return;
+  }
+
+  memset (&dest, 0, sizeof (struct Destination));
+  dest.host = g_strdup (host);
+  dest.port = port;
+  dest.refcount = 1;
+  dest.addrlen = MIN (result->ai_addrlen, sizeof (struct sockaddr_storage));
+  memcpy (&dest.addr, result->ai_addr, dest.addrlen);
+  freeaddrinfo (result);
+
+  GST_OBJECT_LOCK (self);
+  /* It may have been added by another thread while resolving */
+  existing = find_destination_locked (self, host, port, NULL);
+  if (existing)
+  {
+    existing->refcount++;
+    g_free (dest.host);
+  }
+  else
+  {
+    GST_DEBUG_OBJECT (self, "Adding destination %s:%d", host, port);
+    g_array_append_val (self->priv->dests, dest);
+    self->priv->dests_cookie++;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+fs_udpport_sink_remove (FsUdpPortSink *self, const gchar *host, gint port)
+{
+  struct Destination *dest;
+  guint i;
+
+  GST_OBJECT_LOCK (self);
+  dest = find_destination_locked (self, host, port, &i);
+  if (!dest)
+  {
+    GST_WARNING_OBJECT (self, "Destination %s:%d was not added", host, port);
+  }
+  else if (--dest->refcount == 0)
+  {
+    GST_DEBUG_OBJECT (self, "Removing destination %s:%d", host, port);
+    g_free (dest->host);
+    g_array_remove_index (self->priv->dests, i);
+    self->priv->dests_cookie++;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+fs_udpport_sink_clear (FsUdpPortSink *self)
+{
+  guint i;
+
+  GST_OBJECT_LOCK (self);
+  for (i = 0; i < self->priv->dests->len; i++)
+    g_free (g_array_index (self->priv->dests, struct Destination, i).host);
+  g_array_set_size (self->priv->dests, 0);
+  self->priv->dests_cookie++;
+  GST_OBJECT_UNLOCK (self);
+}
+
+static gboolean
+fs_udpport_sink_start (GstBaseSink *sink)
+{
+  FsUdpPortSink *self = FS_UDPPORT_SINK (sink);
+
+  GST_OBJECT_LOCK (self);
+  self->priv->fd = self->priv->sockfd;
+  self->priv->close_on_stop = self->priv->closefd;
+  /* Force a copy of the destinations at the first buffer */
+  self->priv->send_dests_cookie = self->priv->dests_cookie - 1;
+  GST_OBJECT_UNLOCK (self);
+
+  if (self->priv->fd < 0)
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_WRITE, (NULL),
+        ("No socket was set"));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+fs_udpport_sink_stop (GstBaseSink *sink)
+{
+  FsUdpPortSink *self = FS_UDPPORT_SINK (sink);
+
+  if (self->priv->close_on_stop && self->priv->fd >= 0)
+    close (self->priv->fd);
+  self->priv->fd = -1;
+
+  return TRUE;
+}
+
+/*
+ * Copies the destinations for the streaming thread if they were changed,
+ * so the lock is not held while sending
+ */
+static void
+update_send_dests (FsUdpPortSink *self)
+{
+  FsUdpPortSinkPrivate *priv = self->priv;
+
+  GST_OBJECT_LOCK (self);
+  if (priv->send_dests_cookie != priv->dests_cookie)
+  {
+    g_array_set_size (priv->send_dests, 0);
+    g_array_append_vals (priv->send_dests, priv->dests->data,
+        priv->dests->len);
+    priv->send_dests_cookie = priv->dests_cookie;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+add_datagram (FsUdpPortSinkPrivate *priv, guint first_iov)
+{
+  struct Datagram datagram;
+
+  datagram.first_iov = first_iov;
+  datagram.n_iovs = priv->iovs->len - first_iov;
+
+  if (datagram.n_iovs)
+    g_array_append_val (priv->datagrams, datagram);
+}
+
+static void
+add_iov (FsUdpPortSinkPrivate *priv, GstBuffer *buffer)
+{
+  struct iovec iov;
+
+  iov.iov_base = GST_BUFFER_DATA (buffer);
+  iov.iov_len = GST_BUFFER_SIZE (buffer);
+
+  g_array_append_val (priv->iovs, iov);
+}
+
+#ifdef HAVE_SENDMMSG
+
+/*
+ * Sends every datagram to every destination, MAX_MESSAGES at a time. A
+ * message that fails is skipped, like multiudpsink ignores send errors.
+ */
+static void
+send_datagrams (FsUdpPortSink *self)
+{
+  FsUdpPortSinkPrivate *priv = self->priv;
+  guint n_messages = priv->datagrams->len * priv->send_dests->len;
+  guint d, i;
+  guint sent = 0;
+
+  g_array_set_size (priv->msgs, n_messages);
+
+  for (d = 0; d < priv->datagrams->len; d++)
+  {
+    struct Datagram *datagram = &g_array_index (priv->datagrams,
+        struct Datagram, d);
+
+    for (i = 0; i < priv->send_dests->len; i++)
+    {
+      struct Destination *dest = &g_array_index (priv->send_dests,
+          struct Destination, i);
+      struct mmsghdr *msg = &g_array_index (priv->msgs, struct mmsghdr,
+          d * priv->send_dests->len + i);
+
+      memset (msg, 0, sizeof (struct mmsghdr));
+      msg->msg_hdr.msg_name = &dest->addr;
+      msg->msg_hdr.msg_namelen = dest->addrlen;
+      msg->msg_hdr.msg_iov = &g_array_index (priv->iovs, struct iovec,
+          datagram->first_iov);
+      msg->msg_hdr.msg_iovlen = datagram->n_iovs;
+    }
+  }
+
+  while (sent < n_messages)
+  {
+    gint ret = sendmmsg (priv->fd,
+        &g_array_index (priv->msgs, struct mmsghdr, sent),
+        MIN (n_messages - sent, MAX_MESSAGES), 0);
+
+    if (ret < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      GST_DEBUG_OBJECT (self, "Could not send packet: %s",
+          g_strerror (errno));
+      ret = 1;
+    }
+
+    sent += ret;
+  }
+}
+
+#else /* HAVE_SENDMMSG */
+
+static void
+send_datagrams (FsUdpPortSink *self)
+{
+  FsUdpPortSinkPrivate *priv = self->priv;
+  guint d, i;
+
+  for (d = 0; d < priv->datagrams->len; d++)
+  {
+    struct Datagram *datagram = &g_array_index (priv->datagrams,
+        struct Datagram, d);
+
+    for (i = 0; i < priv->send_dests->len; i++)
+    {
+      struct Destination *dest = &g_array_index (priv->send_dests,
+          struct Destination, i);
+      struct msghdr msg;
+
+      memset (&msg, 0, sizeof (struct msghdr));
+      msg.msg_name = &dest->addr;
+      msg.msg_namelen = dest->addrlen;
+      msg.msg_iov = &g_array_index (priv->iovs, struct iovec,
+          datagram->first_iov);
+      msg.msg_iovlen = datagram->n_iovs;
+
+      while (sendmsg (priv->fd, &msg, 0) < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        GST_DEBUG_OBJECT (self, "Could not send packet: %s",
+            g_strerror (errno));
+        break;
+      }
+    }
+  }
+}
+
+#endif /* HAVE_SENDMMSG */
+
+static void
+flush_datagrams (FsUdpPortSink *self)
+{
+  update_send_dests (self);
+
+  if (self->priv->send_dests->len)
+    send_datagrams (self);
+
+  g_array_set_size (self->priv->iovs, 0);
+  g_array_set_size (self->priv->datagrams, 0);
+}
+
+static GstFlowReturn
+fs_udpport_sink_render (GstBaseSink *sink, GstBuffer *buffer)
+{
+  FsUdpPortSink *self = FS_UDPPORT_SINK (sink);
+
+  add_iov (self->priv, buffer);
+  add_datagram (self->priv, 0);
+  flush_datagrams (self);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+fs_udpport_sink_render_list (GstBaseSink *sink, GstBufferList *list)
+{
+  FsUdpPortSink *self = FS_UDPPORT_SINK (sink);
+  GstBufferListIterator *it = gst_buffer_list_iterate (list);
+
+  while (gst_buffer_list_iterator_next_group (it))
+  {
+    guint first_iov = self->priv->iovs->len;
+    GstBuffer *buffer;
+
+    while ((buffer = gst_buffer_list_iterator_next (it)))
+      add_iov (self->priv, buffer);
+
+    add_datagram (self->priv, first_iov);
+  }
+  gst_buffer_list_iterator_free (it);
+
+  flush_datagrams (self);
+
+  return GST_FLOW_OK;
+}
@@ -0,0 +1,74 @@
+/*
+ * Farsight Voice+Video library
+ *
+ *  Copyright 2008 Collabora Ltd,
+ *  Copyright 2008 Nokia Corporation
+ *   @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef __FS_UDPPORT_SINK_H__
+#define __FS_UDPPORT_SINK_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesink.h>
+
+G_BEGIN_DECLS
+
+/* #define's don't like whitespacey bits */
+#define FS_TYPE_UDPPORT_SINK \
+  (fs_udpport_sink_get_type())
+#define FS_UDPPORT_SINK(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), \
+  FS_TYPE_UDPPORT_SINK,FsUdpPortSink))
+#define FS_UDPPORT_SINK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), \
+  FS_TYPE_UDPPORT_SINK,FsUdpPortSinkClass))
+#define FS_IS_UDPPORT_SINK(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),FS_TYPE_UDPPORT_SINK))
+#define FS_IS_UDPPORT_SINK_CLASS(obj) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),FS_TYPE_UDPPORT_SINK))
+
+typedef struct _FsUdpPortSink FsUdpPortSink;
+typedef struct _FsUdpPortSinkClass FsUdpPortSinkClass;
+typedef struct _FsUdpPortSinkPrivate FsUdpPortSinkPrivate;
+
+struct _FsUdpPortSink
+{
+  GstBaseSink parent;
+
+  /*< private >*/
+  FsUdpPortSinkPrivate *priv;
+};
+
+struct _FsUdpPortSinkClass
+{
+  GstBaseSinkClass parent_class;
+
+  /* action signals */
+  void (*add) (FsUdpPortSink *sink, const gchar *host, gint port);
+  void (*remove) (FsUdpPortSink *sink, const gchar *host, gint port);
+  void (*clear) (FsUdpPortSink *sink);
+};
+
+GType fs_udpport_sink_get_type (void);
+
+G_END_DECLS
+
+#endif /* __FS_UDPPORT_SINK_H__ */
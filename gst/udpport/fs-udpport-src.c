@@ -0,0 +1,761 @@
+/*
+ * Farsight Voice+Video library
+ *
+ *  Copyright 2008 Collabora Ltd,
+ *  Copyright 2008 Nokia Corporation
+ *   @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+/**
+ * SECTION:element-fsudpportsrc
+ * @short_description: Receives UDP packets in batches from an existing socket
+ *
+ * This element reads from a socket that has already been bound, like udpsrc
+ * with a sockfd, but it fetches as many datagrams as are waiting with a
+ * single recvmmsg() call into a preallocated area. The packets are then
+ * handed out one by one as #GstNetBuffer with their sender address.
+ *
+ * If #FsUdpPortSrc:kernel-timestamps is set, each buffer is timestamped with
+ * the time at which the kernel received the packet instead of the time at
+ * which the streaming thread got to it.
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fs-udpport-src.h"
+
+#include <gst/netbuffer/gstnetbuffer.h>
+
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC (udpport_src_debug);
+#define GST_CAT_DEFAULT (udpport_src_debug)
+
+/* elementfactory information */
+static const GstElementDetails fs_udpport_src_details =
+GST_ELEMENT_DETAILS (
+  "UDP port source",
+  "Source/Network",
+  "Receives batches of UDP packets from an already bound socket",
+  "Olivier Crete <olivier.crete@collabora.co.uk>");
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+enum
+{
+  PROP_0,
+  PROP_SOCKFD,
+  PROP_CLOSEFD,
+  PROP_BATCH_SIZE,
+  PROP_MAX_PACKET_SIZE,
+  PROP_KERNEL_TIMESTAMPS
+};
+
+#define DEFAULT_BATCH_SIZE 32
+/* A slot a bit bigger than an ethernet MTU, the whole area is allocated per
+ * source, so 64KiB slots would cost 2MiB with the default batch size */
+#define DEFAULT_MAX_PACKET_SIZE 2048
+
+#if defined (SO_TIMESTAMPNS)
+# define TIMESTAMP_OPTION SO_TIMESTAMPNS
+# define TIMESTAMP_CMSG SCM_TIMESTAMPNS
+# define TIMESTAMP_TYPE struct timespec
+# define TIMESTAMP_TO_NS(t) \
+  ((t)->tv_sec * GST_SECOND + (t)->tv_nsec)
+#elif defined (SO_TIMESTAMP)
+# define TIMESTAMP_OPTION SO_TIMESTAMP
+# define TIMESTAMP_CMSG SCM_TIMESTAMP
+# define TIMESTAMP_TYPE struct timeval
+# define TIMESTAMP_TO_NS(t) \
+  ((t)->tv_sec * GST_SECOND + (t)->tv_usec * GST_USECOND)
+#endif
+
+struct _FsUdpPortSrcPrivate
+{
+  /* Protected by the object lock, only used at the next start */
+  gint sockfd;
+  gboolean closefd;
+  guint batch_size;
+  guint max_packet_size;
+  gboolean kernel_timestamps;
+
+  /* Everything below is only touched from the streaming thread between
+   * start and stop, except for the poll that is set flushing by unlock */
+  gint fd;
+  gboolean close_on_stop;
+  GstPoll *poll;
+  GstPollFD pollfd;
+
+  guint batch;
+  guint packet_size;
+  gboolean use_timestamps;
+
+  /* The packets are received in this area, each one has packet_size bytes,
+   * larger packets are truncated by the kernel and dropped */
+  guint8 *area;
+  struct sockaddr_storage *addrs;
+  guint *lens;
+  /* The control messages and the kernel arrival times (wall clock) */
+  guint8 *controls;
+  guint control_size;
+  GstClockTime *stamps;
+#ifdef HAVE_RECVMMSG
+  struct iovec *iovs;
+  struct mmsghdr *msgs;
+#endif
+
+  /* Packets received but not returned by create yet */
+  GstBuffer **pending;
+  guint pending_head;
+  guint pending_count;
+};
+
+#define FS_UDPPORT_SRC_GET_PRIVATE(o)                                   \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((o), FS_TYPE_UDPPORT_SRC,               \
+      FsUdpPortSrcPrivate))
+
+static void fs_udpport_src_get_property (GObject *object,
+    guint prop_id,
+    GValue *value,
+    GParamSpec *pspec);
+static void fs_udpport_src_set_property (GObject *object,
+    guint prop_id,
+    const GValue *value,
+    GParamSpec *pspec);
+
+static gboolean fs_udpport_src_start (GstBaseSrc *src);
+static gboolean fs_udpport_src_stop (GstBaseSrc *src);
+static gboolean fs_udpport_src_unlock (GstBaseSrc *src);
+static gboolean fs_udpport_src_unlock_stop (GstBaseSrc *src);
+static GstFlowReturn fs_udpport_src_create (GstPushSrc *psrc,
+    GstBuffer **buf);
+
+static void
+_do_init (GType type)
+{
+  GST_DEBUG_CATEGORY_INIT
+    (udpport_src_debug, "fsudpportsrc", 0, "fsudpportsrc");
+}
+
+GST_BOILERPLATE_FULL (FsUdpPortSrc, fs_udpport_src, GstPushSrc,
+    GST_TYPE_PUSH_SRC, _do_init);
+
+static void
+fs_udpport_src_base_init (gpointer klass)
+{
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&srctemplate));
+
+  gst_element_class_set_details (element_class, &fs_udpport_src_details);
+}
+
+static void
+fs_udpport_src_class_init (FsUdpPortSrcClass *klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+  GstBaseSrcClass *gstbasesrc_class = (GstBaseSrcClass *) klass;
+  GstPushSrcClass *gstpushsrc_class = (GstPushSrcClass *) klass;
+
+  g_type_class_add_private (klass, sizeof (FsUdpPortSrcPrivate));
+
+  gobject_class->set_property = GST_DEBUG_FUNCPTR (fs_udpport_src_set_property);
+  gobject_class->get_property = GST_DEBUG_FUNCPTR (fs_udpport_src_get_property);
+
+  gstbasesrc_class->start = GST_DEBUG_FUNCPTR (fs_udpport_src_start);
+  gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (fs_udpport_src_stop);
+  gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (fs_udpport_src_unlock);
+  gstbasesrc_class->unlock_stop =
+    GST_DEBUG_FUNCPTR (fs_udpport_src_unlock_stop);
+
+  gstpushsrc_class->create = GST_DEBUG_FUNCPTR (fs_udpport_src_create);
+
+  g_object_class_install_property (gobject_class,
+      PROP_SOCKFD,
+      g_param_spec_int ("sockfd",
+          "Socket file descriptor",
+          "The bound socket to receive from",
+          -1, G_MAXINT, -1,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_CLOSEFD,
+      g_param_spec_boolean ("closefd",
+          "Close the socket",
+          "Close the socket when the element is stopped",
+          TRUE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_BATCH_SIZE,
+      g_param_spec_uint ("batch-size",
+          "Batch size",
+          "The maximum number of packets received with a single system call",
+          1, 1024, DEFAULT_BATCH_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_MAX_PACKET_SIZE,
+      g_param_spec_uint ("max-packet-size",
+          "Maximum packet size",
+          "The size of the largest packet that can be received,"
+          " larger packets are truncated and dropped. The receive buffer is"
+          " batch-size times this size",
+          1, 65536, DEFAULT_MAX_PACKET_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_KERNEL_TIMESTAMPS,
+      g_param_spec_boolean ("kernel-timestamps",
+          "Kernel timestamps",
+          "Timestamp the buffers with the time at which the kernel received"
+          " the packets",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+fs_udpport_src_init (FsUdpPortSrc *self, FsUdpPortSrcClass *klass)
+{
+  self->priv = FS_UDPPORT_SRC_GET_PRIVATE (self);
+
+  self->priv->sockfd = -1;
+  self->priv->closefd = TRUE;
+  self->priv->batch_size = DEFAULT_BATCH_SIZE;
+  self->priv->max_packet_size = DEFAULT_MAX_PACKET_SIZE;
+  self->priv->fd = -1;
+
+  gst_base_src_set_live (GST_BASE_SRC (self), TRUE);
+  gst_base_src_set_format (GST_BASE_SRC (self), GST_FORMAT_TIME);
+  gst_base_src_set_do_timestamp (GST_BASE_SRC (self), TRUE);
+}
+
+static void
+fs_udpport_src_get_property (GObject *object,
+    guint prop_id,
+    GValue *value,
+    GParamSpec *pspec)
+{
+  FsUdpPortSrc *self = FS_UDPPORT_SRC (object);
+
+  GST_OBJECT_LOCK (self);
+  switch (prop_id)
+  {
+    case PROP_SOCKFD:
+      g_value_set_int (value, self->priv->sockfd);
+      break;
+    case PROP_CLOSEFD:
+      g_value_set_boolean (value, self->priv->closefd);
+      break;
+    case PROP_BATCH_SIZE:
+      g_value_set_uint (value, self->priv->batch_size);
+      break;
+    case PROP_MAX_PACKET_SIZE:
+      g_value_set_uint (value, self->priv->max_packet_size);
+      break;
+    case PROP_KERNEL_TIMESTAMPS:
+      g_value_set_boolean (value, self->priv->kernel_timestamps);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+fs_udpport_src_set_property (GObject *object,
+    guint prop_id,
+    const GValue *value,
+    GParamSpec *pspec)
+{
+  FsUdpPortSrc *self = FS_UDPPORT_SRC (object);
+
+  GST_OBJECT_LOCK (self);
+  switch (prop_id)
+  {
+    case PROP_SOCKFD:
+      self->priv->sockfd = g_value_get_int (value);
+      break;
+    case PROP_CLOSEFD:
+      self->priv->closefd = g_value_get_boolean (value);
+      break;
+    case PROP_BATCH_SIZE:
+      self->priv->batch_size = g_value_get_uint (value);
+      break;
+    case PROP_MAX_PACKET_SIZE:
+      self->priv->max_packet_size = g_value_get_uint (value);
+      break;
+    case PROP_KERNEL_TIMESTAMPS:
+      self->priv->kernel_timestamps = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static gboolean
+fs_udpport_src_start (GstBaseSrc *src)
+{
+  FsUdpPortSrc *self = FS_UDPPORT_SRC (src);
+  FsUdpPortSrcPrivate *priv = self->priv;
+  guint i;
+
+  GST_OBJECT_LOCK (self);
+  priv->fd = priv->sockfd;
+  priv->close_on_stop = priv->closefd;
+  priv->batch = priv->batch_size;
+  priv->packet_size = priv->max_packet_size;
+  priv->use_timestamps = priv->kernel_timestamps;
+  GST_OBJECT_UNLOCK (self);
+
+  if (priv->fd < 0)
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ, (NULL),
+        ("No socket was set"));
+    return FALSE;
+  }
+
+#ifndef HAVE_RECVMMSG
+  priv->batch = 1;
+#endif
+
+  if (priv->use_timestamps)
+  {
+#ifdef TIMESTAMP_OPTION
+    int one = 1;
+
+    if (setsockopt (priv->fd, SOL_SOCKET, TIMESTAMP_OPTION, &one,
+            sizeof (one)) < 0)
+    {
+      GST_WARNING_OBJECT (self, "Could not enable kernel timestamps: %s",
+          g_strerror (errno));
+      priv->use_timestamps = FALSE;
+    }
+#else
+    GST_WARNING_OBJECT (self, "Kernel timestamps are not supported");
+    priv->use_timestamps = FALSE;
+#endif
+  }
+
+  priv->poll = gst_poll_new (TRUE);
+  if (!priv->poll)
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ, (NULL),
+        ("Could not create the poll: %s", g_strerror (errno)));
+    return FALSE;
+  }
+
+  gst_poll_fd_init (&priv->pollfd);
+  priv->pollfd.fd = priv->fd;
+  gst_poll_add_fd (priv->poll, &priv->pollfd);
+  gst_poll_fd_ctl_read (priv->poll, &priv->pollfd, TRUE);
+
+  priv->area = g_malloc (priv->batch * priv->packet_size);
+  priv->addrs = g_new0 (struct sockaddr_storage, priv->batch);
+  priv->lens = g_new0 (guint, priv->batch);
+  priv->pending = g_new0 (GstBuffer *, priv->batch);
+  priv->pending_head = priv->pending_count = 0;
+  priv->stamps = g_new (GstClockTime, priv->batch);
+  for (i = 0; i < priv->batch; i++)
+    priv->stamps[i] = GST_CLOCK_TIME_NONE;
+
+  priv->controls = NULL;
+  priv->control_size = 0;
+#ifdef TIMESTAMP_OPTION
+  if (priv->use_timestamps)
+  {
+    priv->control_size = CMSG_SPACE (sizeof (TIMESTAMP_TYPE));
+    priv->controls = g_malloc0 (priv->batch * priv->control_size);
+  }
+#endif
+
+#ifdef HAVE_RECVMMSG
+  priv->iovs = g_new0 (struct iovec, priv->batch);
+  priv->msgs = g_new0 (struct mmsghdr, priv->batch);
+
+  for (i = 0; i < priv->batch; i++)
+  {
+    priv->iovs[i].iov_base = priv->area + i * priv->packet_size;
+    priv->iovs[i].iov_len = priv->packet_size;
+    priv->msgs[i].msg_hdr.msg_iov = &priv->iovs[i];
+    priv->msgs[i].msg_hdr.msg_iovlen = 1;
+    priv->msgs[i].msg_hdr.msg_name = &priv->addrs[i];
+    if (priv->controls)
+      priv->msgs[i].msg_hdr.msg_control =
+        priv->controls + i * priv->control_size;
+  }
+#endif
+
+  GST_DEBUG_OBJECT (self, "Receiving up to %u packets of %u bytes at a time"
+      " on fd %d", priv->batch, priv->packet_size, priv->fd);
+
+  return TRUE;
+}
+
+static gboolean
+fs_udpport_src_stop (GstBaseSrc *src)
+{
+  FsUdpPortSrc *self = FS_UDPPORT_SRC (src);
+  FsUdpPortSrcPrivate *priv = self->priv;
+
+  for (; priv->pending_head < priv->pending_count; priv->pending_head++)
+    gst_buffer_unref (priv->pending[priv->pending_head]);
+
+  g_free (priv->pending);
+  priv->pending = NULL;
+  g_free (priv->lens);
+  priv->lens = NULL;
+  g_free (priv->addrs);
+  priv->addrs = NULL;
+  g_free (priv->area);
+  priv->area = NULL;
+  g_free (priv->controls);
+  priv->controls = NULL;
+  g_free (priv->stamps);
+  priv->stamps = NULL;
+#ifdef HAVE_RECVMMSG
+  g_free (priv->msgs);
+  priv->msgs = NULL;
+  g_free (priv->iovs);
+  priv->iovs = NULL;
+#endif
+
+  if (priv->poll)
+  {
+    gst_poll_free (priv->poll);
+    priv->poll = NULL;
+  }
+
+  if (priv->close_on_stop && priv->fd >= 0)
+    close (priv->fd);
+  priv->fd = -1;
+
+  return TRUE;
+}
+
+static gboolean
+fs_udpport_src_unlock (GstBaseSrc *src)
+{
+  FsUdpPortSrc *self = FS_UDPPORT_SRC (src);
+
+  if (self->priv->poll)
+    gst_poll_set_flushing (self->priv->poll, TRUE);
+
+  return TRUE;
+}
+
+static gboolean
+fs_udpport_src_unlock_stop (GstBaseSrc *src)
+{
+  FsUdpPortSrc *self = FS_UDPPORT_SRC (src);
+
+  if (self->priv->poll)
+    gst_poll_set_flushing (self->priv->poll, FALSE);
+
+  return TRUE;
+}
+
+/*
+ * Returns the kernel arrival time carried by the control messages of a
+ * received packet, in nanoseconds of wall clock time
+ */
+static GstClockTime
+get_arrival_time (struct msghdr *msg)
+{
+#ifdef TIMESTAMP_OPTION
+  struct cmsghdr *cmsg;
+
+  if (msg->msg_flags & MSG_CTRUNC)
+    return GST_CLOCK_TIME_NONE;
+
+  for (cmsg = CMSG_FIRSTHDR (msg); cmsg; cmsg = CMSG_NXTHDR (msg, cmsg))
+  {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == TIMESTAMP_CMSG)
+    {
+      TIMESTAMP_TYPE t;
+
+      memcpy (&t, CMSG_DATA (cmsg), sizeof (t));
+      return TIMESTAMP_TO_NS (&t);
+    }
+  }
+#endif
+
+  return GST_CLOCK_TIME_NONE;
+}
+
+/*
+ * Reads all the packets that are waiting, up to the batch size, returns the
+ * number of packets or -1 on error. A truncated packet has a length of
+ * G_MAXUINT.
+ */
+static gint
+receive_packets (FsUdpPortSrcPrivate *priv)
+{
+#ifdef HAVE_RECVMMSG
+  gint ret;
+  gint i;
+
+  for (i = 0; i < (gint) priv->batch; i++)
+  {
+    priv->msgs[i].msg_hdr.msg_namelen = sizeof (struct sockaddr_storage);
+    priv->msgs[i].msg_hdr.msg_controllen = priv->control_size;
+    priv->msgs[i].msg_hdr.msg_flags = 0;
+  }
+
+  ret = recvmmsg (priv->fd, priv->msgs, priv->batch, MSG_DONTWAIT, NULL);
+
+  for (i = 0; i < ret; i++)
+  {
+    if (priv->msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+      priv->lens[i] = G_MAXUINT;
+    else
+      priv->lens[i] = priv->msgs[i].msg_len;
+
+    if (priv->use_timestamps)
+      priv->stamps[i] = get_arrival_time (&priv->msgs[i].msg_hdr);
+  }
+
+  return ret;
+#else
+  struct msghdr msg;
+  struct iovec iov;
+  gssize ret;
+
+  memset (&msg, 0, sizeof (msg));
+  iov.iov_base = priv->area;
+  iov.iov_len = priv->packet_size;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_name = &priv->addrs[0];
+  msg.msg_namelen = sizeof (struct sockaddr_storage);
+  msg.msg_control = priv->controls;
+  msg.msg_controllen = priv->control_size;
+
+  ret = recvmsg (priv->fd, &msg, 0);
+  if (ret < 0)
+    return -1;
+
+  if (msg.msg_flags & MSG_TRUNC)
+    priv->lens[0] = G_MAXUINT;
+  else
+    priv->lens[0] = ret;
+
+  if (priv->use_timestamps)
+    priv->stamps[0] = get_arrival_time (&msg);
+
+  return 1;
+#endif
+}
+
+static void
+set_from_address (GstNetAddress *from, struct sockaddr_storage *addr)
+{
+  switch (addr->ss_family)
+  {
+    case AF_INET:
+      {
+        struct sockaddr_in *sin = (struct sockaddr_in *) addr;
+
+        gst_netaddress_set_ip4_address (from, sin->sin_addr.s_addr,
+            sin->sin_port);
+      }
+      break;
+    case AF_INET6:
+      {
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) addr;
+
+        gst_netaddress_set_ip6_address (from, sin6->sin6_addr.s6_addr,
+            sin6->sin6_port);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+/*
+ * Reads the wall clock and the running time of the element at the same
+ * moment, the running time is GST_CLOCK_TIME_NONE if there is no clock
+ */
+static void
+sample_clocks (FsUdpPortSrc *self, GstClockTime *now_wall, GstClockTime *now)
+{
+  GstClock *clock;
+  GTimeVal tv;
+
+  *now = GST_CLOCK_TIME_NONE;
+
+  GST_OBJECT_LOCK (self);
+  clock = GST_ELEMENT_CLOCK (self);
+  if (clock)
+  {
+    GstClockTime base_time = GST_ELEMENT_CAST (self)->base_time;
+    GstClockTime clock_time = gst_clock_get_time (clock);
+
+    if (clock_time > base_time)
+      *now = clock_time - base_time;
+    else
+      *now = 0;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  g_get_current_time (&tv);
+  *now_wall = GST_TIMEVAL_TO_TIME (tv);
+}
+
+/*
+ * The kernel timestamps are in wall clock time, which is not necessarily the
+ * pipeline clock, so we only use them to know how long ago the packet
+ * arrived and subtract that from the current running time
+ */
+static GstClockTime
+arrival_to_running_time (FsUdpPortSrc *self, GstClockTime arrival,
+    GstClockTime now_wall, GstClockTime now)
+{
+  GstClockTime age;
+
+  if (!GST_CLOCK_TIME_IS_VALID (arrival) || !GST_CLOCK_TIME_IS_VALID (now))
+    return GST_CLOCK_TIME_NONE;
+
+  if (arrival >= now_wall)
+    return now;
+
+  age = now_wall - arrival;
+  if (age > now)
+    return 0;
+
+  return now - age;
+}
+
+/*
+ * Waits for packets and turns each one of them into a #GstNetBuffer of the
+ * right size, so that the receive area can be reused right away
+ */
+static GstFlowReturn
+fs_udpport_src_receive (FsUdpPortSrc *self)
+{
+  FsUdpPortSrcPrivate *priv = self->priv;
+  GstClockTime now_wall = GST_CLOCK_TIME_NONE;
+  GstClockTime now = GST_CLOCK_TIME_NONE;
+  gint received;
+  gint i;
+
+  priv->pending_head = priv->pending_count = 0;
+
+  while (priv->pending_count == 0)
+  {
+    if (gst_poll_wait (priv->poll, GST_CLOCK_TIME_NONE) < 0)
+    {
+      if (errno == EBUSY)
+        return GST_FLOW_WRONG_STATE;
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+
+      GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+          ("Could not wait for packets: %s", g_strerror (errno)));
+      return GST_FLOW_ERROR;
+    }
+
+    received = receive_packets (priv);
+    if (received < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+        continue;
+
+      GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+          ("Could not receive packets: %s", g_strerror (errno)));
+      return GST_FLOW_ERROR;
+    }
+
+    GST_LOG_OBJECT (self, "Received %d packets", received);
+
+    if (priv->use_timestamps)
+      sample_clocks (self, &now_wall, &now);
+
+    for (i = 0; i < received; i++)
+    {
+      GstNetBuffer *netbuf;
+
+      if (priv->lens[i] == G_MAXUINT)
+      {
+        GST_WARNING_OBJECT (self, "Dropping packet larger than %u bytes",
+            priv->packet_size);
+        continue;
+      }
+
+      netbuf = gst_netbuffer_new ();
+      GST_BUFFER_MALLOCDATA (netbuf) = g_malloc (priv->lens[i]);
+      GST_BUFFER_DATA (netbuf) = GST_BUFFER_MALLOCDATA (netbuf);
+      GST_BUFFER_SIZE (netbuf) = priv->lens[i];
+      memcpy (GST_BUFFER_DATA (netbuf), priv->area + i * priv->packet_size,
+          priv->lens[i]);
+      set_from_address (&netbuf->from, &priv->addrs[i]);
+      if (priv->use_timestamps)
+        GST_BUFFER_TIMESTAMP (netbuf) =
+          arrival_to_running_time (self, priv->stamps[i], now_wall, now);
+
+      priv->pending[priv->pending_count++] = GST_BUFFER_CAST (netbuf);
+    }
+  }
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+fs_udpport_src_create (GstPushSrc *psrc, GstBuffer **buf)
+{
+  FsUdpPortSrc *self = FS_UDPPORT_SRC (psrc);
+  FsUdpPortSrcPrivate *priv = self->priv;
+
+  if (priv->pending_head == priv->pending_count)
+  {
+    GstFlowReturn ret = fs_udpport_src_receive (self);
+
+    if (ret != GST_FLOW_OK)
+      return ret;
+  }
+
+  *buf = priv->pending[priv->pending_head];
+  priv->pending[priv->pending_head++] = NULL;
+
+  return GST_FLOW_OK;
+}
@@ -0,0 +1,69 @@
+/*
+ * Farsight Voice+Video library
+ *
+ *  Copyright 2008 Collabora Ltd,
+ *  Copyright 2008 Nokia Corporation
+ *   @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifndef __FS_UDPPORT_SRC_H__
+#define __FS_UDPPORT_SRC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstpushsrc.h>
+
+G_BEGIN_DECLS
+
+/* #define's don't like whitespacey bits */
+#define FS_TYPE_UDPPORT_SRC \
+  (fs_udpport_src_get_type())
+#define FS_UDPPORT_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), \
+  FS_TYPE_UDPPORT_SRC,FsUdpPortSrc))
+#define FS_UDPPORT_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), \
+  FS_TYPE_UDPPORT_SRC,FsUdpPortSrcClass))
+#define FS_IS_UDPPORT_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),FS_TYPE_UDPPORT_SRC))
+#define FS_IS_UDPPORT_SRC_CLASS(obj) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),FS_TYPE_UDPPORT_SRC))
+
+typedef struct _FsUdpPortSrc FsUdpPortSrc;
+typedef struct _FsUdpPortSrcClass FsUdpPortSrcClass;
+typedef struct _FsUdpPortSrcPrivate FsUdpPortSrcPrivate;
+
+struct _FsUdpPortSrc
+{
+  GstPushSrc parent;
+
+  /*< private >*/
+  FsUdpPortSrcPrivate *priv;
+};
+
+struct _FsUdpPortSrcClass
+{
+  GstPushSrcClass parent_class;
+};
+
+GType fs_udpport_src_get_type (void);
+
+G_END_DECLS
+
+#endif /* __FS_UDPPORT_SRC_H__ */
@@ -0,0 +1,49 @@
+/*
+ * Farsight Voice+Video library
+ *
+ *  Copyright 2008 Collabora Ltd,
+ *  Copyright 2008 Nokia Corporation
+ *   @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fs-udpport-src.h"
+#include "fs-udpport-sink.h"
+
+static gboolean
+fs_udpport_plugin_init (GstPlugin *plugin)
+{
+  if (!gst_element_register (plugin, "fsudpportsrc", GST_RANK_NONE,
+          FS_TYPE_UDPPORT_SRC))
+    return FALSE;
+
+  return gst_element_register (plugin, "fsudpportsink", GST_RANK_NONE,
+      FS_TYPE_UDPPORT_SINK);
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    "fsudpport",
+    "Batched UDP source and sink",
+    fs_udpport_plugin_init, VERSION, "LGPL", "Farsight",
+    "http://farsight.sf.net")
@@ -139,6 +139,17 @@ GST_START_TEST (test_fscodec_are_equal_opt_params)
   fail_unless (fs_codec_are_equal (codec1, codec2) == TRUE,
       "Identical codecs (with params in different order 2) not recognized");
 
+  _free_codec_param (g_list_first (codec1->optional_params)->data);
+  codec1->optional_params = g_list_remove (codec1->optional_params,
+      g_list_first (codec1->optional_params)->data);
+
+  fs_codec_add_optional_parameter (codec1, "AA3", "bb4");
+
+  fail_unless (fs_codec_are_equal (codec1, codec2) == FALSE,
+      "Different parameter value (in different order) not detected");
+  fail_unless (fs_codec_are_equal (codec2, codec1) == FALSE,
+      "Different parameter value (in different order) not detected");
+
   fs_codec_destroy (codec1);
 
   codec1 = init_codec_with_three_params ();
@@ -162,6 +162,200 @@ GST_START_TEST (test_funnel_simple)
 }
 GST_END_TEST;
 
+static gint listcount = 0;
+
+static GstFlowReturn
+chain_list_ok (GstPad *pad, GstBufferList *list)
+{
+  GstBufferListIterator *it = gst_buffer_list_iterate (list);
+
+  listcount++;
+
+  while (gst_buffer_list_iterator_next_group (it))
+    while (gst_buffer_list_iterator_next (it))
+      bufcount++;
+  gst_buffer_list_iterator_free (it);
+
+  gst_buffer_list_unref (list);
+
+  return GST_FLOW_OK;
+}
+
+static GstBufferList *
+make_buffer_list (GstCaps *caps, guint n_buffers)
+{
+  GstBufferList *list = gst_buffer_list_new ();
+  GstBufferListIterator *it = gst_buffer_list_iterate (list);
+  guint i;
+
+  for (i = 0; i < n_buffers; i++)
+  {
+    GstBuffer *buffer = gst_buffer_new ();
+
+    gst_buffer_set_caps (buffer, caps);
+    GST_BUFFER_TIMESTAMP (buffer) = i * GST_MSECOND;
+    gst_buffer_list_iterator_add_group (it);
+    gst_buffer_list_iterator_add (it, buffer);
+  }
+  gst_buffer_list_iterator_free (it);
+
+  return list;
+}
+
+GST_START_TEST (test_funnel_buffer_list)
+{
+  struct TestData td;
+
+  setup_test_objects (&td, chain_ok, alloc_ok);
+
+  bufcount = 0;
+  listcount = 0;
+
+  /* Without a chain list function downstream, the buffers are pushed
+   * one by one */
+  fail_unless (gst_pad_push_list (td.mysrc1,
+          make_buffer_list (td.mycaps, 3)) == GST_FLOW_OK);
+  fail_unless (bufcount == 3);
+  fail_unless (listcount == 0);
+
+  /* Otherwise the list is forwarded as a whole */
+  gst_pad_set_chain_list_function (td.mysink, chain_list_ok);
+
+  fail_unless (gst_pad_push_list (td.mysrc1,
+          make_buffer_list (td.mycaps, 3)) == GST_FLOW_OK);
+  fail_unless (gst_pad_push_list (td.mysrc2,
+          make_buffer_list (td.mycaps, 5)) == GST_FLOW_OK);
+  fail_unless (bufcount == 11);
+  fail_unless (listcount == 2);
+
+  /* Single buffers still go through the chain function */
+  fail_unless (gst_pad_push (td.mysrc1, gst_buffer_new ()) == GST_FLOW_OK);
+  fail_unless (bufcount == 12);
+  fail_unless (listcount == 2);
+
+  release_test_objects (&td);
+}
+GST_END_TEST;
+
+#define N_THREADS 4
+#define N_BUFFERS 10000
+
+static volatile gint mtbufcount = 0;
+
+static GstFlowReturn
+chain_count_atomic (GstPad *pad, GstBuffer *buffer)
+{
+  g_atomic_int_inc (&mtbufcount);
+
+  gst_buffer_unref (buffer);
+
+  return GST_FLOW_OK;
+}
+
+static gpointer
+push_buffers_thread (gpointer data)
+{
+  GstPad *srcpad = data;
+  GstCaps *caps = GST_PAD_CAPS (srcpad);
+  guint i;
+
+  for (i = 0; i < N_BUFFERS; i++)
+  {
+    GstBuffer *buffer = gst_buffer_new ();
+
+    gst_buffer_set_caps (buffer, caps);
+    GST_BUFFER_TIMESTAMP (buffer) = i * GST_MSECOND;
+    if (gst_pad_push (srcpad, buffer) != GST_FLOW_OK)
+      return GINT_TO_POINTER (FALSE);
+  }
+
+  return GINT_TO_POINTER (TRUE);
+}
+
+/*
+ * Pushes buffers into separate sink pads from separate threads at the same
+ * time, this is where the per-pad locking pays off
+ */
+GST_START_TEST (test_funnel_threads)
+{
+  GstElement *funnel;
+  GstPad *funnelsrc, *mysink;
+  GstPad *funnelsinks[N_THREADS], *mysrcs[N_THREADS];
+  GThread *threads[N_THREADS];
+  GstCaps *caps = gst_caps_new_simple ("test/test", NULL);
+  GstClockTime start, elapsed;
+  guint i;
+
+  funnel = gst_element_factory_make ("fsfunnel", NULL);
+  funnelsrc = gst_element_get_static_pad (funnel, "src");
+  fail_unless (funnelsrc != NULL);
+
+  mysink = gst_pad_new ("sink", GST_PAD_SINK);
+  gst_pad_set_chain_function (mysink, chain_count_atomic);
+  gst_pad_set_active (mysink, TRUE);
+  gst_pad_set_caps (mysink, caps);
+  fail_unless (GST_PAD_LINK_SUCCESSFUL (gst_pad_link (funnelsrc, mysink)));
+
+  for (i = 0; i < N_THREADS; i++)
+  {
+    gchar *name = g_strdup_printf ("src%u", i);
+
+    funnelsinks[i] = gst_element_get_request_pad (funnel, "sink%d");
+    fail_unless (funnelsinks[i] != NULL);
+
+    mysrcs[i] = gst_pad_new (name, GST_PAD_SRC);
+    gst_pad_set_active (mysrcs[i], TRUE);
+    gst_pad_set_caps (mysrcs[i], caps);
+    fail_unless (GST_PAD_LINK_SUCCESSFUL (
+            gst_pad_link (mysrcs[i], funnelsinks[i])));
+    g_free (name);
+  }
+
+  fail_unless (gst_element_set_state (funnel, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_SUCCESS);
+
+  mtbufcount = 0;
+  start = gst_util_get_timestamp ();
+
+  for (i = 0; i < N_THREADS; i++)
+  {
+    threads[i] = g_thread_create (push_buffers_thread, mysrcs[i], TRUE, NULL);
+    fail_unless (threads[i] != NULL);
+  }
+
+  for (i = 0; i < N_THREADS; i++)
+    fail_unless (GPOINTER_TO_INT (g_thread_join (threads[i])),
+        "Could not push all the buffers from thread %u", i);
+
+  elapsed = gst_util_get_timestamp () - start;
+
+  fail_unless (g_atomic_int_get (&mtbufcount) == N_THREADS * N_BUFFERS,
+      "Received %d buffers instead of %d", g_atomic_int_get (&mtbufcount),
+      N_THREADS * N_BUFFERS);
+
+  GST_INFO ("%d threads pushed %d buffers in %" GST_TIME_FORMAT
+      " (%.0f ns per buffer)", N_THREADS, N_THREADS * N_BUFFERS,
+      GST_TIME_ARGS (elapsed), (gdouble) elapsed / (N_THREADS * N_BUFFERS));
+
+  fail_unless (gst_element_set_state (funnel, GST_STATE_NULL) ==
+      GST_STATE_CHANGE_SUCCESS);
+
+  for (i = 0; i < N_THREADS; i++)
+  {
+    gst_pad_set_active (mysrcs[i], FALSE);
+    gst_object_unref (mysrcs[i]);
+    gst_element_release_request_pad (funnel, funnelsinks[i]);
+    gst_object_unref (funnelsinks[i]);
+  }
+
+  gst_pad_set_active (mysink, FALSE);
+  gst_object_unref (mysink);
+  gst_object_unref (funnelsrc);
+  gst_caps_unref (caps);
+  gst_object_unref (funnel);
+}
+GST_END_TEST;
+
 static Suite *
 funnel_suite (void)
 {
@@ -177,6 +371,14 @@ funnel_suite (void)
   tcase_add_test (tc_chain, test_funnel_simple);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("funnel buffer list");
+  tcase_add_test (tc_chain, test_funnel_buffer_list);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("funnel threads");
+  tcase_add_test (tc_chain, test_funnel_threads);
+  suite_add_tcase (s, tc_chain);
+
   return s;
 }
 
@@ -125,6 +125,92 @@ GST_START_TEST (test_rtcpfilter)
 }
 GST_END_TEST;
 
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtcp"));
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-rtcp"));
+
+static void
+push_and_check (GstPad *srcpad, GstBuffer *in, GstBuffer *expected)
+{
+  GstBuffer *out;
+
+  g_list_foreach (buffers, (GFunc) gst_mini_object_unref, NULL);
+  g_list_free (buffers);
+  buffers = NULL;
+
+  fail_unless (gst_pad_push (srcpad, in) == GST_FLOW_OK);
+  fail_unless (g_list_length (buffers) == 1);
+
+  out = buffers->data;
+  fail_unless (GST_BUFFER_SIZE (out) == GST_BUFFER_SIZE (expected),
+      "Got a buffer of %u bytes instead of %u", GST_BUFFER_SIZE (out),
+      GST_BUFFER_SIZE (expected));
+  fail_unless (!memcmp (GST_BUFFER_DATA (out), GST_BUFFER_DATA (expected),
+          GST_BUFFER_SIZE (out)));
+
+  gst_buffer_unref (expected);
+}
+
+GST_START_TEST (test_rtcpfilter_reduced_size)
+{
+  GstElement *filter;
+  GstPad *srcpad, *sinkpad;
+  GstCaps *caps = gst_caps_new_simple ("application/x-rtcp", NULL);
+  gint i;
+
+  filter = gst_check_setup_element ("fsrtcpfilter");
+  srcpad = gst_check_setup_src_pad (filter, &srctemplate, caps);
+  sinkpad = gst_check_setup_sink_pad (filter, &sinktemplate, caps);
+  gst_pad_set_active (srcpad, TRUE);
+  gst_pad_set_active (sinkpad, TRUE);
+
+  g_object_set (filter, "reduced-size", TRUE, "sending", TRUE, NULL);
+
+  fail_unless (gst_element_set_state (filter, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_SUCCESS);
+
+  /* The first SDES goes through */
+  push_and_check (srcpad, make_buffer (caps, TRUE, 1, TRUE, FALSE),
+      make_buffer (caps, TRUE, 1, TRUE, FALSE));
+
+  /* Then it is removed until the interval is over */
+  for (i = 0; i < 3; i++)
+    push_and_check (srcpad, make_buffer (caps, TRUE, 1, TRUE, FALSE),
+        make_buffer (caps, TRUE, 1, FALSE, FALSE));
+
+  /* A BYE always gets the full compound packet */
+  push_and_check (srcpad, make_buffer (caps, TRUE, 1, TRUE, TRUE),
+      make_buffer (caps, TRUE, 1, TRUE, TRUE));
+
+  /* Removing the SR and the SDES at the same time */
+  g_object_set (filter, "sending", FALSE, NULL);
+  push_and_check (srcpad, make_buffer (caps, TRUE, 2, TRUE, FALSE),
+      make_buffer (caps, FALSE, 2, FALSE, FALSE));
+
+  /* Without reduced size, the SDES are kept */
+  g_object_set (filter, "reduced-size", FALSE, NULL);
+  push_and_check (srcpad, make_buffer (caps, TRUE, 2, TRUE, FALSE),
+      make_buffer (caps, FALSE, 2, TRUE, FALSE));
+
+  fail_unless (gst_element_set_state (filter, GST_STATE_NULL) ==
+      GST_STATE_CHANGE_SUCCESS);
+
+  gst_check_drop_buffers ();
+  gst_pad_set_active (srcpad, FALSE);
+  gst_pad_set_active (sinkpad, FALSE);
+  gst_check_teardown_src_pad (filter);
+  gst_check_teardown_sink_pad (filter);
+  gst_check_teardown_element (filter);
+  gst_caps_unref (caps);
+}
+GST_END_TEST;
+
 static Suite *
 rtcpfilter_suite (void)
 {
@@ -140,6 +226,10 @@ rtcpfilter_suite (void)
   tcase_add_test (tc_chain, test_rtcpfilter);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("rtcpfilter reduced size");
+  tcase_add_test (tc_chain, test_rtcpfilter_reduced_size);
+  suite_add_tcase (s, tc_chain);
+
   return s;
 }
 
@@ -0,0 +1,360 @@
+/* Farsight 2 unit tests for the fsudpportsrc and fsudpportsink
+ *
+ * Copyright (C) 2008 Collabora, Nokia
+ * @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/netbuffer/gstnetbuffer.h>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+/* Returns a socket bound to a random port on the loopback interface */
+static gint
+make_socket (guint16 *port)
+{
+  struct sockaddr_in addr;
+  socklen_t addrlen = sizeof (addr);
+  struct timeval timeout = { 5, 0 };
+  gint fd;
+
+  fd = socket (AF_INET, SOCK_DGRAM, 0);
+  fail_unless (fd >= 0, "Could not create socket: %s", g_strerror (errno));
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  fail_unless (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) == 0);
+  fail_unless (getsockname (fd, (struct sockaddr *) &addr, &addrlen) == 0);
+  *port = ntohs (addr.sin_port);
+
+  setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+
+  return fd;
+}
+
+static GstBuffer *
+make_buffer (guint8 value, guint size)
+{
+  GstBuffer *buffer = gst_buffer_new_and_alloc (size);
+
+  memset (GST_BUFFER_DATA (buffer), value, size);
+
+  return buffer;
+}
+
+static void
+check_datagram (gint fd, guint8 value, guint size)
+{
+  guint8 data[1500];
+  gssize len;
+
+  len = recv (fd, data, sizeof (data), 0);
+  fail_unless (len == size, "Received %d bytes instead of %u", (gint) len,
+      size);
+  fail_unless (data[0] == value && data[size - 1] == value);
+}
+
+GST_START_TEST (test_udpport_sink)
+{
+  GstElement *sink;
+  GstPad *srcpad;
+  GstBufferList *list;
+  GstBufferListIterator *it;
+  guint16 recv_port, send_port;
+  gint recv_fd, send_fd;
+  guint8 data[16];
+
+  recv_fd = make_socket (&recv_port);
+  send_fd = make_socket (&send_port);
+
+  sink = gst_check_setup_element ("fsudpportsink");
+  srcpad = gst_check_setup_src_pad (sink, &srctemplate, NULL);
+  gst_pad_set_active (srcpad, TRUE);
+
+  g_object_set (sink,
+      "sockfd", send_fd,
+      "closefd", FALSE,
+      "sync", FALSE,
+      "async", FALSE,
+      NULL);
+  g_signal_emit_by_name (sink, "add", "127.0.0.1", (gint) recv_port);
+
+  fail_unless (gst_element_set_state (sink, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_SUCCESS);
+
+  fail_unless (gst_pad_push (srcpad, make_buffer (1, 100)) == GST_FLOW_OK);
+  check_datagram (recv_fd, 1, 100);
+
+  /* Each group becomes one datagram */
+  list = gst_buffer_list_new ();
+  it = gst_buffer_list_iterate (list);
+  gst_buffer_list_iterator_add_group (it);
+  gst_buffer_list_iterator_add (it, make_buffer (2, 10));
+  gst_buffer_list_iterator_add_group (it);
+  gst_buffer_list_iterator_add (it, make_buffer (3, 20));
+  gst_buffer_list_iterator_add (it, make_buffer (3, 30));
+  gst_buffer_list_iterator_add_group (it);
+  gst_buffer_list_iterator_add (it, make_buffer (4, 40));
+  gst_buffer_list_iterator_free (it);
+
+  fail_unless (gst_pad_push_list (srcpad, list) == GST_FLOW_OK);
+  check_datagram (recv_fd, 2, 10);
+  check_datagram (recv_fd, 3, 50);
+  check_datagram (recv_fd, 4, 40);
+
+  /* Adding the same destination twice only refs it, everything is
+   * still sent once */
+  g_signal_emit_by_name (sink, "add", "127.0.0.1", (gint) recv_port);
+  fail_unless (gst_pad_push (srcpad, make_buffer (5, 10)) == GST_FLOW_OK);
+  check_datagram (recv_fd, 5, 10);
+  fail_unless (recv (recv_fd, data, sizeof (data), MSG_DONTWAIT) < 0,
+      "Received a packet twice for a destination added twice");
+
+  /* It is only removed when it has been removed as many times */
+  g_signal_emit_by_name (sink, "remove", "127.0.0.1", (gint) recv_port);
+  fail_unless (gst_pad_push (srcpad, make_buffer (6, 10)) == GST_FLOW_OK);
+  check_datagram (recv_fd, 6, 10);
+  fail_unless (recv (recv_fd, data, sizeof (data), MSG_DONTWAIT) < 0,
+      "Received a packet twice for a destination added twice");
+
+  g_signal_emit_by_name (sink, "remove", "127.0.0.1", (gint) recv_port);
+  fail_unless (gst_pad_push (srcpad, make_buffer (7, 10)) == GST_FLOW_OK);
+  fail_unless (recv (recv_fd, data, sizeof (data), MSG_DONTWAIT) < 0,
+      "Received a packet after the destination was removed");
+
+  fail_unless (gst_element_set_state (sink, GST_STATE_NULL) ==
+      GST_STATE_CHANGE_SUCCESS);
+
+  gst_pad_set_active (srcpad, FALSE);
+  gst_check_teardown_src_pad (sink);
+  gst_check_teardown_element (sink);
+
+  close (recv_fd);
+  close (send_fd);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_udpport_src)
+{
+  GstElement *src;
+  GstPad *sinkpad;
+  guint16 recv_port, send_port;
+  gint recv_fd, send_fd;
+  struct sockaddr_in addr;
+  GList *item;
+  guint i;
+
+  recv_fd = make_socket (&recv_port);
+  send_fd = make_socket (&send_port);
+
+  src = gst_check_setup_element ("fsudpportsrc");
+  sinkpad = gst_check_setup_sink_pad (src, &sinktemplate, NULL);
+  gst_pad_set_active (sinkpad, TRUE);
+
+  g_object_set (src,
+      "sockfd", recv_fd,
+      "closefd", FALSE,
+      NULL);
+
+  fail_unless (gst_element_set_state (src, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  addr.sin_port = htons (recv_port);
+
+  /* Sent before anyone reads so that they are received as a batch */
+  for (i = 0; i < 5; i++)
+  {
+    guint8 data[10];
+
+    memset (data, i, sizeof (data));
+    fail_unless (sendto (send_fd, data, i + 1, 0, (struct sockaddr *) &addr,
+            sizeof (addr)) == i + 1);
+  }
+
+  g_mutex_lock (check_mutex);
+  while (g_list_length (buffers) < 5)
+    g_cond_wait (check_cond, check_mutex);
+  g_mutex_unlock (check_mutex);
+
+  for (item = buffers, i = 0; item; item = item->next, i++)
+  {
+    GstBuffer *buffer = item->data;
+    guint32 ip;
+    guint16 port;
+
+    fail_unless (GST_IS_NETBUFFER (buffer));
+    fail_unless (GST_BUFFER_SIZE (buffer) == i + 1);
+    fail_unless (GST_BUFFER_DATA (buffer)[0] == i);
+    fail_unless (GST_BUFFER_TIMESTAMP_IS_VALID (buffer));
+
+    fail_unless (gst_netaddress_get_ip4_address (
+            &GST_NETBUFFER (buffer)->from, &ip, &port));
+    fail_unless (ntohs (port) == send_port);
+  }
+
+  fail_unless (gst_element_set_state (src, GST_STATE_NULL) ==
+      GST_STATE_CHANGE_SUCCESS);
+
+  gst_check_drop_buffers ();
+  gst_pad_set_active (sinkpad, FALSE);
+  gst_check_teardown_sink_pad (src);
+  gst_check_teardown_element (src);
+
+  close (recv_fd);
+  close (send_fd);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_udpport_src_kernel_timestamps)
+{
+  GstElement *src;
+  GstPad *sinkpad;
+  GstClock *clock;
+  GstClockTime before, after;
+  guint16 recv_port, send_port;
+  gint recv_fd, send_fd;
+  struct sockaddr_in addr;
+  GList *item;
+  guint i;
+
+  recv_fd = make_socket (&recv_port);
+  send_fd = make_socket (&send_port);
+
+  src = gst_check_setup_element ("fsudpportsrc");
+  sinkpad = gst_check_setup_sink_pad (src, &sinktemplate, NULL);
+  gst_pad_set_active (sinkpad, TRUE);
+
+  clock = gst_system_clock_obtain ();
+  gst_element_set_clock (src, clock);
+  gst_element_set_base_time (src, 0);
+
+  g_object_set (src,
+      "sockfd", recv_fd,
+      "closefd", FALSE,
+      "kernel-timestamps", TRUE,
+      NULL);
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  addr.sin_port = htons (recv_port);
+
+  /* Starting the element turns on the timestamping of the socket, only the
+   * packets that arrive after that get a kernel timestamp */
+  fail_unless (gst_element_set_state (src, GST_STATE_PAUSED) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  /*
+   * The packets wait in the socket for a while before the element is
+   * playing, they must be timestamped with when they arrived
+   */
+  before = gst_clock_get_time (clock);
+  for (i = 0; i < 3; i++)
+  {
+    guint8 data[10];
+
+    memset (data, i, sizeof (data));
+    fail_unless (sendto (send_fd, data, sizeof (data), 0,
+            (struct sockaddr *) &addr, sizeof (addr)) == sizeof (data));
+  }
+  g_usleep (G_USEC_PER_SEC / 5);
+  after = gst_clock_get_time (clock);
+
+  fail_unless (gst_element_set_state (src, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+
+  g_mutex_lock (check_mutex);
+  while (g_list_length (buffers) < 3)
+    g_cond_wait (check_cond, check_mutex);
+  g_mutex_unlock (check_mutex);
+
+  for (item = buffers; item; item = item->next)
+  {
+    GstBuffer *buffer = item->data;
+
+    fail_unless (GST_BUFFER_TIMESTAMP_IS_VALID (buffer));
+    fail_unless (GST_BUFFER_TIMESTAMP (buffer) + 10 * GST_MSECOND >= before,
+        "Buffer timestamped before it was sent");
+    fail_unless (GST_BUFFER_TIMESTAMP (buffer) + 100 * GST_MSECOND < after,
+        "Buffer timestamped when it was read, not when it arrived");
+  }
+
+  fail_unless (gst_element_set_state (src, GST_STATE_NULL) ==
+      GST_STATE_CHANGE_SUCCESS);
+
+  gst_check_drop_buffers ();
+  gst_pad_set_active (sinkpad, FALSE);
+  gst_check_teardown_sink_pad (src);
+  gst_check_teardown_element (src);
+  gst_object_unref (clock);
+
+  close (recv_fd);
+  close (send_fd);
+}
+GST_END_TEST;
+
+static Suite *
+udpport_suite (void)
+{
+  Suite *s = suite_create ("udpport");
+  TCase *tc_chain;
+  GLogLevelFlags fatal_mask;
+
+  fatal_mask = g_log_set_always_fatal (G_LOG_FATAL_MASK);
+  fatal_mask |= G_LOG_LEVEL_WARNING | G_LOG_LEVEL_CRITICAL;
+  g_log_set_always_fatal (fatal_mask);
+
+  tc_chain = tcase_create ("udpport sink");
+  tcase_add_test (tc_chain, test_udpport_sink);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("udpport src");
+  tcase_add_test (tc_chain, test_udpport_src);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("udpport src kernel timestamps");
+  tcase_add_test (tc_chain, test_udpport_src_kernel_timestamps);
+  suite_add_tcase (s, tc_chain);
+
+  return s;
+}
+
+GST_CHECK_MAIN (udpport);
@@ -1477,6 +1477,14 @@ GST_START_TEST (test_rtpcodecs_nego_ilbc)
   test_one_codec (dat->session, participant, prefcodec, outprefcodec,
       codec, outcodec);
 
+  /* Parameter names are case-insensitive */
+  codec = fs_codec_new (100, "ILBC", FS_MEDIA_TYPE_AUDIO, 8000);
+  fs_codec_add_optional_parameter (codec, "MODE", "20");
+  outcodec = fs_codec_new (100, "ILBC", FS_MEDIA_TYPE_AUDIO, 8000);
+  fs_codec_add_optional_parameter (outcodec, "mode", "30");
+  test_one_codec (dat->session, participant, prefcodec, outprefcodec,
+      codec, outcodec);
+
   /* third with test with no mode in the prefs */
   fs_codec_remove_optional_parameter (prefcodec,
       fs_codec_get_optional_parameter (prefcodec, "mode", NULL));
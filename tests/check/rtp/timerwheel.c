@@ -0,0 +1,351 @@
+/* Farsight 2 unit tests for the timer wheel of FsRtpConference
+ *
+ * Copyright (C) 2008 Collabora, Nokia
+ * @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+*/
+
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+
+#include <gst/check/gstcheck.h>
+
+#include "check-threadsafe.h"
+
+#include "fs-rtp-conference.h"
+#include "fs-rtp-timer-wheel.h"
+
+/* The wheel logs in the category of the conference */
+GST_DEBUG_CATEGORY (fsrtpconference_debug);
+
+struct TimerData {
+  GMutex *mutex;
+  GCond *cond;
+
+  FsRtpTimerWheel *wheel;
+  FsRtpTimer *timer;
+
+  guint fired;
+  GstClockTime fired_time;
+
+  gboolean entered;
+  gboolean release;
+  gboolean returned;
+};
+
+static void
+timer_data_init (struct TimerData *td, FsRtpTimerWheel *wheel)
+{
+  memset (td, 0, sizeof (struct TimerData));
+  td->mutex = g_mutex_new ();
+  td->cond = g_cond_new ();
+  td->wheel = wheel;
+  td->fired_time = GST_CLOCK_TIME_NONE;
+}
+
+static void
+timer_data_clear (struct TimerData *td)
+{
+  g_cond_free (td->cond);
+  g_mutex_free (td->mutex);
+}
+
+/* Waits until the timer has fired, or fails after a second */
+static gboolean
+timer_data_wait_fired (struct TimerData *td)
+{
+  GTimeVal timeout;
+  gboolean fired;
+
+  g_get_current_time (&timeout);
+  g_time_val_add (&timeout, G_USEC_PER_SEC);
+
+  g_mutex_lock (td->mutex);
+  while (!td->fired)
+    if (!g_cond_timed_wait (td->cond, td->mutex, &timeout))
+      break;
+  fired = (td->fired > 0);
+  g_mutex_unlock (td->mutex);
+
+  return fired;
+}
+
+static void
+fired_cb (gpointer user_data)
+{
+  struct TimerData *td = user_data;
+
+  g_mutex_lock (td->mutex);
+  td->fired++;
+  td->fired_time = fs_rtp_timer_wheel_get_time (td->wheel);
+  g_cond_broadcast (td->cond);
+  g_mutex_unlock (td->mutex);
+}
+
+GST_START_TEST (test_timerwheel_add)
+{
+  FsRtpTimerWheel *wheel = fs_rtp_timer_wheel_new ();
+  struct TimerData td;
+  GstClockTime deadline;
+  GError *error = NULL;
+
+  timer_data_init (&td, wheel);
+
+  deadline = fs_rtp_timer_wheel_get_time (wheel) + 100 * GST_MSECOND;
+  td.timer = fs_rtp_timer_wheel_add (wheel, deadline, fired_cb, &td, &error);
+  fail_if (td.timer == NULL, "Could not add timer: %s",
+      error ? error->message : "unknown error");
+
+  fail_unless (timer_data_wait_fired (&td), "The timer did not fire");
+  fail_unless (td.fired_time >= deadline, "The timer fired early");
+
+  /* A fired timer can be re-armed */
+  g_mutex_lock (td.mutex);
+  td.fired = 0;
+  g_mutex_unlock (td.mutex);
+  deadline = fs_rtp_timer_wheel_get_time (wheel) + 100 * GST_MSECOND;
+  fs_rtp_timer_wheel_reschedule (wheel, td.timer, deadline);
+
+  fail_unless (timer_data_wait_fired (&td), "The timer did not fire again");
+  fail_unless (td.fired_time >= deadline, "The timer fired early");
+
+  fs_rtp_timer_wheel_remove (wheel, td.timer);
+  fs_rtp_timer_wheel_free (wheel);
+  timer_data_clear (&td);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_timerwheel_remove_armed)
+{
+  FsRtpTimerWheel *wheel = fs_rtp_timer_wheel_new ();
+  struct TimerData td;
+
+  timer_data_init (&td, wheel);
+
+  td.timer = fs_rtp_timer_wheel_add (wheel,
+      fs_rtp_timer_wheel_get_time (wheel) + 100 * GST_MSECOND,
+      fired_cb, &td, NULL);
+  fail_if (td.timer == NULL);
+
+  fs_rtp_timer_wheel_remove (wheel, td.timer);
+
+  g_usleep (300 * 1000);
+  fail_unless (td.fired == 0, "A removed timer fired");
+
+  fs_rtp_timer_wheel_free (wheel);
+  timer_data_clear (&td);
+}
+GST_END_TEST;
+
+static void
+blocking_cb (gpointer user_data)
+{
+  struct TimerData *td = user_data;
+
+  g_mutex_lock (td->mutex);
+  td->entered = TRUE;
+  g_cond_broadcast (td->cond);
+  while (!td->release)
+    g_cond_wait (td->cond, td->mutex);
+  td->returned = TRUE;
+  g_mutex_unlock (td->mutex);
+}
+
+static gpointer
+remove_thread (gpointer user_data)
+{
+  struct TimerData *td = user_data;
+
+  fs_rtp_timer_wheel_remove (td->wheel, td->timer);
+
+  /* The callback must have returned before remove() does */
+  ts_fail_unless (td->returned, "The timer was removed while its callback"
+      " was still running");
+
+  return NULL;
+}
+
+GST_START_TEST (test_timerwheel_remove_during_callback)
+{
+  FsRtpTimerWheel *wheel = fs_rtp_timer_wheel_new ();
+  struct TimerData td;
+  struct TimerData other;
+  GThread *thread;
+
+  timer_data_init (&td, wheel);
+  timer_data_init (&other, wheel);
+
+  td.timer = fs_rtp_timer_wheel_add (wheel,
+      fs_rtp_timer_wheel_get_time (wheel) + 50 * GST_MSECOND,
+      blocking_cb, &td, NULL);
+  fail_if (td.timer == NULL);
+
+  g_mutex_lock (td.mutex);
+  while (!td.entered)
+    g_cond_wait (td.cond, td.mutex);
+  g_mutex_unlock (td.mutex);
+
+  /* A blocked callback must not delay the other timers */
+  other.timer = fs_rtp_timer_wheel_add (wheel,
+      fs_rtp_timer_wheel_get_time (wheel) + 50 * GST_MSECOND,
+      fired_cb, &other, NULL);
+  fail_if (other.timer == NULL);
+  fail_unless (timer_data_wait_fired (&other),
+      "A blocked callback delayed another timer");
+  fs_rtp_timer_wheel_remove (wheel, other.timer);
+
+  thread = g_thread_create (remove_thread, &td, TRUE, NULL);
+  fail_if (thread == NULL);
+
+  g_usleep (100 * 1000);
+
+  g_mutex_lock (td.mutex);
+  td.release = TRUE;
+  g_cond_broadcast (td.cond);
+  g_mutex_unlock (td.mutex);
+
+  g_thread_join (thread);
+
+  fs_rtp_timer_wheel_free (wheel);
+  timer_data_clear (&other);
+  timer_data_clear (&td);
+}
+GST_END_TEST;
+
+static void
+self_remove_cb (gpointer user_data)
+{
+  struct TimerData *td = user_data;
+
+  fs_rtp_timer_wheel_remove (td->wheel, td->timer);
+
+  fired_cb (user_data);
+}
+
+GST_START_TEST (test_timerwheel_self_remove)
+{
+  FsRtpTimerWheel *wheel = fs_rtp_timer_wheel_new ();
+  struct TimerData td;
+
+  timer_data_init (&td, wheel);
+
+  td.timer = fs_rtp_timer_wheel_add (wheel,
+      fs_rtp_timer_wheel_get_time (wheel) + 50 * GST_MSECOND,
+      self_remove_cb, &td, NULL);
+  fail_if (td.timer == NULL);
+
+  fail_unless (timer_data_wait_fired (&td), "The timer did not fire");
+
+  g_usleep (200 * 1000);
+  fail_unless (td.fired == 1, "The timer fired again after removing itself");
+
+  /* Would warn if the timer was still armed */
+  fs_rtp_timer_wheel_free (wheel);
+  timer_data_clear (&td);
+}
+GST_END_TEST;
+
+static void
+rearm_cb (gpointer user_data)
+{
+  struct TimerData *td = user_data;
+  guint fired;
+
+  g_mutex_lock (td->mutex);
+  ts_fail_if (td->entered, "The callback of a timer ran concurrently");
+  td->entered = TRUE;
+  fired = ++td->fired;
+  g_mutex_unlock (td->mutex);
+
+  /* Expires again, several times, while the callback is still running */
+  if (fired == 1)
+  {
+    fs_rtp_timer_wheel_reschedule (td->wheel, td->timer,
+        fs_rtp_timer_wheel_get_time (td->wheel));
+    g_usleep (200 * 1000);
+  }
+
+  g_mutex_lock (td->mutex);
+  td->entered = FALSE;
+  g_cond_broadcast (td->cond);
+  g_mutex_unlock (td->mutex);
+}
+
+GST_START_TEST (test_timerwheel_rearm_during_callback)
+{
+  FsRtpTimerWheel *wheel = fs_rtp_timer_wheel_new ();
+  struct TimerData td;
+
+  timer_data_init (&td, wheel);
+
+  td.timer = fs_rtp_timer_wheel_add (wheel,
+      fs_rtp_timer_wheel_get_time (wheel) + 50 * GST_MSECOND,
+      rearm_cb, &td, NULL);
+  fail_if (td.timer == NULL);
+
+  g_usleep (500 * 1000);
+
+  g_mutex_lock (td.mutex);
+  fail_unless (td.fired == 2, "The re-armed timer fired %u times instead"
+      " of twice", td.fired);
+  g_mutex_unlock (td.mutex);
+
+  fs_rtp_timer_wheel_remove (wheel, td.timer);
+  fs_rtp_timer_wheel_free (wheel);
+  timer_data_clear (&td);
+}
+GST_END_TEST;
+
+static Suite *
+timerwheel_suite (void)
+{
+  Suite *s = suite_create ("fsrtptimerwheel");
+  TCase *tc_chain;
+  GLogLevelFlags fatal_mask;
+
+  fatal_mask = g_log_set_always_fatal (G_LOG_FATAL_MASK);
+  fatal_mask |= G_LOG_LEVEL_WARNING | G_LOG_LEVEL_CRITICAL;
+  g_log_set_always_fatal (fatal_mask);
+
+  GST_DEBUG_CATEGORY_INIT (fsrtpconference_debug, "fsrtpconference", 0,
+      "Farsight RTP Conference Element");
+
+  tc_chain = tcase_create ("fsrtptimerwheel_add");
+  tcase_add_test (tc_chain, test_timerwheel_add);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtptimerwheel_remove_armed");
+  tcase_add_test (tc_chain, test_timerwheel_remove_armed);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtptimerwheel_remove_during_callback");
+  tcase_add_test (tc_chain, test_timerwheel_remove_during_callback);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtptimerwheel_rearm_during_callback");
+  tcase_add_test (tc_chain, test_timerwheel_rearm_during_callback);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtptimerwheel_self_remove");
+  tcase_add_test (tc_chain, test_timerwheel_self_remove);
+  suite_add_tcase (s, tc_chain);
+
+  return s;
+}
+
+GST_CHECK_MAIN (timerwheel);
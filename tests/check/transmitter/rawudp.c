@@ -47,6 +47,7 @@ volatile gint running = TRUE;
 guint received_known[2] = {0, 0};
 gboolean has_stun = FALSE;
 gboolean associate_on_source = TRUE;
+gint known_flags = 0;
 
 gboolean pipeline_done = FALSE;
 GStaticMutex pipeline_mod_mutex = G_STATIC_MUTEX_INIT;
@@ -58,7 +59,10 @@ enum {
   FLAG_IS_LOCAL  = 1 << 1,
   FLAG_NO_SOURCE = 1 << 2,
   FLAG_NOT_SENDING = 1 << 3,
-  FLAG_RECVONLY_FILTER = 1 << 4
+  FLAG_RECVONLY_FILTER = 1 << 4,
+  FLAG_EVERY_KNOWN = 1 << 5,
+  FLAG_FIRST_KNOWN = 1 << 6,
+  FLAG_RECEIVE_SHARDS = 1 << 7
 };
 
 #define RTP_PORT 9828
@@ -214,12 +218,24 @@ _handoff_handler (GstElement *element, GstBuffer *buffer, GstPad *pad,
 
   if (buffer_count[0] == 20 && buffer_count[1] == 20) {
     /* TEST OVER */
-    if (associate_on_source)
+    if (associate_on_source && (known_flags & FLAG_EVERY_KNOWN))
       ts_fail_unless (buffer_count[0] == received_known[0] &&
           buffer_count[1] == received_known[1], "Some known buffers from known"
           " sources have not been reported (%d != %u || %d != %u)",
           buffer_count[0], received_known[0],
           buffer_count[1], received_known[1]);
+    else if (associate_on_source && (known_flags & FLAG_FIRST_KNOWN))
+      ts_fail_unless (received_known[0] == 1 && received_known[1] == 1,
+          "Known sources should only be reported once (%u, %u)",
+          received_known[0], received_known[1]);
+    else if (associate_on_source)
+      ts_fail_unless (received_known[0] >= 1 &&
+          received_known[0] <= buffer_count[0] &&
+          received_known[1] >= 1 &&
+          received_known[1] <= buffer_count[1],
+          "Known sources have not been reported (%d, %u || %d, %u)",
+          buffer_count[0], received_known[0],
+          buffer_count[1], received_known[1]);
     else
       ts_fail_unless (received_known[0] == 0 && received_known[1] == 0,
           "Got a known-source-packet-received signal when we shouldn't have");
@@ -290,6 +306,7 @@ run_rawudp_transmitter_test (gint n_parameters, GParameter *params,
 
   has_stun = flags & FLAG_HAS_STUN;
   associate_on_source = !(flags & FLAG_NO_SOURCE);
+  known_flags = flags & (FLAG_EVERY_KNOWN | FLAG_FIRST_KNOWN);
 
   if ((flags & FLAG_NOT_SENDING) && (flags & FLAG_RECVONLY_FILTER))
   {
@@ -311,6 +328,9 @@ run_rawudp_transmitter_test (gint n_parameters, GParameter *params,
   g_object_get (trans, "tos", &tos, NULL);
   ts_fail_unless (tos == 2);
 
+  if (flags & FLAG_RECEIVE_SHARDS)
+    g_object_set (trans, "receive-shards", 3, NULL);
+
   if (flags & FLAG_RECVONLY_FILTER)
     ts_fail_unless (g_signal_connect (trans, "get-recvonly-filter",
             G_CALLBACK (get_recvonly_filter), NULL));
@@ -435,6 +455,56 @@ GST_START_TEST (test_rawudptransmitter_run_nostun_nosource)
 }
 GST_END_TEST;
 
+GST_START_TEST (test_rawudptransmitter_run_nostun_every_known)
+{
+  GParameter params[2];
+
+  memset (params, 0, sizeof (GParameter) * 2);
+
+  params[0].name = "known-source-interval";
+  g_value_init (&params[0].value, G_TYPE_UINT);
+  g_value_set_uint (&params[0].value, 0);
+
+  params[1].name = "upnp-discovery";
+  g_value_init (&params[1].value, G_TYPE_BOOLEAN);
+  g_value_set_boolean (&params[1].value, FALSE);
+
+  run_rawudp_transmitter_test (2, params, FLAG_EVERY_KNOWN);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_rawudptransmitter_run_nostun_first_known)
+{
+  GParameter params[2];
+
+  memset (params, 0, sizeof (GParameter) * 2);
+
+  params[0].name = "known-source-interval";
+  g_value_init (&params[0].value, G_TYPE_UINT);
+  g_value_set_uint (&params[0].value, G_MAXUINT);
+
+  params[1].name = "upnp-discovery";
+  g_value_init (&params[1].value, G_TYPE_BOOLEAN);
+  g_value_set_boolean (&params[1].value, FALSE);
+
+  run_rawudp_transmitter_test (2, params, FLAG_FIRST_KNOWN);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_rawudptransmitter_run_nostun_receive_shards)
+{
+  GParameter params[1];
+
+  memset (params, 0, sizeof (GParameter));
+
+  params[0].name = "upnp-discovery";
+  g_value_init (&params[0].value, G_TYPE_BOOLEAN);
+  g_value_set_boolean (&params[0].value, FALSE);
+
+  run_rawudp_transmitter_test (1, params, FLAG_RECEIVE_SHARDS);
+}
+GST_END_TEST;
+
 GST_START_TEST (test_rawudptransmitter_run_invalid_stun)
 {
   GParameter params[4];
@@ -947,6 +1017,18 @@ rawudptransmitter_suite (void)
   tcase_add_test (tc_chain, test_rawudptransmitter_run_nostun_nosource);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("rawudptransmitter_nostun_every_known");
+  tcase_add_test (tc_chain, test_rawudptransmitter_run_nostun_every_known);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter_nostun_first_known");
+  tcase_add_test (tc_chain, test_rawudptransmitter_run_nostun_first_known);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter_nostun_receive_shards");
+  tcase_add_test (tc_chain, test_rawudptransmitter_run_nostun_receive_shards);
+  suite_add_tcase (s, tc_chain);
+
   tc_chain = tcase_create ("rawudptransmitter-stun-timeout");
   tcase_set_timeout (tc_chain, 5);
   tcase_add_test (tc_chain, test_rawudptransmitter_run_invalid_stun);
@@ -51,11 +51,11 @@ debug_blueprint (CodecBlueprint *blueprint)
   g_message ("Codec: %s", str);
   g_free (str);
 
-  str = gst_caps_to_string (blueprint->media_caps);
+  str = gst_caps_to_string (codec_blueprint_get_media_caps (blueprint));
   g_message ("media_caps: %s", str);
   g_free (str);
 
-  str = gst_caps_to_string (blueprint->rtp_caps);
+  str = gst_caps_to_string (codec_blueprint_get_rtp_caps (blueprint));
   g_message ("rtp_caps: %s", str);
   g_free (str);
 
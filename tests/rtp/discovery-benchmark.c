@@ -0,0 +1,204 @@
+/* Farsight 2 benchmark for the rtp codec discovery
+ *
+ * Copyright (C) 2007 Collabora, Nokia
+ * @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Registers a few hundred fake payloaders, depayloaders, encoders and
+ * decoders for as many fake codecs and times how long the discovery of the
+ * audio codecs takes, without using the cache.
+ *
+ * Usage: discovery-benchmark [number of fake codecs] [iterations]
+ */
+
+#include <stdlib.h>
+
+#include <glib/gstdio.h>
+
+#include <gst/gst.h>
+
+#include <gst/farsight/fs-codec.h>
+
+#include "fs-rtp-discover-codecs.h"
+#include "fs-rtp-conference.h"
+
+typedef struct {
+  gchar *name;
+  const gchar *klass;
+  gchar *sink_caps;
+  gchar *src_caps;
+} FakeElement;
+
+static void
+fake_element_class_init (gpointer g_class, gpointer class_data)
+{
+  GstElementClass *element_class = GST_ELEMENT_CLASS (g_class);
+  FakeElement *fake = class_data;
+
+  gst_element_class_add_pad_template (element_class,
+      gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+          gst_caps_from_string (fake->sink_caps)));
+  gst_element_class_add_pad_template (element_class,
+      gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+          gst_caps_from_string (fake->src_caps)));
+
+  gst_element_class_set_details_simple (element_class, fake->name,
+      fake->klass, "Fake element for the discovery benchmark",
+      "Farsight");
+}
+
+static void
+register_fake_element (const gchar *klass, gchar *name, gchar *sink_caps,
+    gchar *src_caps)
+{
+  FakeElement *fake = g_new0 (FakeElement, 1);
+  GTypeInfo info = {
+    sizeof (GstElementClass),
+    NULL, NULL,
+    fake_element_class_init,
+    NULL,
+    NULL,
+    sizeof (GstElement),
+    0,
+    NULL,
+    NULL
+  };
+  gchar *type_name;
+  GType type;
+
+  fake->name = name;
+  fake->klass = klass;
+  fake->sink_caps = sink_caps;
+  fake->src_caps = src_caps;
+  info.class_data = fake;
+
+  type_name = g_strdup_printf ("FsBenchmark%s", name);
+  type = g_type_register_static (GST_TYPE_ELEMENT, type_name, &info, 0);
+  g_free (type_name);
+
+  if (!gst_element_register (NULL, name, GST_RANK_SECONDARY, type))
+    g_error ("Could not register %s", name);
+}
+
+static void
+register_fake_codec (guint i)
+{
+  gchar *media_caps = g_strdup_printf ("audio/x-fs-benchmark-%u", i);
+  gchar *rtp_caps = g_strdup_printf ("application/x-rtp, media=(string)audio,"
+      " payload=(int)[96, 127], clock-rate=(int)8000,"
+      " encoding-name=(string)BENCH%u", i);
+
+  register_fake_element ("Codec/Payloader/Network",
+      g_strdup_printf ("fsbenchpay%u", i),
+      g_strdup (media_caps), g_strdup (rtp_caps));
+  register_fake_element ("Codec/Depayloader/Network",
+      g_strdup_printf ("fsbenchdepay%u", i),
+      g_strdup (rtp_caps), g_strdup (media_caps));
+  register_fake_element ("Codec/Encoder/Audio",
+      g_strdup_printf ("fsbenchenc%u", i),
+      g_strdup ("audio/x-raw-int"), g_strdup (media_caps));
+  register_fake_element ("Codec/Decoder/Audio",
+      g_strdup_printf ("fsbenchdec%u", i),
+      g_strdup (media_caps), g_strdup ("audio/x-raw-int"));
+
+  g_free (media_caps);
+  g_free (rtp_caps);
+}
+
+int main (int argc, char **argv)
+{
+  GError *error = NULL;
+  guint n_codecs = 300;
+  guint iterations = 5;
+  gchar *tmpdir;
+  gchar *cache_path;
+  gchar *config_cache_path;
+  GstClockTime total = 0;
+  GstClockTime best = GST_CLOCK_TIME_NONE;
+  guint i;
+
+  gst_init (&argc, &argv);
+
+  GST_DEBUG_CATEGORY_INIT (fsrtpconference_debug, "fsrtpconference", 0,
+      "Farsight RTP Conference Element");
+  GST_DEBUG_CATEGORY_INIT (fsrtpconference_disco, "fsrtpconference_disco",
+      0, "Farsight RTP Codec Discovery");
+  GST_DEBUG_CATEGORY_INIT (fsrtpconference_nego, "fsrtpconference_nego",
+      0, "Farsight RTP Codec Negotiation");
+
+  gst_debug_set_default_threshold (GST_LEVEL_ERROR);
+
+  if (argc > 1)
+    n_codecs = atoi (argv[1]);
+  if (argc > 2)
+    iterations = MAX (atoi (argv[2]), 1);
+
+  /* Keep the benchmark away from the real caches */
+  tmpdir = g_build_filename (g_get_tmp_dir (), "fs-discovery-benchmark-XXXXXX",
+      NULL);
+  if (!mkdtemp (tmpdir))
+    g_error ("Could not create a temporary directory");
+  cache_path = g_build_filename (tmpdir, "codecs.audio.cache", NULL);
+  config_cache_path = g_build_filename (tmpdir, "codecs-config.audio.cache",
+      NULL);
+  g_setenv ("FS_AUDIO_CODECS_CACHE", cache_path, TRUE);
+  g_setenv ("FS_AUDIO_CODECS_CONFIG_CACHE", config_cache_path, TRUE);
+
+  for (i = 0; i < n_codecs; i++)
+    register_fake_codec (i);
+
+  g_print ("Discovering audio codecs with %u fake codecs (%u elements)\n",
+      n_codecs, n_codecs * 4);
+
+  for (i = 0; i < iterations; i++)
+  {
+    GList *blueprints;
+    GstClockTime start, elapsed;
+
+    g_unlink (cache_path);
+
+    start = gst_util_get_timestamp ();
+    blueprints = fs_rtp_blueprints_get (FS_MEDIA_TYPE_AUDIO, &error);
+    elapsed = gst_util_get_timestamp () - start;
+
+    if (!blueprints)
+      g_error ("Discovery failed: %s", error ? error->message : "unknown");
+
+    g_print ("Iteration %u: %u blueprints in %.3f ms\n", i,
+        g_list_length (blueprints), (gdouble) elapsed / GST_MSECOND);
+
+    total += elapsed;
+    if (elapsed < best)
+      best = elapsed;
+
+    fs_rtp_blueprints_unref (FS_MEDIA_TYPE_AUDIO);
+  }
+
+  g_print ("Average: %.3f ms, best: %.3f ms\n",
+      (gdouble) total / iterations / GST_MSECOND,
+      (gdouble) best / GST_MSECOND);
+
+  g_unlink (cache_path);
+  g_unlink (config_cache_path);
+  g_rmdir (tmpdir);
+  g_free (cache_path);
+  g_free (config_cache_path);
+  g_free (tmpdir);
+
+  return 0;
+}
@@ -0,0 +1,142 @@
+/* Farsight 2 benchmark for the rtp codec negotiation
+ *
+ * Copyright (C) 2007 Collabora, Nokia
+ * @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Creates an audio session with a growing number of participants, each
+ * with its own rawudp stream, and times how long it takes to set the remote
+ * codecs of all the streams, then how long a single stream takes to
+ * renegotiate when it is the first or the last one.
+ *
+ * The rawudp transmitter is loaded from FS_PLUGIN_PATH.
+ *
+ * Usage: negotiation-benchmark [max number of participants]
+ */
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+
+#include <gst/farsight/fs-conference-iface.h>
+
+#include "fs-rtp-conference.h"
+
+static GstClockTime
+time_set_remote_codecs (FsStream *stream, GList *codecs)
+{
+  GError *error = NULL;
+  GstClockTime start = gst_util_get_timestamp ();
+
+  if (!fs_stream_set_remote_codecs (stream, codecs, &error))
+    g_error ("Could not set the remote codecs: %s",
+        error ? error->message : "unknown");
+
+  return gst_util_get_timestamp () - start;
+}
+
+static void
+run_benchmark (guint n_participants)
+{
+  GError *error = NULL;
+  GstElement *conf;
+  FsSession *session;
+  GList *codecs = NULL;
+  GList *reversed;
+  FsStream **streams = g_new0 (FsStream *, n_participants);
+  FsParticipant **participants = g_new0 (FsParticipant *, n_participants);
+  GstClockTime setup = 0, first, last;
+  guint i;
+
+  conf = gst_element_factory_make ("fsrtpconference", NULL);
+  if (!conf)
+    g_error ("Could not create the conference");
+
+  session = fs_conference_new_session (FS_CONFERENCE (conf),
+      FS_MEDIA_TYPE_AUDIO, &error);
+  if (!session)
+    g_error ("Could not create the session: %s", error->message);
+
+  g_object_get (session, "codecs", &codecs, NULL);
+  if (!codecs)
+    g_error ("There are no audio codecs");
+
+  for (i = 0; i < n_participants; i++)
+  {
+    gchar *cname = g_strdup_printf ("participant%u@127.0.0.1", i);
+
+    participants[i] = fs_conference_new_participant (FS_CONFERENCE (conf),
+        cname, &error);
+    g_free (cname);
+    if (!participants[i])
+      g_error ("Could not create participant: %s", error->message);
+
+    streams[i] = fs_session_new_stream (session, participants[i],
+        FS_DIRECTION_BOTH, "rawudp", 0, NULL, &error);
+    if (!streams[i])
+      g_error ("Could not create stream: %s", error->message);
+  }
+
+  for (i = 0; i < n_participants; i++)
+    setup += time_set_remote_codecs (streams[i], codecs);
+
+  /* A re-INVITE with the same codecs in another order */
+  reversed = g_list_reverse (fs_codec_list_copy (codecs));
+  first = time_set_remote_codecs (streams[0], reversed);
+  last = time_set_remote_codecs (streams[n_participants - 1], reversed);
+  fs_codec_list_destroy (reversed);
+
+  g_print ("%4u participants: setup %9.3f ms (%.3f ms per participant),"
+      " renegotiate first %.3f ms, last %.3f ms\n", n_participants,
+      (gdouble) setup / GST_MSECOND,
+      (gdouble) setup / n_participants / GST_MSECOND,
+      (gdouble) first / GST_MSECOND, (gdouble) last / GST_MSECOND);
+
+  for (i = 0; i < n_participants; i++)
+  {
+    g_object_unref (streams[i]);
+    g_object_unref (participants[i]);
+  }
+  g_free (streams);
+  g_free (participants);
+  fs_codec_list_destroy (codecs);
+  g_object_unref (session);
+  gst_object_unref (conf);
+}
+
+int main (int argc, char **argv)
+{
+  guint max_participants = 64;
+  guint n;
+
+  gst_init (&argc, &argv);
+
+  gst_debug_set_default_threshold (GST_LEVEL_ERROR);
+
+  if (argc > 1)
+    max_participants = MAX (atoi (argv[1]), 1);
+
+  if (!gst_element_register (NULL, "fsrtpconference", GST_RANK_NONE,
+          FS_TYPE_RTP_CONFERENCE))
+    g_error ("Could not register the conference");
+
+  for (n = 1; n <= max_participants; n *= 2)
+    run_benchmark (n);
+
+  return 0;
+}
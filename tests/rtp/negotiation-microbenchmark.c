@@ -0,0 +1,284 @@
+/* Farsight 2 micro-benchmark for the rtp codec negotiation functions
+ *
+ * Copyright (C) 2007 Collabora, Nokia
+ * @author: Olivier Crete <olivier.crete@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Times create_local_codec_associations(), negotiate_stream_codecs() and
+ * finish_codec_negotiation() on synthetic blueprint sets of various sizes,
+ * against a few kinds of remote offers, without any GStreamer element.
+ *
+ * The output is one CSV line per measurement:
+ *   function,offer,codecs,iterations,ns_per_op,allocs_per_op
+ *
+ * The allocations are counted through the GLib memory vtable with GSlice
+ * forced to use malloc, so the absolute times are a bit higher than in a
+ * normal run, but they can be compared from one build to the other.
+ *
+ * Usage: negotiation-microbenchmark [min time per measurement in ms]
+ *  [number of codecs]...
+ */
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+
+#include <gst/farsight/fs-codec.h>
+
+#include "fs-rtp-codec-negotiation.h"
+#include "fs-rtp-discover-codecs.h"
+#include "fs-rtp-conference.h"
+
+static volatile gint allocations = 0;
+
+static gpointer
+counting_malloc (gsize n_bytes)
+{
+  g_atomic_int_inc (&allocations);
+  return malloc (n_bytes);
+}
+
+static gpointer
+counting_calloc (gsize n_blocks, gsize n_block_bytes)
+{
+  g_atomic_int_inc (&allocations);
+  return calloc (n_blocks, n_block_bytes);
+}
+
+static gpointer
+counting_realloc (gpointer mem, gsize n_bytes)
+{
+  g_atomic_int_inc (&allocations);
+  return realloc (mem, n_bytes);
+}
+
+static GMemVTable counting_vtable = {
+  counting_malloc,
+  counting_realloc,
+  free,
+  counting_calloc,
+  NULL,
+  NULL
+};
+
+static GstClockTime min_time = 200 * GST_MSECOND;
+
+typedef enum {
+  OFFER_ALL,
+  OFFER_HALF_REVERSED,
+  OFFER_SINGLE
+} OfferType;
+
+static const gchar *offer_names[] = {
+  "all",
+  "half-reversed",
+  "single"
+};
+
+static GList *
+make_blueprints (guint n_codecs)
+{
+  GList *blueprints = NULL;
+  guint i;
+
+  for (i = 0; i < n_codecs; i++)
+  {
+    CodecBlueprint *bp = g_slice_new0 (CodecBlueprint);
+    gchar *name = g_strdup_printf ("BENCH%u", i);
+
+    bp->codec = fs_codec_new (FS_CODEC_ID_ANY, name, FS_MEDIA_TYPE_AUDIO,
+        8000);
+    fs_codec_add_optional_parameter (bp->codec, "bench-mode",
+        (i & 1) ? "20" : "30");
+    fs_codec_add_optional_parameter (bp->codec, "bench-index", name + 5);
+    bp->media_caps_str = g_strdup_printf ("audio/x-fs-benchmark-%u", i);
+    bp->rtp_caps_str = g_strdup_printf ("application/x-rtp,"
+        " media=(string)audio, clock-rate=(int)8000,"
+        " encoding-name=(string)%s", name);
+
+    /* Nothing looks inside the factory lists during the negotiation */
+    bp->send_pipeline_factory = g_list_prepend (NULL, NULL);
+    bp->receive_pipeline_factory = g_list_prepend (NULL, NULL);
+
+    blueprints = g_list_prepend (blueprints, bp);
+    g_free (name);
+  }
+
+  return g_list_reverse (blueprints);
+}
+
+static GList *
+make_offer (GList *local_codec_associations, OfferType type)
+{
+  GList *codecs = codec_associations_to_codecs (local_codec_associations,
+      TRUE);
+  GList *offer = NULL;
+  GList *item;
+  guint i = 0;
+
+  switch (type)
+  {
+    case OFFER_ALL:
+      return codecs;
+    case OFFER_HALF_REVERSED:
+      for (item = codecs; item; item = g_list_next (item), i++)
+        if (i % 2 == 0)
+          offer = g_list_prepend (offer, fs_codec_copy (item->data));
+      break;
+    case OFFER_SINGLE:
+      item = g_list_last (codecs);
+      if (item)
+        offer = g_list_prepend (NULL, fs_codec_copy (item->data));
+      break;
+  }
+
+  fs_codec_list_destroy (codecs);
+
+  return offer;
+}
+
+static void
+report (const gchar *function, const gchar *offer, guint n_codecs,
+    guint iterations, GstClockTime elapsed, gint allocs)
+{
+  g_print ("%s,%s,%u,%u,%.0f,%.1f\n", function, offer, n_codecs, iterations,
+      (gdouble) elapsed / iterations, (gdouble) allocs / iterations);
+}
+
+static void
+bench_create_local (GList *blueprints, guint n_codecs)
+{
+  GstClockTime elapsed = 0;
+  guint iterations = 0;
+  gint allocs = 0;
+
+  while (elapsed < min_time)
+  {
+    GstClockTime start = gst_util_get_timestamp ();
+    gint start_allocs = g_atomic_int_get (&allocations);
+    GList *cas = create_local_codec_associations (blueprints, NULL, NULL);
+
+    allocs += g_atomic_int_get (&allocations) - start_allocs;
+    elapsed += gst_util_get_timestamp () - start;
+    iterations++;
+
+    codec_association_list_destroy (cas);
+  }
+
+  report ("create_local_codec_associations", "none", n_codecs, iterations,
+      elapsed, allocs);
+}
+
+static void
+bench_negotiation (GList *blueprints, guint n_codecs, OfferType type)
+{
+  GList *local = create_local_codec_associations (blueprints, NULL, NULL);
+  GList *offer = make_offer (local, type);
+  GstClockTime nego_elapsed = 0, finish_elapsed = 0;
+  guint iterations = 0;
+  gint nego_allocs = 0, finish_allocs = 0;
+
+  while (nego_elapsed + finish_elapsed < min_time)
+  {
+    GstClockTime start = gst_util_get_timestamp ();
+    gint start_allocs = g_atomic_int_get (&allocations);
+    GList *negotiated;
+
+    negotiated = negotiate_stream_codecs (offer, local, FALSE);
+
+    nego_allocs += g_atomic_int_get (&allocations) - start_allocs;
+    nego_elapsed += gst_util_get_timestamp () - start;
+
+    if (!negotiated)
+      g_error ("The %s offer with %u codecs did not negotiate",
+          offer_names[type], n_codecs);
+
+    start = gst_util_get_timestamp ();
+    start_allocs = g_atomic_int_get (&allocations);
+
+    negotiated = finish_codec_negotiation (local, negotiated);
+
+    finish_allocs += g_atomic_int_get (&allocations) - start_allocs;
+    finish_elapsed += gst_util_get_timestamp () - start;
+    iterations++;
+
+    codec_association_list_destroy (negotiated);
+  }
+
+  report ("negotiate_stream_codecs", offer_names[type], n_codecs, iterations,
+      nego_elapsed, nego_allocs);
+  report ("finish_codec_negotiation", offer_names[type], n_codecs,
+      iterations, finish_elapsed, finish_allocs);
+
+  fs_codec_list_destroy (offer);
+  codec_association_list_destroy (local);
+}
+
+int main (int argc, char **argv)
+{
+  static const guint default_sizes[] = { 10, 50, 100, 250, 500 };
+  GArray *sizes = g_array_new (FALSE, FALSE, sizeof (guint));
+  guint i;
+
+  /* Must be done before anything is allocated */
+  g_mem_set_vtable (&counting_vtable);
+  g_setenv ("G_SLICE", "always-malloc", TRUE);
+
+  gst_init (&argc, &argv);
+
+  GST_DEBUG_CATEGORY_INIT (fsrtpconference_debug, "fsrtpconference", 0,
+      "Farsight RTP Conference Element");
+  GST_DEBUG_CATEGORY_INIT (fsrtpconference_disco, "fsrtpconference_disco",
+      0, "Farsight RTP Codec Discovery");
+  GST_DEBUG_CATEGORY_INIT (fsrtpconference_nego, "fsrtpconference_nego",
+      0, "Farsight RTP Codec Negotiation");
+
+  gst_debug_set_default_threshold (GST_LEVEL_ERROR);
+
+  if (argc > 1)
+    min_time = MAX (atoi (argv[1]), 1) * GST_MSECOND;
+
+  for (i = 2; i < argc; i++)
+  {
+    guint size = MAX (atoi (argv[i]), 1);
+    g_array_append_val (sizes, size);
+  }
+  if (sizes->len == 0)
+    g_array_append_vals (sizes, default_sizes,
+        G_N_ELEMENTS (default_sizes));
+
+  g_print ("function,offer,codecs,iterations,ns_per_op,allocs_per_op\n");
+
+  for (i = 0; i < sizes->len; i++)
+  {
+    guint n_codecs = g_array_index (sizes, guint, i);
+    GList *blueprints = make_blueprints (n_codecs);
+
+    bench_create_local (blueprints, n_codecs);
+    bench_negotiation (blueprints, n_codecs, OFFER_ALL);
+    bench_negotiation (blueprints, n_codecs, OFFER_HALF_REVERSED);
+    bench_negotiation (blueprints, n_codecs, OFFER_SINGLE);
+
+    g_list_foreach (blueprints, (GFunc) codec_blueprint_destroy, NULL);
+    g_list_free (blueprints);
+  }
+
+  g_array_free (sizes, TRUE);
+
+  return 0;
+}
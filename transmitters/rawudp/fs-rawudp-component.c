@@ -91,6 +91,7 @@ enum
   PROP_TRANSMITTER,
   PROP_FORCED_CANDIDATE,
   PROP_ASSOCIATE_ON_SOURCE,
+  PROP_KNOWN_SOURCE_INTERVAL,
 #ifdef HAVE_GUPNP
   PROP_UPNP_MAPPING,
   PROP_UPNP_DISCOVERY,
@@ -101,6 +102,18 @@ enum
 };
 
 
+/*
+ * Immutable copy of the remote address, it is only published while the
+ * address is unique on the port. The receive probe reads it without taking
+ * the lock, so a replaced copy is only freed once no probe is reading it.
+ * Each copy has a new serial, so that a copy allocated at the address of a
+ * freed one is not mistaken for it.
+ */
+typedef struct {
+  GstNetAddress addr;
+  guint serial;
+} KnownSource;
+
 struct _FsRawUdpComponentPrivate
 {
   gboolean disposed;
@@ -127,6 +140,7 @@ struct _FsRawUdpComponentPrivate
   gboolean stun_server_changed;
 
   gboolean associate_on_source;
+  guint known_source_interval;
 
 #ifdef HAVE_GUPNP
   gboolean upnp_discovery;
@@ -162,6 +176,21 @@ struct _FsRawUdpComponentPrivate
 
   gboolean remote_is_unique;
 
+  /* Written with the mutex held, read atomically by the receive probe */
+  volatile gpointer known_source;
+  /* Number of receive probes looking at the known source */
+  volatile gint known_source_readers;
+  /* Protected by the mutex */
+  guint known_source_serial;
+
+  /*
+   * Only touched by the receive probes, atomically since each receive shard
+   * has its own thread, see buffer_recv_cb(). The time is in milliseconds
+   * and wraps around, only the difference between two times is used
+   */
+  volatile gint last_reported_serial;
+  volatile gint last_report_ms;
+
 #ifdef HAVE_GUPNP
   GSource *upnp_discovery_timeout_src;
   FsCandidate *local_upnp_candidate;
@@ -228,6 +257,8 @@ buffer_recv_cb (GstPad *pad, GstBuffer *buffer, gpointer user_data);
 static void
 remote_is_unique_cb (gboolean unique, const GstNetAddress *address,
     gpointer user_data);
+static void
+fs_rawudp_component_publish_known_source_locked (FsRawUdpComponent *self);
 
 static gboolean
 fs_rawudp_component_start_stun (FsRawUdpComponent *self, GError **error);
@@ -368,6 +399,16 @@ fs_rawudp_component_class_init (FsRawUdpComponentClass *klass)
           TRUE,
           G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class,
+      PROP_KNOWN_SOURCE_INTERVAL,
+      g_param_spec_uint ("known-source-interval",
+          "Interval between known source notifications",
+          "Minimum time between two known-source-packet-received signals"
+          " for the same source (in milliseconds), 0 for every packet and"
+          " G_MAXUINT for only the first one",
+          0, G_MAXUINT, 1000,
+          G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
+
 #ifdef HAVE_GUPNP
     g_object_class_install_property (gobject_class,
       PROP_UPNP_MAPPING,
@@ -473,7 +514,8 @@ fs_rawudp_component_class_init (FsRawUdpComponentClass *klass)
    * @buffer: the #GstBuffer coming from the known source
    *
    * This signal is emitted when a buffer coming from a confirmed known source
-   * is received.
+   * is received. It is emitted for the first such buffer and then at most
+   * once per #FsRawUdpComponent:known-source-interval.
    *
    */
   signals[KNOWN_SOURCE_PACKET_RECEIVED] = g_signal_new
@@ -530,6 +572,7 @@ fs_rawudp_component_init (FsRawUdpComponent *self)
   self->priv->port = 7078;
 
   self->priv->associate_on_source = TRUE;
+  self->priv->known_source_interval = 1000;
 
   stun_agent_init (&self->priv->stun_agent,
       STUN_ALL_KNOWN_ATTRIBUTES, STUN_COMPATIBILITY_RFC3489, 0);
@@ -571,11 +614,7 @@ fs_rawudp_constructed (GObject *object)
     return;
   }
 
-  if (self->priv->associate_on_source)
-    self->priv->buffer_recv_id =
-      fs_rawudp_transmitter_udpport_connect_recv (
-          self->priv->udpport,
-          G_CALLBACK (buffer_recv_cb), self);
+  /* The receive probe is only connected once we have a known source */
 
   GST_CALL_PARENT (G_OBJECT_CLASS, constructed, (object));
 }
@@ -675,6 +714,8 @@ fs_rawudp_component_stop (FsRawUdpComponent *self)
           &self->priv->remote_address, remote_is_unique_cb, self);
     }
 
+    fs_rawudp_component_publish_known_source_locked (self);
+
     FS_RAWUDP_COMPONENT_UNLOCK (self);
 
     fs_rawudp_transmitter_put_udpport (self->priv->transmitter, udpport);
@@ -702,6 +743,9 @@ fs_rawudp_component_finalize (GObject *object)
   g_free (self->priv->ip);
   g_free (self->priv->stun_ip);
 
+  if (self->priv->known_source)
+    g_slice_free (KnownSource, self->priv->known_source);
+
   g_mutex_free (self->priv->mutex);
 
   parent_class->finalize (object);
@@ -831,6 +875,9 @@ fs_rawudp_component_set_property (GObject *object,
     case PROP_ASSOCIATE_ON_SOURCE:
       self->priv->associate_on_source = g_value_get_boolean (value);
       break;
+    case PROP_KNOWN_SOURCE_INTERVAL:
+      self->priv->known_source_interval = g_value_get_uint (value);
+      break;
 #ifdef HAVE_GUPNP
     case PROP_UPNP_MAPPING:
       self->priv->upnp_mapping = g_value_get_boolean (value);
@@ -860,6 +907,7 @@ fs_rawudp_component_new (
     guint component,
     FsRawUdpTransmitter *trans,
     gboolean associate_on_source,
+    guint known_source_interval,
     const gchar *ip,
     guint port,
     const gchar *stun_ip,
@@ -879,6 +927,7 @@ fs_rawudp_component_new (
       "component", component,
       "transmitter", trans,
       "associate-on-source", associate_on_source,
+      "known-source-interval", known_source_interval,
       "ip", ip,
       "port", port,
       "stun-ip", stun_ip,
@@ -928,6 +977,7 @@ remote_is_unique_cb (gboolean unique, const GstNetAddress *address,
   }
 
   self->priv->remote_is_unique = unique;
+  fs_rawudp_component_publish_known_source_locked (self);
 
  out:
   FS_RAWUDP_COMPONENT_UNLOCK (self);
@@ -999,6 +1049,7 @@ fs_rawudp_component_set_remote_candidate (FsRawUdpComponent *self,
   self->priv->remote_is_unique =
     fs_rawudp_transmitter_udpport_add_known_address (self->priv->udpport,
         &self->priv->remote_address, remote_is_unique_cb, self);
+  fs_rawudp_component_publish_known_source_locked (self);
 
   FS_RAWUDP_COMPONENT_UNLOCK (self);
 
@@ -1670,6 +1721,51 @@ fs_rawudp_component_emit_candidate (FsRawUdpComponent *self,
     fs_rawudp_component_maybe_new_active_candidate_pair (self);
 }
 
+/*
+ * Replaces the known source seen by the receive probe, and connects the
+ * probe if there is now a source to look for. The old copy may still be in
+ * use by a receive thread, so this waits for the readers to be gone before
+ * freeing it, they only hold it for a few instructions.
+ */
+static void
+fs_rawudp_component_publish_known_source_locked (FsRawUdpComponent *self)
+{
+  KnownSource *old = g_atomic_pointer_get (&self->priv->known_source);
+  KnownSource *ks = NULL;
+  gboolean known = (self->priv->udpport && self->priv->remote_candidate &&
+      self->priv->remote_is_unique);
+
+  /* Nothing changed, the probe must not report the same source again */
+  if (known ? (old && gst_netaddress_equal (&old->addr,
+              &self->priv->remote_address)) : !old)
+    return;
+
+  if (known)
+  {
+    ks = g_slice_new (KnownSource);
+    memcpy (&ks->addr, &self->priv->remote_address, sizeof (GstNetAddress));
+    /* 0 is never used, it is the serial of "nothing reported yet" */
+    if (++self->priv->known_source_serial == 0)
+      self->priv->known_source_serial++;
+    ks->serial = self->priv->known_source_serial;
+  }
+
+  g_atomic_pointer_set (&self->priv->known_source, ks);
+
+  if (old)
+  {
+    while (g_atomic_int_get (&self->priv->known_source_readers))
+      g_thread_yield ();
+    g_slice_free (KnownSource, old);
+  }
+
+  if (ks && self->priv->associate_on_source && !self->priv->buffer_recv_id)
+    self->priv->buffer_recv_id =
+      fs_rawudp_transmitter_udpport_connect_recv (
+          self->priv->udpport,
+          G_CALLBACK (buffer_recv_cb), self);
+}
+
 /*
  * This is a has "have-data" signal handler, so we return %TRUE to not
  * drop the buffer
@@ -1678,27 +1774,84 @@ static gboolean
 buffer_recv_cb (GstPad *pad, GstBuffer *buffer, gpointer user_data)
 {
   FsRawUdpComponent *self = FS_RAWUDP_COMPONENT (user_data);
+  guint interval = self->priv->known_source_interval;
+  guint now_ms = 0;
+  guint reported;
+  KnownSource *ks;
+  guint serial = 0;
+
+  if (!GST_IS_NETBUFFER (buffer))
+  {
+    GST_WARNING ("received buffer thats not a NetBuffer");
+    return TRUE;
+  }
+
+  /* The known source can not be freed while we are counted as a reader */
+  g_atomic_int_inc (&self->priv->known_source_readers);
+  ks = g_atomic_pointer_get (&self->priv->known_source);
+  if (ks && gst_netaddress_equal (&ks->addr,
+          &((GstNetBuffer *) buffer)->from))
+    serial = ks->serial;
+  g_atomic_int_add (&self->priv->known_source_readers, -1);
+
+  if (serial == 0)
+    return TRUE;
+
+  if (interval != 0 && interval != G_MAXUINT)
+    now_ms = (guint) (gst_util_get_timestamp () / GST_MSECOND);
+
+  /*
+   * The probes of all the receive shards race here, the compare-and-exchange
+   * lets only one of them report the packet for each known source and
+   * each interval
+   */
+  reported = (guint) g_atomic_int_get (&self->priv->last_reported_serial);
+  if (serial != reported)
+  {
+    /* Set first so that a probe that sees the new serial sees it too */
+    if (interval != 0 && interval != G_MAXUINT)
+      g_atomic_int_set (&self->priv->last_report_ms, (gint) now_ms);
 
-  if (GST_IS_NETBUFFER (buffer))
+    /* Lost to another shard, for this serial or a newer one */
+    if (!g_atomic_int_compare_and_exchange (&self->priv->last_reported_serial,
+            (gint) reported, (gint) serial))
+      return TRUE;
+  }
+  else if (interval == G_MAXUINT)
   {
-    GstNetBuffer *netbuffer = (GstNetBuffer*) buffer;
+    return TRUE;
+  }
+  else if (interval != 0)
+  {
+    guint last_ms = (guint) g_atomic_int_get (&self->priv->last_report_ms);
+
+    if (now_ms - last_ms < interval)
+      return TRUE;
 
+    if (!g_atomic_int_compare_and_exchange (&self->priv->last_report_ms,
+            (gint) last_ms, (gint) now_ms))
+      return TRUE;
+  }
+
+  g_signal_emit (self, signals[KNOWN_SOURCE_PACKET_RECEIVED], 0,
+      self->priv->component, buffer);
+
+  /*
+   * The session has associated the packet, we don't need to look at the
+   * next ones until the known source changes
+   */
+  if (interval == G_MAXUINT)
+  {
     FS_RAWUDP_COMPONENT_LOCK (self);
-    if (self->priv->remote_is_unique &&
-        gst_netaddress_equal (&self->priv->remote_address, &netbuffer->from))
-    {
-      FS_RAWUDP_COMPONENT_UNLOCK (self);
-      g_signal_emit (self, signals[KNOWN_SOURCE_PACKET_RECEIVED], 0,
-          self->priv->component, buffer);
-    }
-    else
+    /* With the lock held, the known source can not be replaced or freed */
+    ks = g_atomic_pointer_get (&self->priv->known_source);
+    if (self->priv->buffer_recv_id && ks && ks->serial == serial)
     {
-      FS_RAWUDP_COMPONENT_UNLOCK (self);
+      fs_rawudp_transmitter_udpport_disconnect_recv (self->priv->udpport,
+          self->priv->buffer_recv_id);
+      self->priv->buffer_recv_id = 0;
     }
-  }
-  else
-  {
-    GST_WARNING ("received buffer thats not a NetBuffer");
+    FS_RAWUDP_COMPONENT_UNLOCK (self);
   }
 
   return TRUE;
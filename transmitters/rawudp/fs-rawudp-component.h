@@ -98,6 +98,7 @@ fs_rawudp_component_new (
     guint component,
     FsRawUdpTransmitter *trans,
     gboolean associate_on_source,
+    guint known_source_interval,
     const gchar *ip,
     guint port,
     const gchar *stun_ip,
@@ -82,6 +82,7 @@
 
 #define DEFAULT_UPNP_MAPPING_TIMEOUT (600)
 #define DEFAULT_UPNP_DISCOVERY_TIMEOUT (2)
+#define DEFAULT_KNOWN_SOURCE_INTERVAL (1000)
 
 /* Signals */
 enum
@@ -102,7 +103,8 @@ enum
   PROP_UPNP_MAPPING,
   PROP_UPNP_DISCOVERY,
   PROP_UPNP_MAPPING_TIMEOUT,
-  PROP_UPNP_DISCOVERY_TIMEOUT
+  PROP_UPNP_DISCOVERY_TIMEOUT,
+  PROP_KNOWN_SOURCE_INTERVAL
 };
 
 struct _FsRawUdpStreamTransmitterPrivate
@@ -128,6 +130,7 @@ struct _FsRawUdpStreamTransmitterPrivate
   guint next_candidate_id;
 
   gboolean associate_on_source;
+  guint known_source_interval;
 
 #ifdef HAVE_GUPNP
   gboolean upnp_discovery;
@@ -327,6 +330,17 @@ fs_rawudp_stream_transmitter_class_init (FsRawUdpStreamTransmitterClass *klass)
           0, G_MAXUINT32, DEFAULT_UPNP_DISCOVERY_TIMEOUT,
           G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class,
+      PROP_KNOWN_SOURCE_INTERVAL,
+      g_param_spec_uint ("known-source-interval",
+          "Interval between known source notifications",
+          "The first packet from the remote address is reported with"
+          " known-source-packet-received, then at most one packet per this"
+          " period (in milliseconds). 0 reports every packet, G_MAXUINT only"
+          " reports the first one",
+          0, G_MAXUINT, DEFAULT_KNOWN_SOURCE_INTERVAL,
+          G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gobject_class->dispose = fs_rawudp_stream_transmitter_dispose;
   gobject_class->finalize = fs_rawudp_stream_transmitter_finalize;
 
@@ -342,6 +356,7 @@ fs_rawudp_stream_transmitter_init (FsRawUdpStreamTransmitter *self)
 
   self->priv->sending = TRUE;
   self->priv->associate_on_source = TRUE;
+  self->priv->known_source_interval = DEFAULT_KNOWN_SOURCE_INTERVAL;
 
 #ifdef HAVE_GUPNP
   self->priv->upnp_mapping = TRUE;
@@ -431,6 +446,9 @@ fs_rawudp_stream_transmitter_get_property (GObject *object,
     case PROP_ASSOCIATE_ON_SOURCE:
       g_value_set_boolean (value, self->priv->associate_on_source);
       break;
+    case PROP_KNOWN_SOURCE_INTERVAL:
+      g_value_set_uint (value, self->priv->known_source_interval);
+      break;
     case PROP_STUN_IP:
       g_value_set_string (value, self->priv->stun_ip);
       break;
@@ -496,6 +514,9 @@ fs_rawudp_stream_transmitter_set_property (GObject *object,
     case PROP_ASSOCIATE_ON_SOURCE:
       self->priv->associate_on_source = g_value_get_boolean (value);
       break;
+    case PROP_KNOWN_SOURCE_INTERVAL:
+      self->priv->known_source_interval = g_value_get_uint (value);
+      break;
     case PROP_STUN_IP:
       g_free (self->priv->stun_ip);
       self->priv->stun_ip = g_value_dup_string (value);
@@ -621,6 +642,7 @@ fs_rawudp_stream_transmitter_build (FsRawUdpStreamTransmitter *self,
     self->priv->component[c] = fs_rawudp_component_new (c,
         self->priv->transmitter,
         self->priv->associate_on_source,
+        self->priv->known_source_interval,
         ips[c],
         requested_port,
         self->priv->stun_ip,
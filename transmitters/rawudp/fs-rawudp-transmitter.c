@@ -73,9 +73,14 @@ enum
   PROP_GST_SINK,
   PROP_GST_SRC,
   PROP_COMPONENTS,
-  PROP_TYPE_OF_SERVICE
+  PROP_TYPE_OF_SERVICE,
+  PROP_RECEIVE_SHARDS,
+  PROP_KERNEL_TIMESTAMPS
 };
 
+#define DEFAULT_RECEIVE_SHARDS (1)
+#define MAX_RECEIVE_SHARDS (64)
+
 struct _FsRawUdpTransmitterPrivate
 {
   /* We hold references to this element */
@@ -93,6 +98,8 @@ struct _FsRawUdpTransmitterPrivate
   GList **udpports;
 
   gint type_of_service;
+  guint receive_shards;
+  gboolean kernel_timestamps;
 
   gboolean disposed;
 };
@@ -197,6 +204,40 @@ fs_rawudp_transmitter_class_init (FsRawUdpTransmitterClass *klass)
   g_object_class_override_property (gobject_class, PROP_TYPE_OF_SERVICE,
       "tos");
 
+  /**
+   * FsRawUdpTransmitter:receive-shards:
+   *
+   * The number of sockets that receive on each port. If it is more than one,
+   * the sockets are bound with SO_REUSEPORT and the kernel spreads the
+   * incoming flows between them, each socket having its own receive thread.
+   * Only ports opened after it is changed are affected.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_SHARDS,
+      g_param_spec_uint ("receive-shards",
+          "Number of receive sockets per port",
+          "The number of SO_REUSEPORT sockets (and threads) receiving on each"
+          " port",
+          1, MAX_RECEIVE_SHARDS, DEFAULT_RECEIVE_SHARDS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsRawUdpTransmitter:kernel-timestamps:
+   *
+   * Timestamp the received packets with the time at which the kernel
+   * received them (using SO_TIMESTAMPNS) mapped to the pipeline clock,
+   * instead of the time at which the receive thread got to them. This keeps
+   * our own scheduling delays out of the jitter statistics. It requires the
+   * fsudpportsrc element and only affects ports opened after it is changed.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_KERNEL_TIMESTAMPS,
+      g_param_spec_boolean ("kernel-timestamps",
+          "Use the kernel receive timestamps",
+          "Timestamp the received packets with their kernel arrival time",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   transmitter_class->new_stream_transmitter =
     fs_rawudp_transmitter_new_stream_transmitter;
   transmitter_class->get_stream_transmitter_type =
@@ -217,6 +258,7 @@ fs_rawudp_transmitter_init (FsRawUdpTransmitter *self)
   self->priv->disposed = FALSE;
 
   self->components = 2;
+  self->priv->receive_shards = DEFAULT_RECEIVE_SHARDS;
   self->priv->mutex = g_mutex_new ();
 }
 
@@ -456,6 +498,16 @@ fs_rawudp_transmitter_get_property (GObject *object,
       g_value_set_uint (value, self->priv->type_of_service);
       g_mutex_unlock (self->priv->mutex);
       break;
+    case PROP_RECEIVE_SHARDS:
+      g_mutex_lock (self->priv->mutex);
+      g_value_set_uint (value, self->priv->receive_shards);
+      g_mutex_unlock (self->priv->mutex);
+      break;
+    case PROP_KERNEL_TIMESTAMPS:
+      g_mutex_lock (self->priv->mutex);
+      g_value_set_boolean (value, self->priv->kernel_timestamps);
+      g_mutex_unlock (self->priv->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -479,6 +531,16 @@ fs_rawudp_transmitter_set_property (GObject *object,
       fs_rawudp_transmitter_set_type_of_service (self,
           g_value_get_uint (value));
       break;
+    case PROP_RECEIVE_SHARDS:
+      g_mutex_lock (self->priv->mutex);
+      self->priv->receive_shards = g_value_get_uint (value);
+      g_mutex_unlock (self->priv->mutex);
+      break;
+    case PROP_KERNEL_TIMESTAMPS:
+      g_mutex_lock (self->priv->mutex);
+      self->priv->kernel_timestamps = g_value_get_boolean (value);
+      g_mutex_unlock (self->priv->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -515,7 +577,8 @@ fs_rawudp_transmitter_new_stream_transmitter (FsTransmitter *transmitter,
 /*
  * The UdpPort structure is a ref-counted pseudo-object use to represent
  * one ip:port combo on which we listen and send, so it includes  a udpsrc
- * and a multiudpsink
+ * and a multiudpsink (or the batching fsudpportsrc and fsudpportsink if
+ * they are installed)
  */
 
 struct _UdpPort {
@@ -545,23 +608,97 @@ struct _UdpPort {
 
   guint component_id;
 
+  /* Extra SO_REUSEPORT sockets on the same port that only receive */
+  struct RecvShard *shards;
+  guint n_shards;
+
+  /*
+   * Protects only the table below and is never held while calling out,
+   * it is taken from the receive probes with the lock of the component held
+   */
+  GMutex *shard_probes_mutex;
+  /* probe id on udpsrc -> gulong array of the ids on the shards */
+  GHashTable *shard_probes;
+
   /* Everything below is protected by the mutex */
   GMutex *mutex;
-  GArray *known_addresses;
+  /* GstNetAddress * -> struct KnownAddressBucket * */
+  GHashTable *known_addresses;
+};
+
+struct RecvShard {
+  gint fd;
+  GstElement *udpsrc;
+  GstPad *requested_pad;
 };
 
 struct KnownAddress {
   FsRawUdpAddressUniqueCallbackFunc callback;
   gpointer user_data;
+};
+
+/*
+ * All the users of one address, the hash table key points to addr
+ */
+struct KnownAddressBucket {
   GstNetAddress addr;
+  GArray *known;
 };
 
+static guint
+_netaddress_hash (gconstpointer key)
+{
+  GstNetAddress *addr = (GstNetAddress *) key;
+  guint32 ip4;
+  guint8 ip6[16];
+  guint16 port = 0;
+  guint hash = 0;
+  gint i;
+
+  switch (gst_netaddress_get_net_type (addr))
+  {
+    case GST_NET_TYPE_IP4:
+      gst_netaddress_get_ip4_address (addr, &ip4, &port);
+      hash = ip4;
+      break;
+    case GST_NET_TYPE_IP6:
+      gst_netaddress_get_ip6_address (addr, ip6, &port);
+      for (i = 0; i < 16; i++)
+        hash = (hash * 31) + ip6[i];
+      break;
+    default:
+      break;
+  }
+
+  return hash ^ (port << 16) ^ port;
+}
+
+static gboolean
+_netaddress_equal (gconstpointer a, gconstpointer b)
+{
+  return gst_netaddress_equal ((GstNetAddress *) a, (GstNetAddress *) b);
+}
+
+static void
+_known_address_bucket_free (gpointer data)
+{
+  struct KnownAddressBucket *bucket = data;
+
+  g_array_free (bucket->known, TRUE);
+  g_slice_free (struct KnownAddressBucket, bucket);
+}
+
+#ifdef SO_REUSEPORT
+static gint _bind_shard (const gchar *ip, guint port);
+#endif
+
 static gint
 _bind_port (
     const gchar *ip,
     guint port,
     guint *used_port,
     int tos,
+    gboolean reuseport,
     GError **error)
 {
   int sock;
@@ -601,6 +738,30 @@ _bind_port (
   do {
     address.sin_port = htons (port);
     retval = bind (sock, (struct sockaddr *) &address, sizeof (address));
+
+#ifdef SO_REUSEPORT
+    /*
+     * With SO_REUSEPORT, the bind would also succeed on a port used by
+     * another socket that has it, like the one of another session, so the
+     * free port is found without it and the socket is then reopened with it
+     */
+    if (retval == 0 && reuseport)
+    {
+      close (sock);
+      sock = _bind_shard (ip, port);
+      if (sock < 0)
+      {
+        retval = -1;
+        if ((sock = socket (AF_INET, SOCK_DGRAM, 0)) <= 0)
+        {
+          g_set_error (error, FS_ERROR, FS_ERROR_NETWORK,
+              "Error creating socket: %s", g_strerror (errno));
+          return -1;
+        }
+      }
+    }
+#endif
+
     if (retval != 0)
     {
       GST_INFO ("could not bind port %d", port);
@@ -628,13 +789,66 @@ _bind_port (
   return sock;
 }
 
+#ifdef SO_REUSEPORT
+/*
+ * Opens another socket bound on the exact same address as the one of the
+ * UdpPort, it will get its share of the incoming flows
+ */
+static gint
+_bind_shard (const gchar *ip, guint port)
+{
+  int sock;
+  int one = 1;
+  struct sockaddr_in address;
+
+  memset (&address, 0, sizeof(struct sockaddr_in));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = INADDR_ANY;
+  address.sin_port = htons (port);
+
+  if (ip)
+  {
+    struct addrinfo hints;
+    struct addrinfo *result = NULL;
+
+    memset (&hints, 0, sizeof (struct addrinfo));
+    hints.ai_family = AF_INET;
+    hints.ai_flags = AI_NUMERICHOST;
+    if (getaddrinfo (ip, NULL, &hints, &result) != 0)
+      return -1;
+    memcpy (&address.sin_addr,
+        &((struct sockaddr_in *) result->ai_addr)->sin_addr,
+        sizeof (struct in_addr));
+    freeaddrinfo (result);
+  }
+
+  if ((sock = socket (AF_INET, SOCK_DGRAM, 0)) <= 0)
+  {
+    GST_WARNING ("Error creating socket: %s", g_strerror (errno));
+    return -1;
+  }
+
+  if (setsockopt (sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof (one)) < 0 ||
+      bind (sock, (struct sockaddr *) &address, sizeof (address)) != 0)
+  {
+    GST_WARNING ("could not add a receive socket on port %u: %s", port,
+        g_strerror (errno));
+    close (sock);
+    return -1;
+  }
+
+  return sock;
+}
+#endif
+
 static GstElement *
 _create_sinksource (
-    gchar *elementname,
+    const gchar *elementname,
     GstBin *bin,
     GstElement *teefunnel,
     GstElement *filter,
     gint fd,
+    gboolean kernel_timestamps,
     GstPadDirection direction,
     GstPad **requested_pad,
     GError **error)
@@ -663,6 +877,9 @@ _create_sinksource (
           "auto-multicast"))
     g_object_set (elem, "auto-multicast", FALSE, NULL);
 
+  if (kernel_timestamps)
+    g_object_set (elem, "kernel-timestamps", TRUE, NULL);
+
 
   if (!gst_bin_add (bin, elem))
   {
@@ -788,6 +1005,22 @@ _create_sinksource (
 }
 
 
+/*
+ * Returns the name of the preferred element if it is installed, otherwise
+ * the name of the fallback
+ */
+static const gchar *
+_pick_element (const gchar *preferred, const gchar *fallback)
+{
+  GstElementFactory *factory = gst_element_factory_find (preferred);
+
+  if (!factory)
+    return fallback;
+
+  gst_object_unref (factory);
+  return preferred;
+}
+
 static UdpPort *
 fs_rawudp_transmitter_get_udpport_locked (FsRawUdpTransmitter *trans,
     guint component_id,
@@ -827,7 +1060,14 @@ fs_rawudp_transmitter_get_udpport (FsRawUdpTransmitter *trans,
 {
   UdpPort *udpport;
   UdpPort *tmpudpport;
+  const gchar *srcname;
+  const gchar *sinkname;
   int tos;
+  guint receive_shards;
+  gboolean kernel_timestamps;
+#ifdef SO_REUSEPORT
+  guint i;
+#endif
 
   /* First lets check if we already have one */
   if (component_id > trans->components)
@@ -841,11 +1081,22 @@ fs_rawudp_transmitter_get_udpport (FsRawUdpTransmitter *trans,
   udpport = fs_rawudp_transmitter_get_udpport_locked (trans, component_id,
       requested_ip, requested_port);
   tos = trans->priv->type_of_service;
+  receive_shards = trans->priv->receive_shards;
+  kernel_timestamps = trans->priv->kernel_timestamps;
   g_mutex_unlock (trans->priv->mutex);
 
   if (udpport)
     return udpport;
 
+#ifndef SO_REUSEPORT
+  if (receive_shards > 1)
+  {
+    GST_WARNING ("SO_REUSEPORT is not available, using only one receive"
+        " socket per port");
+    receive_shards = 1;
+  }
+#endif
+
   GST_DEBUG ("Make new UdpPort for component %u requesting %s:%u", component_id,
       requested_ip ? requested_ip : "ANY", requested_port);
 
@@ -857,13 +1108,14 @@ fs_rawudp_transmitter_get_udpport (FsRawUdpTransmitter *trans,
   udpport->fd = -1;
   udpport->component_id = component_id;
   udpport->mutex = g_mutex_new ();
-  udpport->known_addresses = g_array_new (TRUE, FALSE,
-      sizeof (struct KnownAddress));
+  udpport->shard_probes_mutex = g_mutex_new ();
+  udpport->known_addresses = g_hash_table_new_full (_netaddress_hash,
+      _netaddress_equal, NULL, _known_address_bucket_free);
 
   /* Now lets bind both ports */
 
   udpport->fd = _bind_port (requested_ip, requested_port, &udpport->port, tos,
-      error);
+      receive_shards > 1, error);
   if (udpport->fd < 0)
     goto error;
 
@@ -872,15 +1124,57 @@ fs_rawudp_transmitter_get_udpport (FsRawUdpTransmitter *trans,
   udpport->tee = trans->priv->udpsink_tees[component_id];
   udpport->funnel = trans->priv->udpsrc_funnels[component_id];
 
-  udpport->udpsrc = _create_sinksource ("udpsrc",
+  srcname = _pick_element ("fsudpportsrc", "udpsrc");
+  sinkname = _pick_element ("fsudpportsink", "multiudpsink");
+
+  if (kernel_timestamps && strcmp (srcname, "fsudpportsrc"))
+  {
+    GST_WARNING ("Kernel timestamps require the fsudpportsrc element");
+    kernel_timestamps = FALSE;
+  }
+
+  udpport->udpsrc = _create_sinksource (srcname,
       GST_BIN (trans->priv->gst_src), udpport->funnel, NULL,
-      udpport->fd, GST_PAD_SRC, &udpport->udpsrc_requested_pad, error);
+      udpport->fd, kernel_timestamps, GST_PAD_SRC,
+      &udpport->udpsrc_requested_pad, error);
   if (!udpport->udpsrc)
     goto error;
 
-  udpport->udpsink = _create_sinksource ("multiudpsink",
+#ifdef SO_REUSEPORT
+  if (receive_shards > 1)
+  {
+    udpport->shards = g_new0 (struct RecvShard, receive_shards - 1);
+    udpport->shard_probes = g_hash_table_new_full (NULL, NULL, NULL,
+        (GDestroyNotify) g_free);
+  }
+
+  for (i = 0; i < receive_shards - 1; i++)
+  {
+    struct RecvShard *shard = &udpport->shards[i];
+
+    shard->fd = _bind_shard (requested_ip, udpport->port);
+    if (shard->fd < 0)
+      break;
+
+    udpport->n_shards++;
+
+    shard->udpsrc = _create_sinksource (srcname,
+        GST_BIN (trans->priv->gst_src), udpport->funnel, NULL,
+        shard->fd, kernel_timestamps, GST_PAD_SRC, &shard->requested_pad,
+        error);
+    if (!shard->udpsrc)
+      goto error;
+  }
+
+  if (udpport->n_shards + 1 < receive_shards)
+    GST_WARNING ("Only %u of the %u receive sockets could be opened on"
+        " port %u", udpport->n_shards + 1, receive_shards, udpport->port);
+#endif
+
+  udpport->udpsink = _create_sinksource (sinkname,
       GST_BIN (trans->priv->gst_sink), udpport->tee, NULL,
-      udpport->fd, GST_PAD_SINK, &udpport->udpsink_requested_pad, error);
+      udpport->fd, FALSE, GST_PAD_SINK, &udpport->udpsink_requested_pad,
+      error);
   if (!udpport->udpsink)
     goto error;
 
@@ -894,9 +1188,10 @@ fs_rawudp_transmitter_get_udpport (FsRawUdpTransmitter *trans,
 
   if (udpport->recvonly_filter)
   {
-    udpport->recvonly_udpsink = _create_sinksource ("multiudpsink",
+    udpport->recvonly_udpsink = _create_sinksource (sinkname,
         GST_BIN (trans->priv->gst_sink), udpport->tee, udpport->recvonly_filter,
-        udpport->fd, GST_PAD_SINK, &udpport->recvonly_requested_pad, error);
+        udpport->fd, FALSE, GST_PAD_SINK, &udpport->recvonly_requested_pad,
+        error);
     if (!udpport->recvonly_udpsink)
       goto error;
 
@@ -936,6 +1231,8 @@ void
 fs_rawudp_transmitter_put_udpport (FsRawUdpTransmitter *trans,
   UdpPort *udpport)
 {
+  guint i;
+
   GST_LOG ("Put port refcount %d->%d", udpport->refcount, udpport->refcount-1);
 
   g_mutex_lock (trans->priv->mutex);
@@ -971,6 +1268,32 @@ fs_rawudp_transmitter_put_udpport (FsRawUdpTransmitter *trans,
     gst_object_unref (udpport->udpsrc_requested_pad);
   }
 
+  for (i = 0; i < udpport->n_shards; i++)
+  {
+    struct RecvShard *shard = &udpport->shards[i];
+
+    if (shard->udpsrc)
+    {
+      GstStateChangeReturn ret;
+      gst_element_set_locked_state (shard->udpsrc, TRUE);
+      ret = gst_element_set_state (shard->udpsrc, GST_STATE_NULL);
+      if (ret != GST_STATE_CHANGE_SUCCESS)
+        GST_ERROR ("Error changing state of udpsrc: %s",
+            gst_element_state_change_return_get_name (ret));
+      if (!gst_bin_remove (GST_BIN (trans->priv->gst_src), shard->udpsrc))
+        GST_ERROR ("Could not remove udpsrc element from transmitter source");
+    }
+
+    if (shard->requested_pad)
+    {
+      gst_element_release_request_pad (udpport->funnel, shard->requested_pad);
+      gst_object_unref (shard->requested_pad);
+    }
+
+    close (shard->fd);
+  }
+  g_free (udpport->shards);
+
   if (udpport->udpsink_requested_pad)
   {
     gst_element_release_request_pad (udpport->tee,
@@ -1015,8 +1338,12 @@ fs_rawudp_transmitter_put_udpport (FsRawUdpTransmitter *trans,
 
   if (udpport->mutex)
     g_mutex_free (udpport->mutex);
+  if (udpport->shard_probes_mutex)
+    g_mutex_free (udpport->shard_probes_mutex);
   if (udpport->known_addresses)
-    g_array_free (udpport->known_addresses, TRUE);
+    g_hash_table_destroy (udpport->known_addresses);
+  if (udpport->shard_probes)
+    g_hash_table_destroy (udpport->shard_probes);
 
   g_free (udpport->requested_ip);
   g_slice_free (UdpPort, udpport);
@@ -1061,6 +1388,10 @@ fs_rawudp_transmitter_udpport_sendto (UdpPort *udpport,
   return TRUE;
 }
 
+/*
+ * The probe is added to the udpsrc and to every receive shard, the id of the
+ * one on the udpsrc is used to find the others
+ */
 gulong
 fs_rawudp_transmitter_udpport_connect_recv (UdpPort *udpport,
     GCallback callback,
@@ -1068,6 +1399,8 @@ fs_rawudp_transmitter_udpport_connect_recv (UdpPort *udpport,
 {
   GstPad *pad;
   gulong id;
+  gulong *shard_ids;
+  guint i;
 
   pad = gst_element_get_static_pad (udpport->udpsrc, "src");
 
@@ -1075,6 +1408,22 @@ fs_rawudp_transmitter_udpport_connect_recv (UdpPort *udpport,
 
   gst_object_unref (pad);
 
+  if (udpport->n_shards == 0)
+    return id;
+
+  shard_ids = g_new (gulong, udpport->n_shards);
+  for (i = 0; i < udpport->n_shards; i++)
+  {
+    pad = gst_element_get_static_pad (udpport->shards[i].udpsrc, "src");
+    shard_ids[i] = gst_pad_add_buffer_probe (pad, callback, user_data);
+    gst_object_unref (pad);
+  }
+
+  g_mutex_lock (udpport->shard_probes_mutex);
+  g_hash_table_insert (udpport->shard_probes, GUINT_TO_POINTER (id),
+      shard_ids);
+  g_mutex_unlock (udpport->shard_probes_mutex);
+
   return id;
 }
 
@@ -1084,10 +1433,33 @@ fs_rawudp_transmitter_udpport_disconnect_recv (UdpPort *udpport,
     gulong id)
 {
   GstPad *pad = gst_element_get_static_pad (udpport->udpsrc, "src");
+  gulong *shard_ids;
+  guint i;
 
   gst_pad_remove_buffer_probe (pad, id);
 
   gst_object_unref (pad);
+
+  if (udpport->n_shards == 0)
+    return;
+
+  g_mutex_lock (udpport->shard_probes_mutex);
+  shard_ids = g_hash_table_lookup (udpport->shard_probes,
+      GUINT_TO_POINTER (id));
+  g_hash_table_steal (udpport->shard_probes, GUINT_TO_POINTER (id));
+  g_mutex_unlock (udpport->shard_probes_mutex);
+
+  if (!shard_ids)
+    return;
+
+  for (i = 0; i < udpport->n_shards; i++)
+  {
+    pad = gst_element_get_static_pad (udpport->shards[i].udpsrc, "src");
+    gst_pad_remove_buffer_probe (pad, shard_ids[i]);
+    gst_object_unref (pad);
+  }
+
+  g_free (shard_ids);
 }
 
 gboolean
@@ -1096,6 +1468,7 @@ fs_rawudp_transmitter_udpport_is_pad (UdpPort *udpport,
 {
   GstPad *mypad;
   gboolean res;
+  guint i;
 
   mypad =  gst_element_get_static_pad (udpport->udpsrc, "src");
 
@@ -1103,6 +1476,13 @@ fs_rawudp_transmitter_udpport_is_pad (UdpPort *udpport,
 
   gst_object_unref (mypad);
 
+  for (i = 0; !res && i < udpport->n_shards; i++)
+  {
+    mypad = gst_element_get_static_pad (udpport->shards[i].udpsrc, "src");
+    res = (mypad == pad);
+    gst_object_unref (mypad);
+  }
+
   return res;
 }
 
@@ -1140,43 +1520,37 @@ fs_rawudp_transmitter_udpport_add_known_address (UdpPort *udpport,
     FsRawUdpAddressUniqueCallbackFunc callback,
     gpointer user_data)
 {
-  gint i;
   gboolean unique = FALSE;
   struct KnownAddress newka = {0};
-  guint counter = 0;
-  struct KnownAddress *prev_ka = NULL;
+  struct KnownAddressBucket *bucket;
 
   g_mutex_lock (udpport->mutex);
 
-  for (i = 0;
-       g_array_index (udpport->known_addresses, struct KnownAddress, i).callback;
-       i++)
-  {
-    struct KnownAddress *ka = &g_array_index (udpport->known_addresses, struct KnownAddress, i);
-    if (gst_netaddress_equal (address, &ka->addr))
-    {
-      g_assert (!(ka->callback == callback && ka->user_data == user_data));
-
-      prev_ka = ka;
-      counter++;
-    }
-  }
+  bucket = g_hash_table_lookup (udpport->known_addresses, address);
 
-  if (counter == 0)
+  if (!bucket)
   {
+    bucket = g_slice_new (struct KnownAddressBucket);
+    memcpy (&bucket->addr, address, sizeof (GstNetAddress));
+    bucket->known = g_array_new (FALSE, FALSE, sizeof (struct KnownAddress));
+    g_hash_table_insert (udpport->known_addresses, &bucket->addr, bucket);
     unique = TRUE;
   }
-  else if (counter == 1)
+  else if (bucket->known->len == 1)
   {
-    if (prev_ka->callback)
-      prev_ka->callback (FALSE, &prev_ka->addr, prev_ka->user_data);
+    struct KnownAddress *prev_ka =
+      &g_array_index (bucket->known, struct KnownAddress, 0);
+
+    g_assert (!(prev_ka->callback == callback &&
+            prev_ka->user_data == user_data));
+
+    prev_ka->callback (FALSE, &bucket->addr, prev_ka->user_data);
   }
 
-  memcpy (&newka.addr, address, sizeof (GstNetAddress));
   newka.callback = callback;
   newka.user_data = user_data;
 
-  g_array_append_val (udpport->known_addresses, newka);
+  g_array_append_val (bucket->known, newka);
 
   g_mutex_unlock (udpport->mutex);
 
@@ -1202,45 +1576,44 @@ fs_rawudp_transmitter_udpport_remove_known_address (UdpPort *udpport,
     FsRawUdpAddressUniqueCallbackFunc callback,
     gpointer user_data)
 {
-  gint i;
-  gint remove_i = -1;
-  guint counter = 0;
-  struct KnownAddress *prev_ka = NULL;
+  guint i;
+  struct KnownAddressBucket *bucket;
 
   g_mutex_lock (udpport->mutex);
 
-  for (i = 0;
-       g_array_index (udpport->known_addresses, struct KnownAddress, i).callback;
-       i++)
-  {
-    struct KnownAddress *ka = &g_array_index (udpport->known_addresses, struct KnownAddress, i);
-    if (gst_netaddress_equal (address, &ka->addr))
-    {
-      if (ka->callback == callback && ka->user_data == user_data)
-      {
-        remove_i = i;
-      }
-      else
-      {
-        counter++;
-        prev_ka = ka;
-      }
-    }
-  }
+  bucket = g_hash_table_lookup (udpport->known_addresses, address);
+  if (!bucket)
+    goto unknown;
 
-  if (remove_i == -1)
+  for (i = 0; i < bucket->known->len; i++)
   {
-    GST_ERROR ("Tried to remove unknown known address");
-    goto out;
+    struct KnownAddress *ka =
+      &g_array_index (bucket->known, struct KnownAddress, i);
+    if (ka->callback == callback && ka->user_data == user_data)
+      break;
   }
 
-  if (counter == 1)
-    prev_ka->callback (TRUE, &prev_ka->addr, prev_ka->user_data);
+  if (i == bucket->known->len)
+    goto unknown;
 
-  g_array_remove_index_fast (udpport->known_addresses, remove_i);
+  g_array_remove_index_fast (bucket->known, i);
 
- out:
+  if (bucket->known->len == 1)
+  {
+    struct KnownAddress *ka =
+      &g_array_index (bucket->known, struct KnownAddress, 0);
+    ka->callback (TRUE, &bucket->addr, ka->user_data);
+  }
+  else if (bucket->known->len == 0)
+  {
+    g_hash_table_remove (udpport->known_addresses, &bucket->addr);
+  }
+
+  g_mutex_unlock (udpport->mutex);
+  return;
 
+ unknown:
+  GST_ERROR ("Tried to remove unknown known address");
   g_mutex_unlock (udpport->mutex);
 }
 